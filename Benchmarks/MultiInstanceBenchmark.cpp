@@ -0,0 +1,153 @@
+// Multi-Instance Benchmark
+// Runs 1, 16, 64 and 256 processors in one process over a shared simulated transport, the way a
+// host with many sequencer instances does, and reports the processing time per instance. Every
+// instance plays one of a few sessions with bar-interval resets; its output is checked against
+// the same session rendered alone, so any state one instance leaks into another (cross-talk)
+// shows up as a mismatch. Exits with 1 if any instance differs.
+
+#include "TestSession.h"
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace
+{
+constexpr int blockSize = 512;
+constexpr double secondsPerRun = 30.0;
+constexpr int numSessions = 4;
+
+// Sessions differ in their steps, master length, loop lengths, reset intervals and random seeds.
+// Every step of a lane sounds different, so a reset one instance misses changes its output.
+void setUpSession(ShequencerAudioProcessor& p, int session)
+{
+    using Type = LaneEditCommand::Type;
+    
+    sendSteps(p, Type::SetMasterSteps, 0, 0, [session](int i) { return (i + session) % 3 != 1 ? 1 : 0; });
+    sendEdit(p, Type::SetMasterLength, 0, 0, 13 + session);
+    
+    // Lengths short of LEG and HOLD on the length lane
+    for (int lane = 0; lane < 8; ++lane)
+    {
+        const int range = lane == 3 ? 8 : 128;
+        sendSteps(p, Type::SetValues, 0, lane, [=](int i) { return (i * (lane + 5) + session * 3) % range; });
+        sendSteps(p, Type::SetTriggers, 0, lane, [=](int i) { return (i * (lane + 5) + session * 3) % 2; });
+        sendEdit(p, Type::SetValueLoopLength, 0, lane, 5 + (lane + session) % 7);
+        sendEdit(p, Type::SetTriggerLoopLength, 0, lane, 3 + (lane * 3 + session) % 11);
+        sendEdit(p, Type::SetValueResetInterval, 0, lane, 1 << ((lane + session) % 4));
+        sendEdit(p, Type::SetTriggerResetInterval, 0, lane, 1 << ((lane + session + 1) % 3));
+        sendEdit(p, Type::SetRandomSeed, 0, lane, 1000 * session + lane);
+    }
+    sendEdit(p, Type::SetValueDirection, 0, 2, (int)LaneDirection::Random);
+    sendEdit(p, Type::SetTriggerDirection, 0, 5, (int)LaneDirection::RandomDirection);
+    sendEdit(p, Type::SetMidiCC, 0, 4, 74);
+    sendEdit(p, Type::SetSmoothing, 0, 4, 40);
+}
+
+struct Instance
+{
+    ShequencerAudioProcessor processor;
+    juce::uint64 outputHash = 14695981039346656037ull; // FNV-1a over every event's sample and bytes
+    juce::int64 ticks = 0;
+    
+    void hash(juce::uint64 value)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            outputHash ^= (value >> (i * 8)) & 0xff;
+            outputHash *= 1099511628211ull;
+        }
+    }
+};
+
+struct RunResult
+{
+    std::vector<juce::uint64> outputHashes;
+    double meanMicrosPerBlock = 0.0, maxMicrosPerBlock = 0.0;
+};
+
+// All instances play the same transport block by block, instance i playing session
+// (firstSession + i) % numSessions. The order they are processed in flips every block, so no
+// instance always runs first.
+RunResult run(int numInstances, int firstSession = 0)
+{
+    TestPlayHead playHead;
+    std::vector<std::unique_ptr<Instance>> instances;
+    for (int i = 0; i < numInstances; ++i)
+    {
+        instances.push_back(std::make_unique<Instance>());
+        auto& p = instances.back()->processor;
+        setUpSession(p, (firstSession + i) % numSessions);
+        p.setPlayHead(&playHead);
+        p.setRateAndBufferSizeDetails(testSampleRate, blockSize);
+        p.prepareToPlay(testSampleRate, blockSize);
+    }
+    
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    juce::MidiBuffer midi;
+    const auto numBlocks = (int)(secondsPerRun * testSampleRate / blockSize);
+    
+    for (int block = 0; block < numBlocks; ++block)
+    {
+        const auto position = (juce::int64)block * blockSize;
+        setTransport(playHead, position);
+        
+        for (int n = 0; n < numInstances; ++n)
+        {
+            auto& instance = *instances[(size_t)(block % 2 == 0 ? n : numInstances - 1 - n)];
+            midi.clear();
+            
+            const auto start = juce::Time::getHighResolutionTicks();
+            instance.processor.processBlock(buffer, midi);
+            instance.ticks += juce::Time::getHighResolutionTicks() - start;
+            
+            for (const auto metadata : midi)
+            {
+                const auto message = metadata.getMessage();
+                instance.hash((juce::uint64)(position + metadata.samplePosition));
+                for (int i = 0; i < message.getRawDataSize(); ++i)
+                    instance.hash(message.getRawData()[i]);
+            }
+        }
+    }
+    
+    RunResult result;
+    const double microsPerTick = 1.0e6 / (double)juce::Time::getHighResolutionTicksPerSecond();
+    for (const auto& instance : instances)
+    {
+        const double micros = (double)instance->ticks * microsPerTick / numBlocks;
+        result.outputHashes.push_back(instance->outputHash);
+        result.meanMicrosPerBlock += micros / numInstances;
+        result.maxMicrosPerBlock = juce::jmax(result.maxMicrosPerBlock, micros);
+    }
+    return result;
+}
+}
+
+int main()
+{
+    // Each session rendered on its own, the reference for every instance playing it
+    std::vector<juce::uint64> soloHashes;
+    for (int session = 0; session < numSessions; ++session)
+        soloHashes.push_back(run(1, session).outputHashes[0]);
+    
+    std::printf("%d s of audio at %d samples per block, %.0f us per block in real time\n",
+                (int)secondsPerRun, blockSize, 1.0e6 * blockSize / testSampleRate);
+    std::printf("instances   mean us/block   max us/block   mean %% of real time   cross-talk\n");
+    
+    bool isIsolated = true;
+    for (const int numInstances : { 1, 16, 64, 256 })
+    {
+        const auto result = run(numInstances);
+        
+        int numDiffering = 0;
+        for (int i = 0; i < numInstances; ++i)
+            numDiffering += result.outputHashes[(size_t)i] != soloHashes[(size_t)(i % numSessions)] ? 1 : 0;
+        isIsolated = isIsolated && numDiffering == 0;
+        
+        const double realTimePercent = 100.0 * result.meanMicrosPerBlock / (1.0e6 * blockSize / testSampleRate);
+        std::printf("%9d   %13.2f   %12.2f   %19.3f   %s\n", numInstances, result.meanMicrosPerBlock, result.maxMicrosPerBlock,
+                    realTimePercent, numDiffering == 0 ? "none" : (juce::String(numDiffering) + " instances differ").toRawUTF8());
+    }
+    
+    return isIsolated ? 0 : 1;
+}
@@ -3,7 +3,18 @@
 
 ShequencerAudioProcessorEditor::ShequencerAudioProcessorEditor (ShequencerAudioProcessor& p)
     : AudioProcessorEditor (&p),
-      vBlankAttachment(this, [this] {
+      vBlankAttachment(this, [this, &p] {
+          // Patterns the audio thread loaded (MIDI pattern select) show up here
+          p.syncEditedTracks();
+          
+          // A track that was switched off can't stay selected
+          if (p.editedTrack >= p.getPlaybackState().numTracks)
+              selectTrack(0);
+          
+          // Lay the pages out again once the audio thread has taken a new CC lane count
+          if (p.getEditedTrackState().numCCLanes != shownCCLanes)
+              updatePageVisibility();
+          
           if (currentPage == 0) {
               if (noteLaneComp) noteLaneComp->tick();
               if (octaveLaneComp) octaveLaneComp->tick();
@@ -15,83 +26,89 @@ ShequencerAudioProcessorEditor::ShequencerAudioProcessorEditor (ShequencerAudioP
               if (velocityLaneComp) velocityLaneComp->repaint();
               if (lengthLaneComp) lengthLaneComp->repaint();
           } else {
-              if (ccLane1Comp) ccLane1Comp->tick();
-              if (ccLane2Comp) ccLane2Comp->tick();
-              if (ccLane3Comp) ccLane3Comp->tick();
-              if (ccLane4Comp) ccLane4Comp->tick();
-
-              if (ccLane1Comp) ccLane1Comp->repaint();
-              if (ccLane2Comp) ccLane2Comp->repaint();
-              if (ccLane3Comp) ccLane3Comp->repaint();
-              if (ccLane4Comp) ccLane4Comp->repaint();
+              // CHORD lanes span whatever chord set the loaded pattern brings
+              const int numChords = p.getLoadedChordTable().numChords;
+              const int firstShown = (currentPage - 1) * ccLanesPerPage;
+              
+              for (int i = firstShown; i < juce::jmin(firstShown + ccLanesPerPage, shownCCLanes); ++i)
+              {
+                  auto& comp = ccLaneComps[(size_t)i];
+                  comp->tick();
+                  if (p.getEditedTrack().lanes.midiCC[(size_t)(ShequencerAudioProcessor::firstCCLaneIndex + i)] == 130)
+                      comp->setRange(0, numChords);
+                  comp->repaint();
+              }
           }
 
+          masterTriggerComp.tick();
           masterTriggerComp.repaint();
           bankSelectorComp.repaint();
           patternSlotsComp.repaint();
           shuffleComp.repaint();
           pageSelectorComp.repaint();
+          trackSelectorComp.repaint();
       }),
-      masterTriggerComp(p), bankSelectorComp(p), patternSlotsComp(p), shuffleComp(p), fileOpsComp(p)
+      masterTriggerComp(p), bankSelectorComp(p), patternSlotsComp(p), shuffleComp(p), fileOpsComp(p), pageSelectorComp(p), trackSelectorComp(p)
 {
     setWantsKeyboardFocus(true);
     addAndMakeVisible(mainContainer);
     mainContainer.addAndMakeVisible(masterTriggerComp);
     mainContainer.addAndMakeVisible(pageSelectorComp);
     
-    noteLaneComp = std::make_unique<LaneComponent>(p.noteLane, "NOTE", Theme::noteColor, 0, 11, 6);
+    noteLaneComp = std::make_unique<LaneComponent>(p, ShequencerAudioProcessor::noteLaneIndex, "NOTE", Theme::noteColor, 0, 11, 6);
     noteLaneComp->valueFormatter = [](int val) {
         const char* notes[] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
         if (val >= 0 && val < 12) return juce::String(notes[val]);
         return juce::String(val);
     };
     noteLaneComp->onStepShiftClicked = [&](int step, bool isTriggerRow) {
-        if (isTriggerRow) p.setLaneTriggerIndex(p.noteLane, step);
-        else p.setLaneValueIndex(p.noteLane, step);
+        if (isTriggerRow) p.setLaneTriggerIndex(ShequencerAudioProcessor::noteLaneIndex, step);
+        else p.setLaneValueIndex(ShequencerAudioProcessor::noteLaneIndex, step);
     };
     noteLaneComp->onResetClicked = [&](bool resetAll) {
         if (resetAll) p.resetAllLanes();
-        else p.resetLane(p.noteLane, 0); // C
+        else p.resetLane(ShequencerAudioProcessor::noteLaneIndex, 0); // C
     };
     noteLaneComp->onLabelClicked = [&](bool shift) {
-        if (shift) p.resetLane(p.noteLane, 0);
-        else p.syncLaneToBar(p.noteLane);
+        if (shift) p.resetLane(ShequencerAudioProcessor::noteLaneIndex, 0);
+        else p.syncLaneToBar(ShequencerAudioProcessor::noteLaneIndex);
     };
+    noteLaneComp->showsMidiChannel = true; // Notes go out on the note lane's channel
     mainContainer.addAndMakeVisible(*noteLaneComp);
     
-    octaveLaneComp = std::make_unique<LaneComponent>(p.octaveLane, "OCT", Theme::octaveColor, -2, 8, 5);
+    octaveLaneComp = std::make_unique<LaneComponent>(p, ShequencerAudioProcessor::octaveLaneIndex, "OCT", Theme::octaveColor, -2, 8, 5);
     octaveLaneComp->valueFormatter = [](int val) { return juce::String(val); };
     octaveLaneComp->onStepShiftClicked = [&](int step, bool isTriggerRow) {
-        if (isTriggerRow) p.setLaneTriggerIndex(p.octaveLane, step);
-        else p.setLaneValueIndex(p.octaveLane, step);
+        if (isTriggerRow) p.setLaneTriggerIndex(ShequencerAudioProcessor::octaveLaneIndex, step);
+        else p.setLaneValueIndex(ShequencerAudioProcessor::octaveLaneIndex, step);
     };
     octaveLaneComp->onResetClicked = [&](bool resetAll) {
         if (resetAll) p.resetAllLanes();
-        else p.resetLane(p.octaveLane, 3); // 3
+        else p.resetLane(ShequencerAudioProcessor::octaveLaneIndex, 3); // 3
     };
     octaveLaneComp->onLabelClicked = [&](bool shift) {
-        if (shift) p.resetLane(p.octaveLane, 3);
-        else p.syncLaneToBar(p.octaveLane);
+        if (shift) p.resetLane(ShequencerAudioProcessor::octaveLaneIndex, 3);
+        else p.syncLaneToBar(ShequencerAudioProcessor::octaveLaneIndex);
     };
     mainContainer.addAndMakeVisible(*octaveLaneComp);
     
-    velocityLaneComp = std::make_unique<LaneComponent>(p.velocityLane, "VEL", Theme::velocityColor, 0, 127, 63);
+    velocityLaneComp = std::make_unique<LaneComponent>(p, ShequencerAudioProcessor::velocityLaneIndex, "VEL", Theme::velocityColor, 0, 127, 63);
     velocityLaneComp->valueFormatter = [](int val) { return juce::String(val); };
     velocityLaneComp->onStepShiftClicked = [&](int step, bool isTriggerRow) {
-        if (isTriggerRow) p.setLaneTriggerIndex(p.velocityLane, step);
-        else p.setLaneValueIndex(p.velocityLane, step);
+        if (isTriggerRow) p.setLaneTriggerIndex(ShequencerAudioProcessor::velocityLaneIndex, step);
+        else p.setLaneValueIndex(ShequencerAudioProcessor::velocityLaneIndex, step);
     };
     velocityLaneComp->onResetClicked = [&](bool resetAll) {
         if (resetAll) p.resetAllLanes();
-        else p.resetLane(p.velocityLane, 64); // 64
+        else p.resetLane(ShequencerAudioProcessor::velocityLaneIndex, 64); // 64
     };
     velocityLaneComp->onLabelClicked = [&](bool shift) {
-        if (shift) p.resetLane(p.velocityLane, 64);
-        else p.syncLaneToBar(p.velocityLane);
+        if (shift) p.resetLane(ShequencerAudioProcessor::velocityLaneIndex, 64);
+        else p.syncLaneToBar(ShequencerAudioProcessor::velocityLaneIndex);
     };
     mainContainer.addAndMakeVisible(*velocityLaneComp);
     
-    lengthLaneComp = std::make_unique<LaneComponent>(p.lengthLane, "LEN", Theme::lengthColor, 0, 9, 5);
+    lengthLaneComp = std::make_unique<LaneComponent>(p, ShequencerAudioProcessor::lengthLaneIndex, "LEN", Theme::lengthColor, 0, 9, 5);
     lengthLaneComp->valueFormatter = [](int val) -> juce::String {
         switch(val) {
             case 0: return "OFF";
@@ -108,92 +125,73 @@ ShequencerAudioProcessorEditor::ShequencerAudioProcessorEditor (ShequencerAudioP
         }
     };
     lengthLaneComp->onStepShiftClicked = [&](int step, bool isTriggerRow) {
-        if (isTriggerRow) p.setLaneTriggerIndex(p.lengthLane, step);
-        else p.setLaneValueIndex(p.lengthLane, step);
+        if (isTriggerRow) p.setLaneTriggerIndex(ShequencerAudioProcessor::lengthLaneIndex, step);
+        else p.setLaneValueIndex(ShequencerAudioProcessor::lengthLaneIndex, step);
     };
     lengthLaneComp->onResetClicked = [&](bool resetAll) {
         if (resetAll) p.resetAllLanes();
-        else p.resetLane(p.lengthLane, 5); // 32n
+        else p.resetLane(ShequencerAudioProcessor::lengthLaneIndex, 5); // 32n
     };
     lengthLaneComp->onLabelClicked = [&](bool shift) {
-        if (shift) p.resetLane(p.lengthLane, 5);
-        else p.syncLaneToBar(p.lengthLane);
+        if (shift) p.resetLane(ShequencerAudioProcessor::lengthLaneIndex, 5);
+        else p.syncLaneToBar(ShequencerAudioProcessor::lengthLaneIndex);
     };
     mainContainer.addAndMakeVisible(*lengthLaneComp);
     
     // Initialize CC Lanes
-    auto setupCCLane = [&](std::unique_ptr<LaneComponent>& comp, SequencerLane& lane, juce::String name) {
-        comp = std::make_unique<LaneComponent>(lane, name, Theme::controllerColor, 0, 127, 63, true);
-        comp->valueFormatter = [&lane](int val) -> juce::String {
-            if (lane.midiCC == 130) {
-                switch(val) {
-                    case 0: return "OFF";
-                    // 3-Note Chords (1-12)
-                    case 1: return "Maj";
-                    case 2: return "Min";
-                    case 3: return "Dim";
-                    case 4: return "Aug";
-                    case 5: return "Sus2";
-                    case 6: return "Sus4";
-                    case 7: return "Pow";
-                    case 8: return "Maj/1";
-                    case 9: return "Min/1";
-                    case 10: return "Maj/2";
-                    case 11: return "Min/2";
-                    case 12: return "Oct";
-                    // 4-Note Chords (13-24)
-                    case 13: return "Maj7";
-                    case 14: return "Min7";
-                    case 15: return "Dom7";
-                    case 16: return "Dim7";
-                    case 17: return "hDim7";
-                    case 18: return "mM7";
-                    case 19: return "Maj6";
-                    case 20: return "Min6";
-                    case 21: return "Maj9";
-                    case 22: return "Min9";
-                    case 23: return "7sus";
-                    case 24: return "7#9";
-                    default: return juce::String(val);
-                }
+    auto setupCCLane = [&](std::unique_ptr<LaneComponent>& comp, int laneIndex, juce::String name) {
+        // Follows the edited track
+        auto getMidiCC = [&p, laneIndex] { return p.getEditedTrack().lanes.midiCC[(size_t)laneIndex]; };
+        comp = std::make_unique<LaneComponent>(p, laneIndex, name, Theme::controllerColor, 0, 127, 63, true);
+        comp->showsMidiChannel = true;
+        comp->valueFormatter = [&p, getMidiCC](int val) -> juce::String {
+            if (getMidiCC() == 130) {
+                const auto& chords = p.getLoadedChordTable();
+                if (val <= 0) return "OFF";
+                if (chords.numChords > 0) return juce::String(chords.get(val).name.data());
             }
             return juce::String(val);
         };
-        comp->onStepShiftClicked = [&](int step, bool isTriggerRow) {
-            if (isTriggerRow) p.setLaneTriggerIndex(lane, step);
-            else p.setLaneValueIndex(lane, step);
+        comp->onStepShiftClicked = [&p, laneIndex](int step, bool isTriggerRow) {
+            if (isTriggerRow) p.setLaneTriggerIndex(laneIndex, step);
+            else p.setLaneValueIndex(laneIndex, step);
         };
-        comp->onResetClicked = [&](bool resetAll) {
+        comp->onResetClicked = [&p, laneIndex](bool resetAll) {
             if (resetAll) p.resetAllLanes();
-            else p.resetLane(lane, 0);
+            else p.resetLane(laneIndex, 0);
         };
-        comp->onLabelClicked = [&](bool shift) {
+        comp->onLabelClicked = [&p, getMidiCC, &comp, laneIndex](bool shift) {
             if (shift) {
-                p.resetLane(lane, 0);
+                p.resetLane(laneIndex, 0);
             } else {
                 // Show CC Menu
+                const int midiCC = getMidiCC();
                 juce::PopupMenu m;
-                m.addItem(1, "OFF", true, lane.midiCC == 0);
-                m.addItem(2, "PGM", true, lane.midiCC == 128);
-                m.addItem(3, "PRESSURE", true, lane.midiCC == 129);
-                m.addItem(4, "CHORDS", true, lane.midiCC == 130);
+                m.addItem(1, "OFF", true, midiCC == 0);
+                m.addItem(2, "PGM", true, midiCC == 128);
+                m.addItem(3, "PRESSURE", true, midiCC == 129);
+                m.addItem(4, "CHORDS", true, midiCC == 130);
                 for(int i=1; i<=127; ++i)
-                    m.addItem(i+4, "CC " + juce::String(i), true, lane.midiCC == i);
+                    m.addItem(i+4, "CC " + juce::String(i), true, midiCC == i);
                 
-                m.showMenuAsync(juce::PopupMenu::Options(), [&lane, &comp](int result) {
-                    if (result == 1) lane.midiCC = 0;
-                    else if (result == 2) lane.midiCC = 128;
-                    else if (result == 3) lane.midiCC = 129;
-                    else if (result == 4) lane.midiCC = 130;
-                    else if (result > 4) lane.midiCC = result - 4;
+                m.showMenuAsync(juce::PopupMenu::Options(), [&p, &comp, laneIndex](int result) {
+                    int newCC = 0;
+                    if (result == 1) newCC = 0;
+                    else if (result == 2) newCC = 128;
+                    else if (result == 3) newCC = 129;
+                    else if (result == 4) newCC = 130;
+                    else if (result > 4) newCC = result - 4;
                     
                     if (result > 0) {
+                        p.sendLaneEdit(LaneEditCommand::Type::SetMidiCC, laneIndex, newCC);
+                        
+                        // The lane may not have taken the edit yet, so name it from what we sent
                         juce::String newName;
-                        if (lane.midiCC == 0) { newName = "OFF"; comp->setRange(0, 127); }
-                        else if (lane.midiCC == 128) { newName = "PGM"; comp->setRange(0, 127); }
-                        else if (lane.midiCC == 129) { newName = "PRESSURE"; comp->setRange(0, 127); }
-                        else if (lane.midiCC == 130) { newName = "CHORD"; comp->setRange(0, 24); }
-                        else { newName = "CC " + juce::String(lane.midiCC); comp->setRange(0, 127); }
+                        if (newCC == 0) { newName = "OFF"; comp->setRange(0, 127); }
+                        else if (newCC == 128) { newName = "PGM"; comp->setRange(0, 127); }
+                        else if (newCC == 129) { newName = "PRESSURE"; comp->setRange(0, 127); }
+                        else if (newCC == 130) { newName = "CHORD"; comp->setRange(0, p.getLoadedChordTable().numChords); }
+                        else { newName = "CC " + juce::String(newCC); comp->setRange(0, 127); }
                         
                         comp->setLaneName(newName);
                     }
@@ -201,23 +199,17 @@ ShequencerAudioProcessorEditor::ShequencerAudioProcessorEditor (ShequencerAudioP
             }
         };
         
-        // Set initial name
-        juce::String initialName;
-        if (lane.midiCC == 0) { initialName = "OFF"; comp->setRange(0, 127); }
-        else if (lane.midiCC == 128) { initialName = "PGM"; comp->setRange(0, 127); }
-        else if (lane.midiCC == 129) { initialName = "PRESSURE"; comp->setRange(0, 127); }
-        else if (lane.midiCC == 130) { initialName = "CHORD"; comp->setRange(0, 24); }
-        else { initialName = "CC " + juce::String(lane.midiCC); comp->setRange(0, 127); }
-        
-        comp->setLaneName(initialName);
-        
-        mainContainer.addAndMakeVisible(*comp);
+        mainContainer.addChildComponent(*comp);
     };
     
-    setupCCLane(ccLane1Comp, p.ccLane1, "CC 1");
-    setupCCLane(ccLane2Comp, p.ccLane2, "CC 2");
-    setupCCLane(ccLane3Comp, p.ccLane3, "CC 3");
-    setupCCLane(ccLane4Comp, p.ccLane4, "CC 4");
+    for (int i = 0; i < ShequencerAudioProcessor::maxCCLanes; ++i)
+        setupCCLane(ccLaneComps[(size_t)i], ShequencerAudioProcessor::firstCCLaneIndex + i, "CC " + juce::String(i + 1));
+    
+    // Set initial names
+    updateCCLaneNames();
+    
+    trackSelectorComp.onTrackSelected = [this](int track) { selectTrack(track); };
+    mainContainer.addAndMakeVisible(trackSelectorComp);
     
     pageSelectorComp.onPageChanged = [this] { 
         currentPage = pageSelectorComp.currentPage;
@@ -249,8 +241,21 @@ void ShequencerAudioProcessorEditor::paint (juce::Graphics& g)
     g.fillAll (juce::Colours::black);
 }
 
+int ShequencerAudioProcessorEditor::getNumPages() const
+{
+    return 1 + (shownCCLanes + ccLanesPerPage - 1) / ccLanesPerPage;
+}
+
 void ShequencerAudioProcessorEditor::updatePageVisibility()
 {
+    auto& p = static_cast<ShequencerAudioProcessor&>(processor);
+    shownCCLanes = p.getEditedTrackState().numCCLanes;
+    
+    // Switching lanes off can take the page we are on away
+    currentPage = juce::jmin(currentPage, getNumPages() - 1);
+    pageSelectorComp.currentPage = currentPage;
+    pageSelectorComp.numPages = getNumPages();
+    
     bool showPage1 = (currentPage == 0);
     
     if (noteLaneComp) noteLaneComp->setVisible(showPage1);
@@ -258,11 +263,10 @@ void ShequencerAudioProcessorEditor::updatePageVisibility()
     if (velocityLaneComp) velocityLaneComp->setVisible(showPage1);
     if (lengthLaneComp) lengthLaneComp->setVisible(showPage1);
     
-    if (ccLane1Comp) ccLane1Comp->setVisible(!showPage1);
-    if (ccLane2Comp) ccLane2Comp->setVisible(!showPage1);
-    if (ccLane3Comp) ccLane3Comp->setVisible(!showPage1);
-    if (ccLane4Comp) ccLane4Comp->setVisible(!showPage1);
+    for (int i = 0; i < ShequencerAudioProcessor::maxCCLanes; ++i)
+        ccLaneComps[(size_t)i]->setVisible(i < shownCCLanes && 1 + i / ccLanesPerPage == currentPage);
     
+    pageSelectorComp.repaint();
     resized();
 }
 
@@ -318,16 +322,15 @@ void ShequencerAudioProcessorEditor::resized()
     }
     else
     {
-        if (ccLane1Comp) ccLane1Comp->setBounds(area.removeFromTop(laneHeight));
-        area.removeFromTop(gap);
-        
-        if (ccLane2Comp) ccLane2Comp->setBounds(area.removeFromTop(laneHeight));
-        area.removeFromTop(gap);
-        
-        if (ccLane3Comp) ccLane3Comp->setBounds(area.removeFromTop(laneHeight));
-        area.removeFromTop(gap);
+        // Partly filled last page keeps the lane slots in place
+        auto lanesArea = area.removeFromTop(ccLanesPerPage * laneHeight + (ccLanesPerPage - 1) * gap);
+        const int firstShown = (currentPage - 1) * ccLanesPerPage;
         
-        if (ccLane4Comp) ccLane4Comp->setBounds(area.removeFromTop(laneHeight));
+        for (int i = firstShown; i < juce::jmin(firstShown + ccLanesPerPage, ShequencerAudioProcessor::maxCCLanes); ++i)
+        {
+            ccLaneComps[(size_t)i]->setBounds(lanesArea.removeFromTop(laneHeight));
+            lanesArea.removeFromTop(gap);
+        }
     }
     
     area.removeFromTop(gap);
@@ -336,8 +339,8 @@ void ShequencerAudioProcessorEditor::resized()
     
     // Left Margin: 70px (20px Col 1 + 50px Col 2)
     auto leftMargin = patternRow.removeFromLeft(70);
-    // Col 1 (0-20): Empty
-    leftMargin.removeFromLeft(20);
+    // Col 1 (0-20): Track Selector
+    trackSelectorComp.setBounds(leftMargin.removeFromLeft(20));
     // Col 2 (20-70): Bank Selector
     // Center 40px wide component in 50px space
     bankSelectorComp.setBounds(leftMargin.getX() + 5, leftMargin.getY(), 40, 40);
@@ -364,14 +367,42 @@ void ShequencerAudioProcessorEditor::resized()
     patternSlotsComp.setBounds(patternRow);
 }
 
+void ShequencerAudioProcessorEditor::selectTrack(int track)
+{
+    auto& p = static_cast<ShequencerAudioProcessor&>(processor);
+    p.editedTrack = juce::jlimit(0, ShequencerAudioProcessor::maxTracks - 1, track);
+    
+    updateCCLaneNames();
+    updatePageVisibility();
+    trackSelectorComp.repaint();
+}
+
+void ShequencerAudioProcessorEditor::updateCCLaneNames()
+{
+    auto& p = static_cast<ShequencerAudioProcessor&>(processor);
+    
+    for (int i = 0; i < ShequencerAudioProcessor::maxCCLanes; ++i)
+    {
+        auto& comp = ccLaneComps[(size_t)i];
+        const int midiCC = p.getEditedTrack().lanes.midiCC[(size_t)(ShequencerAudioProcessor::firstCCLaneIndex + i)];
+        
+        juce::String name;
+        if (midiCC == 0) { name = "OFF"; comp->setRange(0, 127); }
+        else if (midiCC == 128) { name = "PGM"; comp->setRange(0, 127); }
+        else if (midiCC == 129) { name = "PRESSURE"; comp->setRange(0, 127); }
+        else if (midiCC == 130) { name = "CHORD"; comp->setRange(0, p.getLoadedChordTable().numChords); }
+        else { name = "CC " + juce::String(midiCC); comp->setRange(0, 127); }
+        
+        comp->setLaneName(name);
+    }
+}
+
 bool ShequencerAudioProcessorEditor::keyPressed(const juce::KeyPress& key)
 {
     if (key == juce::KeyPress::tabKey)
     {
-        currentPage = !currentPage;
-        pageSelectorComp.currentPage = currentPage;
+        currentPage = (currentPage + 1) % getNumPages();
         updatePageVisibility();
-        pageSelectorComp.repaint();
         return true;
     }
     return false;
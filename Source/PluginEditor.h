@@ -22,8 +22,9 @@ namespace Theme
 class ColorPickerClient : public juce::Component
 {
 public:
-    ColorPickerClient(juce::Colour& target, juce::Colour initialColor, std::function<void()> callback)
-        : targetColor(target), onUpdate(callback)
+    // Picked colours go out through the callback; target is only where the picker starts
+    ColorPickerClient(juce::Colour target, juce::Colour initialColor, std::function<void(juce::Colour)> callback)
+        : onUpdate(callback)
     {
         if (target.isTransparent())
         {
@@ -131,20 +132,18 @@ public:
     
     void updateTarget()
     {
-        targetColor = juce::Colour::fromHSV(currentHue, currentSat, currentBri, 1.0f);
-        if (onUpdate) onUpdate();
+        if (onUpdate) onUpdate(juce::Colour::fromHSV(currentHue, currentSat, currentBri, 1.0f));
     }
     
-    juce::Colour& targetColor;
-    std::function<void()> onUpdate;
+    std::function<void(juce::Colour)> onUpdate;
     float currentHue, currentSat, currentBri;
 };
 
 class LaneComponent : public juce::Component
 {
 public:
-    LaneComponent(SequencerLane& lane, juce::String name, juce::Colour color, int minV, int maxV, int maxRR, bool showSmooth = false)
-        : laneData(lane), laneName(name), laneColor(color), minVal(minV), maxVal(maxV), maxRandomRange(maxRR), showSmoothing(showSmooth)
+    LaneComponent(ShequencerAudioProcessor& p, int laneIdx, juce::String name, juce::Colour color, int minV, int maxV, int maxRR, bool showSmooth = false)
+        : processor(p), laneIndex(laneIdx), laneName(name), laneColor(color), minVal(minV), maxVal(maxV), maxRandomRange(maxRR), showSmoothing(showSmooth)
     {
         setOpaque(true);
     }
@@ -153,16 +152,19 @@ public:
     std::function<void(int, bool)> onStepShiftClicked;
     std::function<void(bool)> onResetClicked;
     std::function<void(bool)> onLabelClicked; // bool isShift
+    bool showsMidiChannel = false; // Right click on the label picks the lane's output channel
     
     void setLaneName(juce::String newName) { laneName = newName; repaint(); }
     void setRange(int min, int max) { minVal = min; maxVal = max; repaint(); }
     
     juce::Colour getEffectiveColor() const {
-        return laneData.customColor.isTransparent() ? laneColor : laneData.customColor;
+        return lanes().customColor[(size_t)laneIndex].isTransparent() ? laneColor : lanes().customColor[(size_t)laneIndex];
     }
     
     void tick()
     {
+        flushStroke(false);
+        
         if (valueDisplayAlpha > 0.0f)
         {
             valueDisplayAlpha -= 0.05f;
@@ -234,7 +236,7 @@ public:
         g.setColour(juce::Colours::black);
         g.fillRect(masterToggle.reduced(1));
         
-        g.setColour(Theme::masterColor.withAlpha(laneData.enableMasterSource ? 1.0f : 0.33f));
+        g.setColour(Theme::masterColor.withAlpha(lanes().usesMasterSource(laneIndex) ? 1.0f : 0.33f));
         g.fillRect(masterToggle.reduced(1));
         
         // Local Toggle (Lane Color)
@@ -243,7 +245,7 @@ public:
         g.setColour(juce::Colours::black);
         g.fillRect(localToggle.reduced(1));
         
-        g.setColour(getEffectiveColor().withAlpha(laneData.enableLocalSource ? 1.0f : 0.33f));
+        g.setColour(getEffectiveColor().withAlpha(lanes().usesLocalSource(laneIndex) ? 1.0f : 0.33f));
         g.fillRect(localToggle.reduced(1));
 
         // Right Controls (Col 4)
@@ -337,42 +339,42 @@ public:
         g.setColour(juce::Colours::black);
         g.fillRect(valLoopRect.reduced(1));
         g.setColour(getEffectiveColor());
-        g.drawText(juce::String(laneData.valueLoopLength), valLoopRect, juce::Justification::centred);
+        g.drawText(juce::String(lanes().valueLoopLength[(size_t)laneIndex]), valLoopRect, juce::Justification::centred);
         
         // Draw Value Reset Control
         g.fillRect(valResetRect);
         g.setColour(juce::Colours::black);
         g.fillRect(valResetRect.reduced(1));
         g.setColour(getEffectiveColor());
-        g.drawText(laneData.valueResetInterval == 0 ? "FREE" : juce::String(laneData.valueResetInterval), valResetRect, juce::Justification::centred);
+        g.drawText(lanes().valueResetInterval[(size_t)laneIndex] == 0 ? "FREE" : juce::String(lanes().valueResetInterval[(size_t)laneIndex]), valResetRect, juce::Justification::centred);
 
         // Draw Value Direction Control
         g.fillRect(valDirRect);
         g.setColour(juce::Colours::black);
         g.fillRect(valDirRect.reduced(1));
         g.setColour(getEffectiveColor());
-        g.drawText(getDirectionString(laneData.valueDirection), valDirRect, juce::Justification::centred);
+        g.drawText(getDirectionString(lanes().valueDirection[(size_t)laneIndex]), valDirRect, juce::Justification::centred);
         
         // Draw Trigger Reset Control
         g.fillRect(trigResetRect);
         g.setColour(juce::Colours::black);
         g.fillRect(trigResetRect.reduced(1));
         g.setColour(getEffectiveColor());
-        g.drawText(laneData.triggerResetInterval == 0 ? "FREE" : juce::String(laneData.triggerResetInterval), trigResetRect, juce::Justification::centred);
+        g.drawText(lanes().triggerResetInterval[(size_t)laneIndex] == 0 ? "FREE" : juce::String(lanes().triggerResetInterval[(size_t)laneIndex]), trigResetRect, juce::Justification::centred);
 
         // Draw Trigger Direction Control
         g.fillRect(trigDirRect);
         g.setColour(juce::Colours::black);
         g.fillRect(trigDirRect.reduced(1));
         g.setColour(getEffectiveColor());
-        g.drawText(getDirectionString(laneData.triggerDirection), trigDirRect, juce::Justification::centred);
+        g.drawText(getDirectionString(lanes().triggerDirection[(size_t)laneIndex]), trigDirRect, juce::Justification::centred);
         
         // Draw Trigger Loop Control (Outline only)
         g.fillRect(trigLoopRect);
         g.setColour(juce::Colours::black);
         g.fillRect(trigLoopRect.reduced(1));
         g.setColour(getEffectiveColor());
-        g.drawText(juce::String(laneData.triggerLoopLength), trigLoopRect, juce::Justification::centred);
+        g.drawText(juce::String(lanes().triggerLoopLength[(size_t)laneIndex]), trigLoopRect, juce::Justification::centred);
         
         // Draw Shift Triangles
         auto drawTriangle = [&](juce::Rectangle<int> r, bool left) {
@@ -471,12 +473,12 @@ public:
         g.fillRect(randomRangeRect.reduced(1));
         g.setColour(getEffectiveColor());
         g.setFont(juce::FontOptions("Arial", 12.0f, juce::Font::bold));
-        juce::String rangeText = (laneData.randomRange == 0) ? "FULL" : ("+/-" + juce::String(laneData.randomRange));
+        juce::String rangeText = (lanes().randomRange[(size_t)laneIndex] == 0) ? "FULL" : ("+/-" + juce::String(lanes().randomRange[(size_t)laneIndex]));
         g.drawText(rangeText, randomRangeRect, juce::Justification::centred);
 
         // Draw Smoothing Slider (Col 5)
-        bool isCC = (laneData.midiCC >= 1 && laneData.midiCC <= 127);
-        bool isPressure = (laneData.midiCC == 129);
+        bool isCC = (lanes().midiCC[(size_t)laneIndex] >= 1 && lanes().midiCC[(size_t)laneIndex] <= 127);
+        bool isPressure = (lanes().midiCC[(size_t)laneIndex] == 129);
         
         if (showSmoothing && (isCC || isPressure))
         {
@@ -497,9 +499,9 @@ public:
             g.fillRect(smoothRect.reduced(1));
             
             // Fill from bottom
-            if (laneData.smoothing > 0)
+            if (lanes().smoothing[(size_t)laneIndex] > 0)
             {
-                float norm = (float)laneData.smoothing / 100.0f;
+                float norm = (float)lanes().smoothing[(size_t)laneIndex] / 100.0f;
                 int fillH = (int)(smoothRect.getHeight() * norm);
                 int fillY = smoothRect.getBottom() - fillH;
                 
@@ -510,12 +512,22 @@ public:
 
         // Draw Steps
         area.removeFromRight(130); // Col 4 (100) + Col 5 (30)
-        float stepWidth = area.getWidth() / 16.0f;
+        int numSteps = processor.getVisibleStepCount();
+        float stepWidth = area.getWidth() / (float)numSteps;
         
         // Save area for overlay
         auto stepsArea = area;
         
-        for (size_t i = 0; i < 16; ++i)
+        // Show our own stroke until the audio thread has taken it, so the drawing doesn't flicker back
+        bool showStroke = isStrokeActive || !processor.isLaneEditApplied(lastStrokeTicket);
+        const auto& shownValues = showStroke ? strokeValues : lanes().values[(size_t)laneIndex];
+        const auto& shownTriggers = showStroke ? strokeTriggers : lanes().triggers[(size_t)laneIndex];
+        
+        const auto& playback = processor.getEditedTrackState();
+        int activeValueStep = playback.activeValueStep[(size_t)laneIndex];
+        int activeTriggerStep = playback.activeTriggerStep[(size_t)laneIndex];
+        
+        for (size_t i = 0; i < (size_t)numSteps; ++i)
         {
             auto stepArea = area.removeFromLeft((int)stepWidth); // No gap
             
@@ -531,14 +543,14 @@ public:
             auto effectiveBarArea = fullBarArea;
             
             // Dim if outside loop
-            float valAlpha = (i < (size_t)laneData.valueLoopLength) ? 1.0f : 0.3f;
-            float trigAlpha = (i < (size_t)laneData.triggerLoopLength) ? 1.0f : 0.3f;
+            float valAlpha = (i < (size_t)lanes().valueLoopLength[(size_t)laneIndex]) ? 1.0f : 0.3f;
+            float trigAlpha = (i < (size_t)lanes().triggerLoopLength[(size_t)laneIndex]) ? 1.0f : 0.3f;
             
             // Background for bar area
             g.setColour(getEffectiveColor().withAlpha(0.33f * valAlpha));
             g.fillRect(effectiveBarArea);
             
-            float normVal = (float)(laneData.values[i] - minVal) / (float)(maxVal - minVal);
+            float normVal = (float)(shownValues[i] - minVal) / (float)(maxVal - minVal);
             if (maxVal == minVal) normVal = 0.5f; // Avoid div by zero
             
             int barHeight = (int)(effectiveBarArea.getHeight() * normVal);
@@ -549,7 +561,7 @@ public:
             g.fillRect(fillArea);
             
             // Highlight current step
-            if (i == (size_t)laneData.activeValueStep)
+            if (i == (size_t)activeValueStep)
             {
                 g.setColour(getEffectiveColor().darker(1.0f).withAlpha(0.5f));
                 g.fillRect(effectiveBarArea);
@@ -559,14 +571,14 @@ public:
             g.setColour(getEffectiveColor().withAlpha(trigAlpha));
             g.fillRect(btnArea);
             
-            if (!laneData.triggers[i])
+            if (!shownTriggers[i])
             {
                 g.setColour(juce::Colours::black);
                 g.fillRect(btnArea.reduced(1));
             }
             
             // Highlight current trigger step
-            if (i == (size_t)laneData.activeTriggerStep)
+            if (i == (size_t)activeTriggerStep)
             {
                 g.setColour(getEffectiveColor().darker(1.0f).withAlpha(0.5f));
                 g.fillRect(btnArea);
@@ -611,12 +623,16 @@ public:
                 // Full height hit area
                 if (e.mods.isShiftDown())
                 {
-                    laneData.customColor = juce::Colours::transparentBlack;
+                    processor.sendLaneEdit(LaneEditCommand::Type::SetCustomColor, laneIndex, (int)juce::Colours::transparentBlack.getARGB());
                     repaint();
                 }
                 else
                 {
-                    auto* client = new ColorPickerClient(laneData.customColor, getEffectiveColor(), [this](){ repaint(); });
+                    auto* client = new ColorPickerClient(lanes().customColor[(size_t)laneIndex], getEffectiveColor(), [this](juce::Colour colour)
+                    {
+                        processor.sendLaneEdit(LaneEditCommand::Type::SetCustomColor, laneIndex, (int)colour.getARGB());
+                        repaint();
+                    });
                     juce::CallOutBox::launchAsynchronously(std::unique_ptr<juce::Component>(client), getScreenBounds().removeFromLeft(20), nullptr);
                 }
                 return;
@@ -625,12 +641,12 @@ public:
             // Controls Area (20-70)
             if (e.y >= h - triggerHeight)
             {
-                laneData.enableLocalSource = !laneData.enableLocalSource;
+                processor.sendLaneEdit(LaneEditCommand::Type::SetEnableLocalSource, laneIndex, lanes().usesLocalSource(laneIndex) ? 0 : 1);
                 repaint();
             }
             else if (e.y >= barTopY && e.y < barTopY + triggerHeight)
             {
-                laneData.enableMasterSource = !laneData.enableMasterSource;
+                processor.sendLaneEdit(LaneEditCommand::Type::SetEnableMasterSource, laneIndex, lanes().usesMasterSource(laneIndex) ? 0 : 1);
                 repaint();
             }
             else
@@ -644,7 +660,8 @@ public:
                     
                     if (e.y >= btnY && e.y < btnY + btnH)
                     {
-                        if (onLabelClicked) onLabelClicked(e.mods.isShiftDown());
+                        if (showsMidiChannel && e.mods.isPopupMenu()) showMidiChannelMenu();
+                        else if (onLabelClicked) onLabelClicked(e.mods.isShiftDown());
                     }
                     else
                     {
@@ -685,14 +702,14 @@ public:
             // Value Shift L
             if (e.x >= col1_X && e.x < col1_X + 20 && e.y >= 0 && e.y < ctrlH)
             {
-                laneData.shiftValues(-1);
+                processor.sendLaneEdit(LaneEditCommand::Type::ShiftValues, laneIndex, -1);
                 repaint();
                 return;
             }
             // Value Shift R
             if (e.x >= col1_X + 60 && e.x < col1_X + 80 && e.y >= 0 && e.y < ctrlH)
             {
-                laneData.shiftValues(1);
+                processor.sendLaneEdit(LaneEditCommand::Type::ShiftValues, laneIndex, 1);
                 repaint();
                 return;
             }
@@ -702,14 +719,14 @@ public:
             // Trigger Shift L
             if (e.x >= col1_X && e.x < col1_X + 20 && e.y >= bottomY - ctrlH)
             {
-                laneData.shiftTriggers(-1);
+                processor.sendLaneEdit(LaneEditCommand::Type::ShiftTriggers, laneIndex, -1);
                 repaint();
                 return;
             }
             // Trigger Shift R
             if (e.x >= col1_X + 60 && e.x < col1_X + 80 && e.y >= bottomY - ctrlH)
             {
-                laneData.shiftTriggers(1);
+                processor.sendLaneEdit(LaneEditCommand::Type::ShiftTriggers, laneIndex, 1);
                 repaint();
                 return;
             }
@@ -718,6 +735,7 @@ public:
             if (e.x >= col1_X + 20 && e.x < col1_X + 60 && e.y >= 0 && e.y < ctrlH)
             {
                 isDraggingValueLoop = true;
+                dragParamValue = lanes().valueLoopLength[(size_t)laneIndex];
                 lastMouseY = e.y;
                 lastMouseX = e.x;
                 return;
@@ -727,6 +745,7 @@ public:
             if (e.x >= col1_X && e.x < col1_X + 40 && e.y >= ctrlH + gap && e.y < ctrlH * 2 + gap)
             {
                 isDraggingValueReset = true;
+                dragParamValue = lanes().valueResetInterval[(size_t)laneIndex];
                 lastMouseY = e.y;
                 lastMouseX = e.x;
                 return;
@@ -736,6 +755,7 @@ public:
             if (e.x >= col2_X && e.x < col2_X + 40 && e.y >= ctrlH + gap && e.y < ctrlH * 2 + gap)
             {
                 isDraggingValueDirection = true;
+                dragParamValue = (int)lanes().valueDirection[(size_t)laneIndex];
                 lastMouseY = e.y;
                 lastMouseX = e.x;
                 return;
@@ -755,6 +775,7 @@ public:
             if (e.x >= col2_X && e.x < col2_X + 40 && e.y >= (ctrlH + gap) * 2 + 3 && e.y < (ctrlH + gap) * 2 + ctrlH + 3)
             {
                 isDraggingRandomRange = true;
+                dragParamValue = lanes().randomRange[(size_t)laneIndex];
                 lastMouseY = e.y;
                 lastMouseX = e.x;
                 return;
@@ -764,6 +785,7 @@ public:
             if (e.x >= col2_X && e.x < col2_X + 40 && e.y >= bottomY - (ctrlH * 2) - gap && e.y < bottomY - ctrlH - gap)
             {
                 isDraggingTriggerDirection = true;
+                dragParamValue = (int)lanes().triggerDirection[(size_t)laneIndex];
                 lastMouseY = e.y;
                 lastMouseX = e.x;
                 return;
@@ -773,6 +795,7 @@ public:
             if (e.x >= col1_X && e.x < col1_X + 40 && e.y >= bottomY - (ctrlH * 2) - gap && e.y < bottomY - ctrlH - gap)
             {
                 isDraggingTriggerReset = true;
+                dragParamValue = lanes().triggerResetInterval[(size_t)laneIndex];
                 lastMouseY = e.y;
                 lastMouseX = e.x;
                 return;
@@ -782,6 +805,7 @@ public:
             if (e.x >= col1_X + 20 && e.x < col1_X + 60 && e.y >= bottomY - ctrlH)
             {
                 isDraggingTriggerLoop = true;
+                dragParamValue = lanes().triggerLoopLength[(size_t)laneIndex];
                 lastMouseY = e.y;
                 lastMouseX = e.x;
                 return;
@@ -790,10 +814,11 @@ public:
             return;
         }
         
-        float stepWidth = area.getWidth() / 16.0f;
+        int numSteps = processor.getVisibleStepCount();
+        float stepWidth = area.getWidth() / (float)numSteps;
         int stepIdx = (int)((e.x - 70) / stepWidth);
         
-        if (stepIdx >= 0 && stepIdx < 16 && e.x <= getWidth() - 130)
+        if (stepIdx >= 0 && stepIdx < numSteps && e.x <= getWidth() - 130)
         {
             int triggerHeight = 24;
             bool isTriggerRow = (e.y >= getHeight() - triggerHeight);
@@ -806,6 +831,7 @@ public:
             }
 
             lastEditedStep = stepIdx;
+            beginStroke();
             
             // Check if clicked on Bar or Button
             if (!isTriggerRow)
@@ -817,16 +843,17 @@ public:
                 if (e.mods.isAltDown())
                 {
                     // Relative: Shift all steps by the difference
-                    int diff = val - laneData.values[(size_t)stepIdx];
-                    for(size_t i=0; i<16; ++i)
+                    int diff = val - strokeValues[(size_t)stepIdx];
+                    for(size_t i=0; i<strokeValues.size(); ++i)
                     {
-                        laneData.values[i] = juce::jlimit(minVal, maxVal, laneData.values[i] + diff);
+                        strokeValues[i] = juce::jlimit(minVal, maxVal, strokeValues[i] + diff);
                     }
                 }
                 else
                 {
-                    laneData.values[(size_t)stepIdx] = val;
+                    strokeValues[(size_t)stepIdx] = val;
                 }
+                strokeValuesDirty = true;
                 
                 lastDragValue = val;
                 
@@ -840,8 +867,9 @@ public:
             else
             {
                 isDraggingTrigger = true;
-                targetTriggerState = !laneData.triggers[(size_t)stepIdx];
-                laneData.triggers[(size_t)stepIdx] = targetTriggerState;
+                targetTriggerState = !strokeTriggers[(size_t)stepIdx];
+                strokeTriggers[(size_t)stepIdx] = targetTriggerState;
+                strokeTriggersDirty = true;
             }
             repaint();
         }
@@ -885,8 +913,9 @@ public:
             int delta = (e.x - lastMouseX) - (e.y - lastMouseY); // Right/Up increases
             if (std::abs(delta) > 5) // Sensitivity threshold
             {
-                if (delta > 0) laneData.valueLoopLength = juce::jmin(16, laneData.valueLoopLength + 1);
-                else laneData.valueLoopLength = juce::jmax(1, laneData.valueLoopLength - 1);
+                if (delta > 0) dragParamValue = juce::jmin(LaneBank::maxSteps, dragParamValue + 1);
+                else dragParamValue = juce::jmax(1, dragParamValue - 1);
+                processor.sendLaneEdit(LaneEditCommand::Type::SetValueLoopLength, laneIndex, dragParamValue);
                 
                 lastMouseX = e.x;
                 lastMouseY = e.y;
@@ -900,7 +929,8 @@ public:
             int delta = (e.x - lastMouseX) - (e.y - lastMouseY);
             if (std::abs(delta) > 5) // Sensitivity
             {
-                laneData.valueResetInterval = getNextInterval(laneData.valueResetInterval, delta, e.mods.isShiftDown());
+                dragParamValue = getNextInterval(dragParamValue, delta, e.mods.isShiftDown());
+                processor.sendLaneEdit(LaneEditCommand::Type::SetValueResetInterval, laneIndex, dragParamValue);
                 lastMouseX = e.x;
                 lastMouseY = e.y;
                 repaint();
@@ -913,11 +943,10 @@ public:
             int delta = (e.x - lastMouseX) - (e.y - lastMouseY);
             if (std::abs(delta) > 10) // Lower sensitivity for enum
             {
-                int dir = (int)laneData.valueDirection;
-                if (delta > 0) dir = (dir + 1) % 6;
-                else dir = (dir - 1 + 6) % 6;
+                if (delta > 0) dragParamValue = (dragParamValue + 1) % 6;
+                else dragParamValue = (dragParamValue - 1 + 6) % 6;
                 
-                laneData.valueDirection = (SequencerLane::Direction)dir;
+                processor.sendLaneEdit(LaneEditCommand::Type::SetValueDirection, laneIndex, dragParamValue);
                 lastMouseX = e.x;
                 lastMouseY = e.y;
                 repaint();
@@ -930,8 +959,9 @@ public:
             int delta = (e.x - lastMouseX) - (e.y - lastMouseY);
             if (std::abs(delta) > 5)
             {
-                if (delta > 0) laneData.randomRange = juce::jmin(maxRandomRange, laneData.randomRange + 1);
-                else laneData.randomRange = juce::jmax(0, laneData.randomRange - 1);
+                if (delta > 0) dragParamValue = juce::jmin(maxRandomRange, dragParamValue + 1);
+                else dragParamValue = juce::jmax(0, dragParamValue - 1);
+                processor.sendLaneEdit(LaneEditCommand::Type::SetRandomRange, laneIndex, dragParamValue);
                 
                 lastMouseX = e.x;
                 lastMouseY = e.y;
@@ -945,7 +975,8 @@ public:
             int delta = (e.x - lastMouseX) - (e.y - lastMouseY);
             if (std::abs(delta) > 5)
             {
-                laneData.triggerResetInterval = getNextInterval(laneData.triggerResetInterval, delta, e.mods.isShiftDown());
+                dragParamValue = getNextInterval(dragParamValue, delta, e.mods.isShiftDown());
+                processor.sendLaneEdit(LaneEditCommand::Type::SetTriggerResetInterval, laneIndex, dragParamValue);
                 lastMouseX = e.x;
                 lastMouseY = e.y;
                 repaint();
@@ -958,11 +989,10 @@ public:
             int delta = (e.x - lastMouseX) - (e.y - lastMouseY);
             if (std::abs(delta) > 10)
             {
-                int dir = (int)laneData.triggerDirection;
-                if (delta > 0) dir = (dir + 1) % 6;
-                else dir = (dir - 1 + 6) % 6;
+                if (delta > 0) dragParamValue = (dragParamValue + 1) % 6;
+                else dragParamValue = (dragParamValue - 1 + 6) % 6;
                 
-                laneData.triggerDirection = (SequencerLane::Direction)dir;
+                processor.sendLaneEdit(LaneEditCommand::Type::SetTriggerDirection, laneIndex, dragParamValue);
                 lastMouseX = e.x;
                 lastMouseY = e.y;
                 repaint();
@@ -975,8 +1005,9 @@ public:
             int delta = (e.x - lastMouseX) - (e.y - lastMouseY); // Right/Up increases
             if (std::abs(delta) > 5)
             {
-                if (delta > 0) laneData.triggerLoopLength = juce::jmin(16, laneData.triggerLoopLength + 1);
-                else laneData.triggerLoopLength = juce::jmax(1, laneData.triggerLoopLength - 1);
+                if (delta > 0) dragParamValue = juce::jmin(LaneBank::maxSteps, dragParamValue + 1);
+                else dragParamValue = juce::jmax(1, dragParamValue - 1);
+                processor.sendLaneEdit(LaneEditCommand::Type::SetTriggerLoopLength, laneIndex, dragParamValue);
                 
                 lastMouseX = e.x;
                 lastMouseY = e.y;
@@ -993,15 +1024,17 @@ public:
             auto area = getLocalBounds();
             area.removeFromLeft(70);
             area.removeFromRight(130);
-            float stepWidth = area.getWidth() / 16.0f;
+            int numSteps = processor.getVisibleStepCount();
+            float stepWidth = area.getWidth() / (float)numSteps;
             int stepIdx = (int)((e.x - 70) / stepWidth);
             
             if (isDraggingTrigger)
             {
-                if (stepIdx >= 0 && stepIdx < 16 && stepIdx != lastEditedStep)
+                if (stepIdx >= 0 && stepIdx < numSteps && stepIdx != lastEditedStep)
                 {
                     lastEditedStep = stepIdx;
-                    laneData.triggers[(size_t)stepIdx] = targetTriggerState;
+                    strokeTriggers[(size_t)stepIdx] = targetTriggerState;
+                    strokeTriggersDirty = true;
                     repaint();
                 }
             }
@@ -1015,10 +1048,11 @@ public:
                     int diff = val - lastDragValue;
                     if (diff != 0)
                     {
-                        for(size_t i=0; i<16; ++i)
+                        for(size_t i=0; i<strokeValues.size(); ++i)
                         {
-                            laneData.values[i] = juce::jlimit(minVal, maxVal, laneData.values[i] + diff);
+                            strokeValues[i] = juce::jlimit(minVal, maxVal, strokeValues[i] + diff);
                         }
+                        strokeValuesDirty = true;
                         lastDragValue = val;
                         repaint();
                     }
@@ -1026,9 +1060,10 @@ public:
                 else
                 {
                     // Normal paint
-                    if (stepIdx >= 0 && stepIdx < 16)
+                    if (stepIdx >= 0 && stepIdx < numSteps)
                     {
-                        laneData.values[(size_t)stepIdx] = val;
+                        strokeValues[(size_t)stepIdx] = val;
+                        strokeValuesDirty = true;
                         lastDragValue = val;
                         lastEditedStep = stepIdx;
                         repaint();
@@ -1064,7 +1099,10 @@ public:
     void updateValue(int stepIdx, int y, int h)
     {
         int val = getValueFromY(y, h);
-        laneData.values[(size_t)stepIdx] = val;
+        beginStroke();
+        strokeValues[(size_t)stepIdx] = val;
+        strokeValuesDirty = true;
+        endStroke();
         
         if (valueFormatter)
             lastEditedValue = valueFormatter(val);
@@ -1074,33 +1112,53 @@ public:
         valueDisplayAlpha = 2.0f;
     }
     
+    void showMidiChannelMenu()
+    {
+        const int channel = lanes().midiChannel[(size_t)laneIndex];
+        
+        juce::PopupMenu m;
+        m.addSectionHeader("MIDI CHANNEL");
+        for (int ch = 1; ch <= 16; ++ch)
+            m.addItem(ch, juce::String(ch), true, ch == channel);
+        
+        m.showMenuAsync(juce::PopupMenu::Options(), [&p = processor, lane = laneIndex](int result) {
+            if (result > 0) p.sendLaneEdit(LaneEditCommand::Type::SetMidiChannel, lane, result);
+        });
+    }
+    
     void randomizeValues()
     {
         juce::Random r;
-        for (size_t i = 0; i < 16; ++i)
+        beginStroke();
+        for (size_t i = 0; i < strokeValues.size(); ++i)
         {
-            if (laneData.randomRange == 0)
+            if (lanes().randomRange[(size_t)laneIndex] == 0)
             {
                 // Full Random
-                laneData.values[i] = r.nextInt(maxVal - minVal + 1) + minVal;
+                strokeValues[i] = r.nextInt(maxVal - minVal + 1) + minVal;
             }
             else
             {
                 // Jitter Random (+/- Range)
-                int jitter = r.nextInt(laneData.randomRange * 2 + 1) - laneData.randomRange;
-                laneData.values[i] = juce::jlimit(minVal, maxVal, laneData.values[i] + jitter);
+                int jitter = r.nextInt(lanes().randomRange[(size_t)laneIndex] * 2 + 1) - lanes().randomRange[(size_t)laneIndex];
+                strokeValues[i] = juce::jlimit(minVal, maxVal, strokeValues[i] + jitter);
             }
         }
+        strokeValuesDirty = true;
+        endStroke();
         repaint();
     }
 
     void randomizeTriggers()
     {
         juce::Random r;
-        for (size_t i = 0; i < 16; ++i)
+        beginStroke();
+        for (size_t i = 0; i < strokeTriggers.size(); ++i)
         {
-            laneData.triggers[i] = r.nextBool();
+            strokeTriggers[i] = r.nextBool();
         }
+        strokeTriggersDirty = true;
+        endStroke();
         repaint();
     }
     
@@ -1114,6 +1172,8 @@ public:
         isDraggingTriggerDirection = false;
         isDraggingRandomRange = false;
         isDraggingSmoothing = false;
+        
+        if (isStrokeActive) endStroke();
     }
 
     void mouseMove(const juce::MouseEvent& e) override
@@ -1160,7 +1220,12 @@ public:
     }
 
 private:
-    SequencerLane& laneData;
+    ShequencerAudioProcessor& processor;
+    int laneIndex;
+    
+    // The edited track's lanes, read-only: all edits go through processor.sendLaneEdit
+    const LaneBank& lanes() const { return processor.getEditedTrack().lanes; }
+    
     juce::String laneName;
     juce::Colour laneColor;
     int minVal;
@@ -1186,9 +1251,63 @@ private:
     int lastMouseX = 0;
     int lastMouseY = 0;
     int lastDragValue = 0;
+    int dragParamValue = 0;
+    
+    // Step edits of one mouse stroke are collected here and sent at most once per audio block
+    std::array<int, (size_t)LaneBank::maxSteps> strokeValues {};
+    LaneBank::StepMask strokeTriggers {};
+    bool isStrokeActive = false;
+    bool strokeValuesDirty = false;
+    bool strokeTriggersDirty = false;
+    juce::uint32 lastStrokeTicket = 0;
     
     bool isHoveringRandom = false;
     
+    void beginStroke()
+    {
+        // Carry on from our previous stroke if the audio thread hasn't taken it yet
+        if (processor.isLaneEditApplied(lastStrokeTicket))
+        {
+            strokeValues = lanes().values[(size_t)laneIndex];
+            strokeTriggers = lanes().triggers[(size_t)laneIndex];
+        }
+        isStrokeActive = true;
+    }
+    
+    void endStroke()
+    {
+        isStrokeActive = false;
+        flushStroke(true);
+    }
+    
+    void flushStroke(bool force)
+    {
+        if (!strokeValuesDirty && !strokeTriggersDirty) return;
+        
+        // One command per block while dragging, the audio thread only needs the latest state
+        if (!force && !processor.isLaneEditApplied(lastStrokeTicket)) return;
+        
+        LaneEditCommand command;
+        command.track = processor.editedTrack;
+        command.lane = laneIndex;
+        
+        if (strokeValuesDirty)
+        {
+            command.type = LaneEditCommand::Type::SetValues;
+            command.steps = strokeValues;
+            if (auto ticket = processor.sendLaneEdit(command)) lastStrokeTicket = ticket;
+            strokeValuesDirty = false;
+        }
+        
+        if (strokeTriggersDirty)
+        {
+            command.type = LaneEditCommand::Type::SetTriggers;
+            for (size_t i = 0; i < strokeTriggers.size(); ++i) command.steps[i] = strokeTriggers[i] ? 1 : 0;
+            if (auto ticket = processor.sendLaneEdit(command)) lastStrokeTicket = ticket;
+            strokeTriggersDirty = false;
+        }
+    }
+    
     void updateSmoothing(int y)
     {
         int sliderH = 78;
@@ -1197,20 +1316,20 @@ private:
         
         float norm = 1.0f - ((float)yRel / (float)sliderH);
         norm = juce::jlimit(0.0f, 1.0f, norm);
-        laneData.smoothing = (int)(norm * 100.0f);
+        processor.sendLaneEdit(LaneEditCommand::Type::SetSmoothing, laneIndex, (int)(norm * 100.0f));
         repaint();
     }
     
-    juce::String getDirectionString(SequencerLane::Direction dir)
+    juce::String getDirectionString(LaneDirection dir)
     {
         switch (dir)
         {
-            case SequencerLane::Direction::Forward: return "FWD";
-            case SequencerLane::Direction::Backward: return "BWD";
-            case SequencerLane::Direction::PingPong: return "PING";
-            case SequencerLane::Direction::Bounce: return "BNCE";
-            case SequencerLane::Direction::Random: return "RAND";
-            case SequencerLane::Direction::RandomDirection: return "RDIR";
+            case LaneDirection::Forward: return "FWD";
+            case LaneDirection::Backward: return "BWD";
+            case LaneDirection::PingPong: return "PING";
+            case LaneDirection::Bounce: return "BNCE";
+            case LaneDirection::Random: return "RAND";
+            case LaneDirection::RandomDirection: return "RDIR";
             default: return "FWD";
         }
     }
@@ -1384,8 +1503,10 @@ class MasterTriggerComponent : public juce::Component
 public:
     MasterTriggerComponent(ShequencerAudioProcessor& p) : processor(p) { setOpaque(true); }
     
+    void tick() { flushStroke(false); }
+    
     juce::Colour getEffectiveColor() const {
-        return processor.masterColor.isTransparent() ? Theme::masterColor : processor.masterColor;
+        return track().masterColor.isTransparent() ? Theme::masterColor : track().masterColor;
     }
     
     void paint(juce::Graphics& g) override
@@ -1413,7 +1534,7 @@ public:
         g.setColour(juce::Colours::black);
         g.setFont(juce::FontOptions("Arial", 16.0f, juce::Font::bold));
         
-        if (processor.isMidiGateMode)
+        if (processor.getEditedState().isMidiGateMode)
             g.drawFittedText("MI\nDI", resetBtnRect, juce::Justification::centred, 2);
         else
             g.drawFittedText("GA\nTE", resetBtnRect, juce::Justification::centred, 2);
@@ -1441,7 +1562,7 @@ public:
         g.fillRect(lenRect.reduced(1));
         g.setColour(getEffectiveColor());
         g.setFont(juce::FontOptions("Arial", 12.0f, juce::Font::bold));
-        g.drawText(juce::String(processor.masterLength), lenRect, juce::Justification::centred);
+        g.drawText(juce::String(track().masterLength), lenRect, juce::Justification::centred);
         
         auto drawTriangle = [&](juce::Rectangle<int> r, bool left) {
             juce::Path p;
@@ -1500,16 +1621,22 @@ public:
         g.fillRect(probRect.reduced(1));
         g.setColour(getEffectiveColor());
         
-        if (processor.masterProbability > 0)
+        if (track().masterProbability > 0)
         {
-            float fillW = (float)probRect.getWidth() * ((float)processor.masterProbability / 100.0f);
+            float fillW = (float)probRect.getWidth() * ((float)track().masterProbability / 100.0f);
             g.fillRect((float)probRect.getX(), (float)probRect.getY(), fillW, (float)probRect.getHeight());
         }
         
         // Steps
-        float stepWidth = area.getWidth() / 16.0f;
+        int numSteps = processor.getVisibleStepCount();
+        float stepWidth = area.getWidth() / (float)numSteps;
         
-        for (size_t i = 0; i < 16; ++i)
+        bool showStroke = isStrokeActive || !processor.isLaneEditApplied(lastStrokeTicket);
+        const auto& shownTriggers = showStroke ? strokeTriggers : track().masterTriggers;
+        const auto& shownProb = showStroke ? strokeProb : track().masterProbEnabled;
+        int currentMasterStep = processor.getEditedTrackState().currentMasterStep;
+        
+        for (size_t i = 0; i < (size_t)numSteps; ++i)
         {
             auto stepArea = area.removeFromLeft((int)stepWidth);
             
@@ -1519,12 +1646,12 @@ public:
             auto squareArea = stepArea.withY(stepArea.getY() + yOffset).withHeight(size).reduced(2);
             
             // Dim if outside loop
-            float alpha = (i < (size_t)processor.masterLength) ? 1.0f : 0.3f;
+            float alpha = (i < (size_t)track().masterLength) ? 1.0f : 0.3f;
             
             g.setColour(getEffectiveColor().withAlpha(alpha));
             g.fillRect(squareArea);
             
-            if (!processor.masterTriggers[i])
+            if (!shownTriggers[i])
             {
                 g.setColour(juce::Colours::black);
                 g.fillRect(squareArea.reduced(1));
@@ -1532,7 +1659,7 @@ public:
             else
             {
                 // Draw PROB indicator (Black Square - Hole)
-                if (processor.masterProbEnabled[i])
+                if (shownProb[i])
                 {
                     g.setColour(juce::Colours::black);
                     g.fillRect(squareArea.withSizeKeepingCentre(10, 10));
@@ -1540,7 +1667,7 @@ public:
             }
             
             // Highlight current master step
-            if (i == (size_t)processor.currentMasterStep)
+            if (i == (size_t)currentMasterStep)
             {
                 g.setColour(getEffectiveColor().darker(1.0f).withAlpha(0.5f));
                 g.fillRect(squareArea);
@@ -1562,12 +1689,16 @@ public:
                 // Full height hit area
                 if (e.mods.isShiftDown())
                 {
-                    processor.masterColor = juce::Colours::transparentBlack;
+                    processor.sendLaneEdit(LaneEditCommand::Type::SetMasterColor, 0, (int)juce::Colours::transparentBlack.getARGB());
                     repaint();
                 }
                 else
                 {
-                    auto* client = new ColorPickerClient(processor.masterColor, getEffectiveColor(), [this](){ repaint(); });
+                    auto* client = new ColorPickerClient(track().masterColor, getEffectiveColor(), [this](juce::Colour colour)
+                    {
+                        processor.sendLaneEdit(LaneEditCommand::Type::SetMasterColor, 0, (int)colour.getARGB());
+                        repaint();
+                    });
                     juce::CallOutBox::launchAsynchronously(std::unique_ptr<juce::Component>(client), getScreenBounds().removeFromLeft(20), nullptr);
                 }
                 return;
@@ -1579,16 +1710,15 @@ public:
             }
             else if (e.mods.isCommandDown())
             {
-                processor.isMidiGateMode = !processor.isMidiGateMode;
+                processor.sendLaneEdit(LaneEditCommand::Type::SetMidiGateMode, 0, processor.getEditedState().isMidiGateMode ? 0 : 1);
             }
             else
             {
                 // If clicking the button area (25-65)
                 if (e.x >= 25 && e.x <= 65) {
-                    processor.isMidiGateMode = !processor.isMidiGateMode;
+                    processor.sendLaneEdit(LaneEditCommand::Type::SetMidiGateMode, 0, processor.getEditedState().isMidiGateMode ? 0 : 1);
                 } else {
-                    processor.masterTriggers.fill(false);
-                    processor.masterLength = 16;
+                    processor.sendLaneEdit(LaneEditCommand::Type::ClearMasterTriggers, 0);
                 }
             }
             repaint();
@@ -1605,6 +1735,7 @@ public:
         if (e.x >= col1_X + 20 && e.x < col1_X + 60 && e.y >= topRowY && e.y < topRowY + topRowH)
         {
             isDraggingLength = true;
+            dragLength = track().masterLength;
             lastMouseX = e.x;
             lastMouseY = e.y;
             return;
@@ -1631,6 +1762,12 @@ public:
         int sliderH = 14; // Hit area slightly larger than visual 12
         if (e.x >= col1_X && e.x < col1_X + 80 && e.y >= sliderY && e.y < sliderY + sliderH)
         {
+            if (e.mods.isCommandDown())
+            {
+                showRandomMenu();
+                return;
+            }
+            
             isDraggingProbability = true;
             updateProbability(e.x, col1_X, 80);
             return;
@@ -1638,21 +1775,25 @@ public:
             
         area.removeFromRight(130); // Match LaneComponent layout
         
-        float stepWidth = area.getWidth() / 16.0f;
+        int numSteps = processor.getVisibleStepCount();
+        float stepWidth = area.getWidth() / (float)numSteps;
         int stepIdx = (int)((e.x - 70) / stepWidth);
         
-        if (stepIdx >= 0 && stepIdx < 16 && e.x <= getWidth() - 130)
+        if (stepIdx >= 0 && stepIdx < numSteps && e.x <= getWidth() - 130)
         {
+            beginStroke();
+            strokeDirty = true;
+            
             if (e.mods.isShiftDown())
             {
                 // Toggle Probability Step
-                targetProbState = !processor.masterProbEnabled[(size_t)stepIdx];
-                processor.masterProbEnabled[(size_t)stepIdx] = targetProbState;
+                targetProbState = !strokeProb[(size_t)stepIdx];
+                strokeProb[(size_t)stepIdx] = targetProbState;
                 
                 // If enabling probability on an empty step, turn the step ON
-                if (targetProbState && !processor.masterTriggers[(size_t)stepIdx])
+                if (targetProbState && !strokeTriggers[(size_t)stepIdx])
                 {
-                    processor.masterTriggers[(size_t)stepIdx] = true;
+                    strokeTriggers[(size_t)stepIdx] = true;
                 }
                 
                 lastEditedStep = stepIdx;
@@ -1661,12 +1802,12 @@ public:
             }
 
             lastEditedStep = stepIdx;
-            targetTriggerState = !processor.masterTriggers[(size_t)stepIdx];
-            processor.masterTriggers[(size_t)stepIdx] = targetTriggerState;
+            targetTriggerState = !strokeTriggers[(size_t)stepIdx];
+            strokeTriggers[(size_t)stepIdx] = targetTriggerState;
             
             // If turning OFF gate, also disable probability to avoid "small yellow square" state
             if (!targetTriggerState)
-                processor.masterProbEnabled[(size_t)stepIdx] = false;
+                strokeProb[(size_t)stepIdx] = false;
                 
             repaint();
         }
@@ -1679,8 +1820,9 @@ public:
             int delta = (e.x - lastMouseX) - (e.y - lastMouseY);
             if (std::abs(delta) > 5)
             {
-                if (delta > 0) processor.masterLength = juce::jmin(16, processor.masterLength + 1);
-                else processor.masterLength = juce::jmax(1, processor.masterLength - 1);
+                if (delta > 0) dragLength = juce::jmin(stepCapacity, dragLength + 1);
+                else dragLength = juce::jmax(1, dragLength - 1);
+                processor.sendLaneEdit(LaneEditCommand::Type::SetMasterLength, 0, dragLength);
                 
                 lastMouseX = e.x;
                 lastMouseY = e.y;
@@ -1704,26 +1846,28 @@ public:
             auto area = getLocalBounds();
             area.removeFromLeft(70);
             area.removeFromRight(130);
-            float stepWidth = area.getWidth() / 16.0f;
+            int numSteps = processor.getVisibleStepCount();
+            float stepWidth = area.getWidth() / (float)numSteps;
             int stepIdx = (int)((e.x - 70) / stepWidth);
             
-            if (stepIdx >= 0 && stepIdx < 16 && stepIdx != lastEditedStep)
+            if (isStrokeActive && stepIdx >= 0 && stepIdx < numSteps && stepIdx != lastEditedStep)
             {
                 lastEditedStep = stepIdx;
+                strokeDirty = true;
                 
                 if (e.mods.isShiftDown())
                 {
                     // Dragging Probability
-                    processor.masterProbEnabled[(size_t)stepIdx] = targetProbState;
-                    if (targetProbState && !processor.masterTriggers[(size_t)stepIdx])
-                        processor.masterTriggers[(size_t)stepIdx] = true;
+                    strokeProb[(size_t)stepIdx] = targetProbState;
+                    if (targetProbState && !strokeTriggers[(size_t)stepIdx])
+                        strokeTriggers[(size_t)stepIdx] = true;
                 }
                 else
                 {
                     // Dragging Gate
-                    processor.masterTriggers[(size_t)stepIdx] = targetTriggerState;
+                    strokeTriggers[(size_t)stepIdx] = targetTriggerState;
                     if (!targetTriggerState)
-                        processor.masterProbEnabled[(size_t)stepIdx] = false;
+                        strokeProb[(size_t)stepIdx] = false;
                 }
                 repaint();
             }
@@ -1734,26 +1878,84 @@ public:
     {
         isDraggingLength = false;
         isDraggingProbability = false;
+        
+        if (isStrokeActive)
+        {
+            isStrokeActive = false;
+            flushStroke(true);
+        }
     }
 
 private:
     ShequencerAudioProcessor& processor;
+    const SequencerTrack& track() const { return processor.getEditedTrack(); }
+    
     int lastEditedStep = -1;
     bool targetTriggerState = false;
     bool targetProbState = false;
     
     bool isDraggingLength = false;
     bool isDraggingProbability = false;
+    int dragLength = 16;
     int lastMouseX = 0;
     int lastMouseY = 0;
     
+    // Step edits of one mouse stroke, sent at most once per audio block (see LaneComponent)
+    LaneBank::StepMask strokeTriggers {};
+    LaneBank::StepMask strokeProb {};
+    bool isStrokeActive = false;
+    bool strokeDirty = false;
+    juce::uint32 lastStrokeTicket = 0;
+    
+    void beginStroke()
+    {
+        if (processor.isLaneEditApplied(lastStrokeTicket))
+        {
+            strokeTriggers = track().masterTriggers;
+            strokeProb = track().masterProbEnabled;
+        }
+        isStrokeActive = true;
+    }
+    
+    void flushStroke(bool force)
+    {
+        if (!strokeDirty) return;
+        if (!force && !processor.isLaneEditApplied(lastStrokeTicket)) return;
+        
+        LaneEditCommand command;
+        command.type = LaneEditCommand::Type::SetMasterSteps;
+        command.track = processor.editedTrack;
+        for (size_t i = 0; i < strokeTriggers.size(); ++i)
+            command.steps[i] = (strokeTriggers[i] ? 1 : 0) | (strokeProb[i] ? 2 : 0);
+        
+        if (auto ticket = processor.sendLaneEdit(command)) lastStrokeTicket = ticket;
+        strokeDirty = false;
+    }
+    
     void updateProbability(int mouseX, int x, int w)
     {
         float norm = (float)(mouseX - x) / (float)w;
         norm = juce::jlimit(0.0f, 1.0f, norm);
-        processor.masterProbability = (int)(norm * 100.0f);
+        processor.sendLaneEdit(LaneEditCommand::Type::SetMasterProbability, 0, (int)(norm * 100.0f));
         repaint();
     }
+
+    void showRandomMenu()
+    {
+        juce::PopupMenu m;
+        m.addItem(1, "FREE RUNNING", true, track().randomReseed == RandomReseed::Never);
+        m.addItem(2, "RESEED EVERY BAR", true, track().randomReseed == RandomReseed::EveryBar);
+        m.addItem(3, "RESEED EVERY LOOP", true, track().randomReseed == RandomReseed::EveryLoop);
+        m.addSeparator();
+        m.addItem(4, "NEW SEEDS");
+
+        m.showMenuAsync(juce::PopupMenu::Options(), [this](int result) {
+            if (result >= 1 && result <= 3)
+                processor.sendLaneEdit(LaneEditCommand::Type::SetRandomReseed, 0, result - 1);
+            else if (result == 4)
+                processor.newRandomSeeds();
+        });
+    }
 };
 
 class BankSelectorComponent : public juce::Component
@@ -1826,6 +2028,7 @@ public:
     {
         auto area = getLocalBounds();
         float stepWidth = area.getWidth() / 16.0f;
+        const auto& playback = processor.getEditedTrackState();
         
         for (size_t i = 0; i < 16; ++i)
         {
@@ -1847,7 +2050,7 @@ public:
             }
             
             // Draw Loaded Indicator
-            if (processor.currentBank == processor.loadedBank && i == (size_t)processor.loadedSlot)
+            if (processor.currentBank == playback.loadedBank && i == (size_t)playback.loadedSlot)
             {
                 int globalSlotNum = (processor.currentBank * 16) + (int)i + 1;
                 
@@ -1870,13 +2073,30 @@ public:
                 // Save
                 processor.savePattern(processor.currentBank, slotIdx);
             }
+            else if (e.mods.isCommandDown())
+            {
+                // Load a chord set into this pattern
+                int bank = processor.currentBank;
+                fileChooser = std::make_unique<juce::FileChooser>("Load Chord Set",
+                                                                  juce::File::getSpecialLocation(juce::File::userDocumentsDirectory),
+                                                                  "*.json");
+                auto folderChooserFlags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
+                
+                fileChooser->launchAsync(folderChooserFlags, [this, bank, slotIdx](const juce::FileChooser& fc)
+                {
+                    auto file = fc.getResult();
+                    if (file.existsAsFile())
+                        processor.loadChordSet(bank, slotIdx, file);
+                });
+            }
             else if (e.mods.isAltDown())
             {
                 // Clear
                 processor.clearPattern(processor.currentBank, slotIdx);
                 
                 // If we are clearing the currently loaded pattern, reset the live state too
-                if (processor.currentBank == processor.loadedBank && slotIdx == processor.loadedSlot)
+                const auto& playback = processor.getEditedTrackState();
+                if (processor.currentBank == playback.loadedBank && slotIdx == playback.loadedSlot)
                 {
                     processor.resetAllLanes();
                 }
@@ -1892,31 +2112,119 @@ public:
 
 private:
     ShequencerAudioProcessor& processor;
+    std::unique_ptr<juce::FileChooser> fileChooser;
 };
 
+// Page I holds the note lanes, every page after it four CC lanes.
+// Right click picks how many CC lanes are switched on.
 class PageSelectorComponent : public juce::Component
 {
 public:
+    PageSelectorComponent(ShequencerAudioProcessor& p) : processor(p) {}
+    
     std::function<void()> onPageChanged;
     int currentPage = 0;
+    int numPages = 2;
     
     void paint(juce::Graphics& g) override
     {
+        static const char* const pageNames[] { "I", "II", "III", "IV", "V", "VI", "VII", "VIII", "IX" };
+        
         auto area = getLocalBounds().reduced(2);
         g.setColour(Theme::slotsColor);
         g.fillRect(area);
         
         g.setColour(juce::Colours::black);
-        g.setFont(juce::FontOptions("Arial", 20.0f, juce::Font::bold));
-        g.drawText(currentPage == 0 ? "I" : "II", area, juce::Justification::centred);
+        g.setFont(juce::FontOptions("Arial", currentPage < 3 ? 20.0f : 14.0f, juce::Font::bold));
+        g.drawText(pageNames[juce::jlimit(0, 8, currentPage)], area, juce::Justification::centred);
     }
     
-    void mouseDown(const juce::MouseEvent&) override
+    void mouseDown(const juce::MouseEvent& e) override
     {
-        currentPage = !currentPage;
+        if (e.mods.isPopupMenu())
+        {
+            showLaneCountMenu();
+            return;
+        }
+        
+        currentPage = (currentPage + 1) % juce::jmax(1, numPages);
         if (onPageChanged) onPageChanged();
         repaint();
     }
+    
+private:
+    ShequencerAudioProcessor& processor;
+    
+    void showLaneCountMenu()
+    {
+        const int numCCLanes = processor.getEditedTrackState().numCCLanes;
+        
+        juce::PopupMenu m;
+        m.addSectionHeader("CC LANES");
+        for (int n = 0; n <= ShequencerAudioProcessor::maxCCLanes; ++n)
+            m.addItem(n + 1, n == 0 ? juce::String("OFF") : juce::String(n), true, n == numCCLanes);
+        
+        m.showMenuAsync(juce::PopupMenu::Options(), [&p = processor](int result) {
+            if (result > 0) p.setNumCCLanes(result - 1);
+        });
+    }
+};
+
+// Shows the edited track; a click steps to the next playing track.
+// Right click picks how many tracks play.
+class TrackSelectorComponent : public juce::Component
+{
+public:
+    TrackSelectorComponent(ShequencerAudioProcessor& p) : processor(p) {}
+    
+    std::function<void(int)> onTrackSelected;
+    
+    void paint(juce::Graphics& g) override
+    {
+        auto area = getLocalBounds().reduced(2);
+        const bool isMultiTrack = processor.getPlaybackState().numTracks > 1;
+        
+        g.setColour(Theme::slotsColor.withAlpha(isMultiTrack ? 1.0f : 0.2f));
+        g.fillRect(area);
+        if (!isMultiTrack)
+        {
+            g.setColour(juce::Colours::black);
+            g.fillRect(area.reduced(1));
+        }
+        
+        g.setColour(isMultiTrack ? juce::Colours::black : Theme::slotsColor);
+        g.setFont(juce::FontOptions("Arial", 12.0f, juce::Font::bold));
+        g.drawText(juce::String(processor.editedTrack + 1), area, juce::Justification::centred);
+    }
+    
+    void mouseDown(const juce::MouseEvent& e) override
+    {
+        if (e.mods.isPopupMenu())
+        {
+            showTrackCountMenu();
+            return;
+        }
+        
+        const int numTracks = processor.getPlaybackState().numTracks;
+        if (onTrackSelected) onTrackSelected((processor.editedTrack + 1) % juce::jmax(1, numTracks));
+    }
+    
+private:
+    ShequencerAudioProcessor& processor;
+    
+    void showTrackCountMenu()
+    {
+        const int numTracks = processor.getPlaybackState().numTracks;
+        
+        juce::PopupMenu m;
+        m.addSectionHeader("TRACKS");
+        for (int n = 1; n <= ShequencerAudioProcessor::maxTracks; ++n)
+            m.addItem(n, juce::String(n), true, n == numTracks);
+        
+        m.showMenuAsync(juce::PopupMenu::Options(), [&p = processor](int result) {
+            if (result > 0) p.setNumTracks(result);
+        });
+    }
 };
 
 class ShequencerAudioProcessorEditor  : public juce::AudioProcessorEditor
@@ -1931,6 +2239,10 @@ public:
     
     void updatePageVisibility();
     int currentPage = 0;
+    int getNumPages() const;
+    
+    void selectTrack(int track);
+    void updateCCLaneNames(); // Names and ranges from the edited track's CC assignments
 
 private:
     juce::VBlankAttachment vBlankAttachment;
@@ -1942,10 +2254,10 @@ private:
     std::unique_ptr<LaneComponent> velocityLaneComp;
     std::unique_ptr<LaneComponent> lengthLaneComp;
     
-    std::unique_ptr<LaneComponent> ccLane1Comp;
-    std::unique_ptr<LaneComponent> ccLane2Comp;
-    std::unique_ptr<LaneComponent> ccLane3Comp;
-    std::unique_ptr<LaneComponent> ccLane4Comp;
+    // CC lane n sits on page 1 + n / ccLanesPerPage
+    static constexpr int ccLanesPerPage = 4;
+    std::array<std::unique_ptr<LaneComponent>, (size_t)ShequencerAudioProcessor::maxCCLanes> ccLaneComps;
+    int shownCCLanes = -1; // CC lane count the pages were laid out for
     
     BankSelectorComponent bankSelectorComp;
     PatternSlotsComponent patternSlotsComp;
@@ -1953,6 +2265,7 @@ private:
     FileOpsComponent fileOpsComp;
     BuildNumberComponent buildNumberComp;
     PageSelectorComponent pageSelectorComp;
+    TrackSelectorComponent trackSelectorComp;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ShequencerAudioProcessorEditor)
 };
@@ -6,48 +6,42 @@ ShequencerAudioProcessor::ShequencerAudioProcessor()
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true))
 {
     // Initialize default values
-    masterTriggers.fill(false);
-    masterProbEnabled.fill(false);
-    masterProbability = 50;
-    
-    noteLane.values.fill(0); // C
-    noteLane.triggers.fill(true);
-    noteLane.enableMasterSource = false;
-    
-    octaveLane.values.fill(3); // Octave 3
-    octaveLane.triggers.fill(true);
-    octaveLane.enableMasterSource = false;
-    
-    velocityLane.values.fill(100);
-    velocityLane.triggers.fill(true);
-    velocityLane.enableMasterSource = false;
-    
-    lengthLane.values.fill(5); // 32n
-    lengthLane.triggers.fill(true);
-    lengthLane.enableMasterSource = false;
+    // Note C, Octave 3, Velocity 100, Length 32n, CC lanes OFF by default
+    static constexpr std::array<int, numLanes> initialValues { 0, 3, 100, 5 };
+    for (size_t t = 0; t < (size_t)maxTracks; ++t)
+    {
+        auto& track = tracks[t];
+        track.masterProbability = 50;
+        
+        // Each track plays on its own channel until told otherwise
+        track.lanes.midiChannel.fill((int)t + 1);
+        
+        for (size_t i = 0; i < (size_t)numLanes; ++i)
+        {
+            track.lanes.values[i].fill(initialValues[i]);
+            track.lanes.triggers[i].set();
+        }
+        
+        reseedRandomStreams(track);
+    }
+    edited.tracks = tracks;
     
-    // Initialize CC Lanes
-    ccLane1.values.fill(0);
-    ccLane1.triggers.fill(true);
-    ccLane1.midiCC = 0; // OFF by default
-
-    ccLane2.values.fill(0);
-    ccLane2.triggers.fill(true);
-    ccLane2.midiCC = 0;
-
-    ccLane3.values.fill(0);
-    ccLane3.triggers.fill(true);
-    ccLane3.midiCC = 0;
-
-    ccLane4.values.fill(0);
-    ccLane4.triggers.fill(true);
-    ccLane4.midiCC = 0;
+    for (auto& load : pendingPatternLoads)
+        load = -1;
+    for (auto& dirty : dirtyLanes)
+        dirty = ~(LaneBank::LaneMask)0;
 
     activeShuffleAmount = shuffleAmount;
+    clearActiveNotes();
+    
+    livePatterns = std::make_unique<PatternBankSnapshot>();
+    livePatterns->banks = patternBanks;
 }
 
 ShequencerAudioProcessor::~ShequencerAudioProcessor()
 {
+    delete pendingPatterns.exchange(nullptr);
+    freeRetiredPatterns();
 }
 
 const juce::String ShequencerAudioProcessor::getName() const
@@ -99,31 +93,46 @@ void ShequencerAudioProcessor::changeProgramName (int, const juce::String&)
 {
 }
 
-void ShequencerAudioProcessor::prepareToPlay (double, int)
+void ShequencerAudioProcessor::prepareToPlay (double, int samplesPerBlock)
 {
     // Use this method as the place to do any pre-playback
     // initialization that you need..
-    currentPositionInQuarterNotes = 0.0;
-    lastPositionInQuarterNotes = 0.0;
-    for (auto& note : activeNotes) note.isActive = false;
     
-    noteLane.reset();
-    octaveLane.reset();
-    velocityLane.reset();
-    lengthLane.reset();
+    // Size the MIDI scratch buffer for the worst case we expect per block
+    // (a few events per sample plus headroom), so filtering never reallocates.
+    preparedBlockSize = juce::jmax(1, samplesPerBlock);
+    scratchMidi.ensureSize((size_t)juce::jmax(4096, preparedBlockSize * 16));
+    scratchMidi.clear();
+    numMidiEvents = 0;
+    nextMidiEvent = 0;
+    heldMidiNotes.reset();
+    
+    // Edits queued while we were not processing have to be applied before the audio thread takes over
+    {
+        const juce::ScopedLock sl(patternLock);
+        applyAllLaneEdits();
+        isAudioThreadActive = true;
+    }
+    
+    lastPositionTick = 0;
+    nextStepIndex = -1;
+    clearActiveNotes();
     
-    ccLane1.reset();
-    ccLane2.reset();
-    ccLane3.reset();
-    ccLane4.reset();
+    for (auto& track : tracks)
+    {
+        track.lanes.resetAll();
+        reseedRandomStreams(track);
+    }
     
     activeShuffleAmount = shuffleAmount;
+    publishPlaybackState();
 }
 
 void ShequencerAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    isAudioThreadActive = false;
 }
 
 bool ShequencerAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
@@ -147,33 +156,53 @@ void ShequencerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    // Handle MIDI Pattern Switching
-    juce::MidiBuffer processedMidi;
+    // Apply UI edits queued since the last block, so a block never sees a half-applied edit
+    applyLaneEdits();
+    
+    // Hand the editor one copy of the playback state per block, whichever way we leave
+    struct PlaybackStatePublisher
+    {
+        ShequencerAudioProcessor& owner;
+        ~PlaybackStatePublisher() { owner.publishPlaybackState(); }
+    } playbackStatePublisher { *this };
+
+    // MIDI Input
+    // Pattern switching (channel 2, then one channel up per further track), transposition (channel 1)
+    // and, in MIDI Gate Mode, the gate
+    // notes are queued with their sample offsets and applied in time order between the steps,
+    // so every step sees exactly the input that arrived before it, whatever the block size.
+    numMidiEvents = 0;
+    nextMidiEvent = 0;
+    scratchMidi.clear();
+    
     for (const auto metadata : midiMessages)
     {
         auto msg = metadata.getMessage();
         bool isControlMessage = false;
         
+        auto queueEvent = [&](MidiEvent::Type type, int track = 0) {
+            if (numMidiEvents < maxMidiEventsPerBlock) // Fixed capacity, drop the excess
+                midiEvents[(size_t)numMidiEvents++] = { metadata.samplePosition, type, msg.getNoteNumber(), track };
+        };
+        
         if (msg.isNoteOn())
         {
             int channel = msg.getChannel();
             int note = msg.getNoteNumber();
             
-            if (channel == 2)
+            if (channel >= 2 && channel < 2 + numTracks)
             {
-                // Map MIDI notes 0-63 to Patterns (Bank 0-3, Slot 0-15)
+                // Map MIDI notes 0-63 to Patterns (Bank 0-3, Slot 0-15) of track (channel - 2)
                 if (note >= 0 && note < 64)
                 {
-                    int bank = note / 16;
-                    int slot = note % 16;
-                    loadPattern(bank, slot);
+                    queueEvent(MidiEvent::Type::SelectPattern, channel - 2);
                     isControlMessage = true;
                 }
             }
             else if (channel == 1)
             {
                 // Transposition (Center at 60)
-                transposeOffset = note - 60;
+                queueEvent(MidiEvent::Type::Transpose);
                 
                 // If NOT in MIDI Gate Mode, consume the message.
                 // If IN MIDI Gate Mode, let it pass through to be used as a gate trigger.
@@ -183,805 +212,850 @@ void ShequencerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
             }
         }
         
+        // In MIDI Gate Mode we generate our own notes, so the input notes only drive the gate
+        // and are not passed through
+        if (!isControlMessage && isMidiGateMode && (msg.isNoteOn() || msg.isNoteOff()))
+        {
+            queueEvent(msg.isNoteOn() ? MidiEvent::Type::GateOn : MidiEvent::Type::GateOff);
+            isControlMessage = true;
+        }
+        
         if (!isControlMessage)
-            processedMidi.addEvent(msg, metadata.samplePosition);
+            scratchMidi.addEvent(msg, metadata.samplePosition);
     }
-    midiMessages.swapWith(processedMidi);
+    // Copy back instead of swapping so both buffers keep their own preallocated storage
+    midiMessages.clear();
+    midiMessages.addEvents(scratchMidi, 0, -1, 0);
+    
+    // Apply queued MIDI input up to (and including) the given sample offset.
+    // Events arrive sorted by sample position, so a read cursor replaces erasing.
+    // Gate notes only count while playing.
+    auto processMidiEventsUpTo = [&](int sampleLimit) {
+        while (nextMidiEvent < numMidiEvents && midiEvents[(size_t)nextMidiEvent].sampleOffset <= sampleLimit)
+        {
+            const auto& ev = midiEvents[(size_t)nextMidiEvent++];
+            if (ev.type == MidiEvent::Type::SelectPattern) {
+                loadPattern(ev.noteNumber / 16, ev.noteNumber % 16, ev.track);
+                applyPendingPatternLoad();
+            }
+            else if (ev.type == MidiEvent::Type::Transpose) {
+                transposeOffset = ev.noteNumber - 60;
+            }
+            else if (!isPlaying) {
+                continue;
+            }
+            else if (ev.type == MidiEvent::Type::GateOn) {
+                heldMidiNotes.set((size_t)ev.noteNumber);
+                pendingMidiTrigger = true; // Persists to next block if no step follows
+            }
+            else {
+                heldMidiNotes.reset((size_t)ev.noteNumber);
+                
+                // Kill specific sustained notes linked to this MIDI note
+                for (int i = oldestNote; i >= 0; ) {
+                    auto& note = activeNotes[(size_t)i];
+                    int next = note.nextByAge;
+                    if (note.isMidiSustain && note.sourceMidiNote == ev.noteNumber) {
+                        midiMessages.addEvent(juce::MidiMessage::noteOff(note.midiChannel, note.noteNumber), ev.sampleOffset);
+                        stopActiveNote(i);
+                    }
+                    i = next;
+                }
+            }
+        }
+    };
 
-    // Apply any pending pattern load (from UI or MIDI)
+    // Apply any pending pattern load (from the UI)
     applyPendingPatternLoad();
 
     auto* playHead = getPlayHead();
-    if (playHead == nullptr) return;
-
-    auto positionInfo = playHead->getPosition();
-    if (!positionInfo.hasValue()) return;
+    auto positionInfo = playHead != nullptr ? playHead->getPosition() : juce::Optional<juce::AudioPlayHead::PositionInfo>();
+    
+    // Pattern switches and transposition still apply without a running transport
+    if (!positionInfo.hasValue())
+    {
+        processMidiEventsUpTo(std::numeric_limits<int>::max());
+        return;
+    }
     
     auto pos = *positionInfo;
     
     if (!pos.getIsPlaying())
     {
         isPlaying = false;
+        processMidiEventsUpTo(std::numeric_limits<int>::max());
         
         // Update timing info even when stopped so UI sync works
         if (auto ppq = pos.getPpqPosition())
-             lastPositionInQuarterNotes = *ppq;
+             lastPositionTick = ppqToTicks(*ppq);
         if (auto barStart = pos.getPpqPositionOfLastBarStart())
-             lastBarStartPPQ = *barStart;
+             lastBarStartTick = ppqToTicks(*barStart);
         if (auto ts = pos.getTimeSignature())
         {
             sigNumerator = ts->numerator;
             sigDenominator = ts->denominator;
         }
              
-        for (auto& note : activeNotes) note.isActive = false;
+        stopAllActiveNotes(midiMessages, 0);
+        nextStepIndex = -1;
         return;
     }
 
-    // Handle MIDI Input for Gate Mode
-    // We need to process MIDI events in time order relative to the grid steps
-    // So we collect them here, but process them inside the grid loop
-    struct MidiEvent {
-        int sampleOffset;
-        bool isNoteOn;
-        int noteNumber;
-    };
-    std::vector<MidiEvent> midiEvents;
-
-    if (isMidiGateMode)
+    if (auto ts = pos.getTimeSignature())
     {
-        for (const auto metadata : midiMessages)
-        {
-            auto msg = metadata.getMessage();
-            if (msg.isNoteOn())
-            {
-                midiEvents.push_back({metadata.samplePosition, true, msg.getNoteNumber()});
-            }
-            else if (msg.isNoteOff())
-            {
-                midiEvents.push_back({metadata.samplePosition, false, msg.getNoteNumber()});
-            }
-        }
-        
-        // Filter out Note On/Off from passing through, but keep CCs
-        // IMPORTANT: We must NOT clear the buffer if we want other plugins to receive it?
-        // But this is an instrument/sequencer, so we usually replace the output.
-        // We are generating our own notes, so we should filter out the input notes
-        // to avoid double triggering or passing through the raw gate notes.
-        juce::MidiBuffer processedMidi;
-        for (const auto metadata : midiMessages)
-        {
-            auto msg = metadata.getMessage();
-            if (!msg.isNoteOn() && !msg.isNoteOff())
-                processedMidi.addEvent(msg, metadata.samplePosition);
-        }
-        midiMessages.swapWith(processedMidi);
+        sigNumerator = ts->numerator;
+        sigDenominator = ts->denominator;
     }
+    
+    // This block's musical position, in ticks
+    double currentPPQ = *pos.getPpqPosition();
+    double bpm = *pos.getBpm();
+    if (bpm <= 0) bpm = 120.0;
+    
+    double samplesPerQuarterNote = (getSampleRate() * 60.0) / bpm;
+    int numSamples = buffer.getNumSamples();
+    
+    // A tick lands on the sample it falls in on the host timeline. The block plays exactly the
+    // ticks that land on its own samples, so consecutive blocks tile the tick line and every
+    // event keeps its timeline sample whatever the buffer size.
+    const double samplesPerTick = samplesPerQuarterNote / ticksPerQuarterNote;
+    const long long blockStartTimelineSample = (long long)std::llround(currentPPQ * samplesPerQuarterNote);
+    
+    auto getTimelineSample = [&](long long tick) { return (long long)std::floor((double)tick * samplesPerTick); };
+    auto getFirstTickAtSample = [&](long long sample) {
+        auto tick = (long long)std::ceil((double)sample / samplesPerTick);
+        while (getTimelineSample(tick - 1) >= sample) --tick;
+        while (getTimelineSample(tick) < sample) ++tick;
+        return tick;
+    };
+    
+    const long long blockStartTick = getFirstTickAtSample(blockStartTimelineSample);
+    const long long blockEndTick = getFirstTickAtSample(blockStartTimelineSample + numSamples);
+    const long long barTicks = getBarLengthTicks();
+    
+    // Sample offset of a tick in this block. Only ticks carried over a tempo change can fall
+    // outside it; those are played at the nearest edge.
+    auto tickToSampleOffset = [&](long long tick) {
+        const auto sample = getTimelineSample(tick) - blockStartTimelineSample;
+        return (int)juce::jlimit(0LL, (long long)numSamples - 1, sample);
+    };
 
     if (!isPlaying)
     {
         isPlaying = true;
-        if (auto ppq = pos.getPpqPosition())
-            lastPositionInQuarterNotes = *ppq;
-            
-        // Check if we are starting mid-bar
+        lastPositionTick = blockStartTick;
+        
         if (auto barStart = pos.getPpqPositionOfLastBarStart())
-        {
-            double currentPPQ = *pos.getPpqPosition();
-            if (currentPPQ > *barStart + 0.05) // Tolerance
-            {
-                waitingForBarSync = true;
-            }
-            else
-            {
-                waitingForBarSync = false;
-            }
-            lastBarStartPPQ = *barStart;
-        }
+            lastBarStartTick = ppqToTicks(*barStart);
             
         // Reset offsets on start to ensure alignment with grid
-        globalStepOffset = 0;
-        noteLane.triggerStepOffset = 0;
-        octaveLane.triggerStepOffset = 0;
-        velocityLane.triggerStepOffset = 0;
-        lengthLane.triggerStepOffset = 0;
-
-        // Reset value sequences to step 1
-        noteLane.reset();
-        octaveLane.reset();
-        velocityLane.reset();
-        lengthLane.reset();
+        nextStepIndex = -1;
         
-        ccLane1.reset();
-        ccLane2.reset();
-        ccLane3.reset();
-        ccLane4.reset();
-    }
-    
-    // Update Timing Info
-    if (auto barStart = pos.getPpqPositionOfLastBarStart())
-    {
-        if (std::abs(*barStart - lastBarStartPPQ) > 0.0001)
+        // Drop pending lane requests; the lanes are placed at the start step below, even mid-bar
+        for (int t = 0; t < numTracks; ++t)
         {
-            // New Bar Detected
-            if (waitingForBarSync)
-            {
-                waitingForBarSync = false;
-                syncAllToBar();
-                resetAllLanes();
-            }
-            
-            auto checkReset = [](SequencerLane& lane) {
-                if (lane.resetValuesAtNextBar) {
-                    lane.currentValueStep = lane.valueLoopLength - 1;
-                    lane.activeValueStep = 0;
-                    lane.resetValuesAtNextBar = false;
-                }
-            };
-            checkReset(noteLane);
-            checkReset(octaveLane);
-            checkReset(velocityLane);
-            checkReset(lengthLane);
-            
-            checkReset(ccLane1);
-            checkReset(ccLane2);
-            checkReset(ccLane3);
-            checkReset(ccLane4);
+            tracks[(size_t)t].globalStepOffset = 0;
+            tracks[(size_t)t].lanes.resetAll();
         }
-        lastBarStartPPQ = *barStart;
     }
     
-    if (waitingForBarSync) return; // Wait for next bar
-    
-    // Handle Automatic Resets (Intervals)
-    // We need to track bar changes relative to the start of playback or some reference
-    // But simpler: count bars since last reset?
-    // Or just use absolute bar count?
-    // pos.getPpqPosition() gives total quarters.
-    // Bars = PPQ / 4 (assuming 4/4).
-    // Let's use the bar index.
-    
-    long long currentBarIndex = 0;
-    if (auto ppq = pos.getPpqPosition())
-    {
-        currentBarIndex = (long long)(*ppq / 4.0); // Approximation for 4/4
-        // Better: use barStartPPQ if available to detect change
-    }
-    
-    static long long lastProcessedBarIndex = -1;
-    if (currentBarIndex != lastProcessedBarIndex)
-    {
-        auto processIntervalReset = [&](SequencerLane& lane) {
-            // Value Reset
-            if (lane.valueResetInterval > 0)
-            {
-                if (currentBarIndex % lane.valueResetInterval == 0)
-                {
-                    lane.currentValueStep = 0;
-                    lane.activeValueStep = 0;
-                }
-            }
-            // Trigger Reset (Step Progression)
-            if (lane.triggerResetInterval > 0)
-            {
-                if (currentBarIndex % lane.triggerResetInterval == 0)
-                {
-                    // Sync to bar start
-                    // We want (currentStep + offset) % loopLen == 0 at this moment?
-                    // Or just reset the offset so it aligns with global?
-                    // "reset/resync step 1 to bar"
-                    // This implies aligning the lane's trigger sequence to the current bar start.
-                    
-                    // Calculate what the offset should be to hit step 0 NOW (at bar start)
-                    // At bar start, global step count (relative to bar) is 0?
-                    // Actually, we just want to reset the internal counter if it was independent,
-                    // but here it's derived from global time + offset.
-                    // So we adjust the offset.
-                    
-                    // We are at the start of a bar (approximately).
-                    // Reset trigger sequence to start
-                    lane.currentTriggerStep = 0;
-                    lane.triggerMovingForward = true;
-                }
-            }
-        };
-        
-        processIntervalReset(ccLane1);
-        processIntervalReset(ccLane2);
-        processIntervalReset(ccLane3);
-        processIntervalReset(ccLane4);
-        
-        processIntervalReset(noteLane);
-        processIntervalReset(octaveLane);
-        processIntervalReset(velocityLane);
-        processIntervalReset(lengthLane);
-        
-        lastProcessedBarIndex = currentBarIndex;
-    }
-        
-    if (auto ts = pos.getTimeSignature())
+    // Update Timing Info
+    if (auto barStart = pos.getPpqPositionOfLastBarStart())
     {
-        sigNumerator = ts->numerator;
-        sigDenominator = ts->denominator;
+        const long long barStartTick = ppqToTicks(*barStart);
+        if (barStartTick != lastBarStartTick) // New Bar Detected
+            for (int t = 0; t < numTracks; ++t)
+                tracks[(size_t)t].lanes.applyBarResets();
+        lastBarStartTick = barStartTick;
     }
-
-    double currentPPQ = *pos.getPpqPosition();
-    double bpm = *pos.getBpm();
-    if (bpm <= 0) bpm = 120.0;
-    
-    double samplesPerQuarterNote = (getSampleRate() * 60.0) / bpm;
-    int numSamples = buffer.getNumSamples();
-    double endPPQ = currentPPQ + (numSamples / samplesPerQuarterNote);
-    
-    // Step Logic
-    double stepDuration = 0.25; // 16th note
-    double maxDelay = 0.125; // 32nd note
-    
-    int currentSamplePos = 0;
     
-    auto sendCC = [&](SequencerLane& lane, int offset, int val) {
-        if (lane.midiCC == 128) // PGM
-            midiMessages.addEvent(juce::MidiMessage::programChange(1, val), offset);
-        else if (lane.midiCC == 129) // A.TOUCH
-            midiMessages.addEvent(juce::MidiMessage::channelPressureChange(1, val), offset);
-        else if (lane.midiCC >= 1 && lane.midiCC <= 127)
-            midiMessages.addEvent(juce::MidiMessage::controllerEvent(1, lane.midiCC, val), offset);
+    // Bar Grid
+    // Use the host's bar count when it has one, otherwise count bars of the current time signature
+    long long currentBarIndex = floorDiv(blockStartTick, barTicks);
+    if (auto barCount = pos.getBarCount())
+        currentBarIndex = (long long)*barCount;
+    
+    BarGrid bars;
+    bars.barStartTick = lastBarStartTick;
+    bars.barIndex = currentBarIndex - floorDiv(blockStartTick - lastBarStartTick, barTicks);
+    bars.barTicks = barTicks;
+    
+    auto sendCC = [&](const LaneBank& lanes, int lane, int offset, int val) {
+        const int midiCC = lanes.midiCC[(size_t)lane];
+        const int channel = lanes.midiChannel[(size_t)lane];
+        if (midiCC == 128) // PGM
+            midiMessages.addEvent(juce::MidiMessage::programChange(channel, val), offset);
+        else if (midiCC == 129) // A.TOUCH
+            midiMessages.addEvent(juce::MidiMessage::channelPressureChange(channel, val), offset);
+        else if (midiCC >= 1 && midiCC <= 127)
+            midiMessages.addEvent(juce::MidiMessage::controllerEvent(channel, midiCC, val), offset);
     };
     
-    auto processCCRamps = [&](int startSample, int count) {
-        for (auto* lane : {&ccLane1, &ccLane2, &ccLane3, &ccLane4}) {
-            if (lane->midiCC == 0) continue;
-            if (!lane->isRamping) continue;
+    // Sequencer sample clock position of this block's first sample
+    const long long blockStartSample = sequencerSampleCount;
+    sequencerSampleCount += numSamples;
+    const int ccRampMinSpacing = juce::jmax(1, juce::roundToInt(getSampleRate() * ccRampMinInterval));
+    
+    // Emit the ramp events that fall before the given block-relative sample. Events are
+    // found in closed form on the absolute sample clock, so the output does not depend on block size.
+    auto processCCRampsUpTo = [&](int endSample) {
+        const long long endAbs = blockStartSample + endSample;
+        for (int t = 0; t < numTracks; ++t) {
+            auto& lanes = tracks[(size_t)t].lanes;
             
-            for (int i = 0; i < count; ++i) {
-                if (lane->rampSamplesRemaining <= 0) {
-                    lane->isRamping = false;
-                    lane->currentSmoothedValue = (float)lane->targetCCValue;
+            for (int lane = firstCCLaneIndex; lane < lanes.numActiveLanes; ++lane) {
+                if (lanes.midiCC[(size_t)lane] == 0) continue;
+                auto& ramp = lanes.ramps[(size_t)lane];
+                
+                while (ramp.isRamping && ramp.nextRampEventSample < endAbs) {
+                    const long long eventSample = ramp.nextRampEventSample;
+                    const int offset = (int)juce::jmax(0LL, eventSample - blockStartSample);
                     
-                    if (lane->lastSentCCValue != lane->targetCCValue) {
-                        sendCC(*lane, startSample + i, lane->targetCCValue);
-                        lane->lastSentCCValue = lane->targetCCValue;
+                    if (eventSample >= ramp.rampStartSample + ramp.rampLengthSamples) {
+                        ramp.isRamping = false;
+                        ramp.currentSmoothedValue = (float)ramp.targetCCValue;
+                        
+                        if (ramp.lastSentCCValue != ramp.targetCCValue) {
+                            sendCC(lanes, lane, offset, ramp.targetCCValue);
+                            ramp.lastSentCCValue = ramp.targetCCValue;
+                        }
+                        break;
                     }
-                    break;
-                }
-                
-                lane->currentSmoothedValue += lane->rampIncrement;
-                lane->rampSamplesRemaining--;
-                
-                // Rate limit: every 128 samples (~2.9ms at 44.1k)
-                if (i % 128 == 0) {
-                    int val = (int)lane->currentSmoothedValue;
-                    if (val != lane->lastSentCCValue) {
-                        sendCC(*lane, startSample + i, val);
-                        lane->lastSentCCValue = val;
+                    
+                    int val = ramp.getRampOutputAt(eventSample);
+                    if (val != ramp.lastSentCCValue) {
+                        sendCC(lanes, lane, offset, val);
+                        ramp.lastSentCCValue = val;
                     }
+                    
+                    // Rate limit: no sooner than the minimum spacing after this event
+                    ramp.nextRampEventSample = ramp.findRampChange(eventSample + ccRampMinSpacing);
                 }
             }
         }
     };
     
-    double searchStart = currentPPQ;
-    double searchEnd = endPPQ;
-    
-    // Find the first step boundary > searchStart
-    // We iterate through potential step indices
-    // We look back enough to catch delayed steps from previous grid points
-    double lookBack = stepDuration + maxDelay + 0.05;
-    long long startStepIdx = (long long)std::floor((searchStart - lookBack) / stepDuration);
-    if (startStepIdx < 0) startStepIdx = 0;
+    // Process Note Offs (Time-based Expiry)
+    // Pop from the heap until the earliest note-off is not before the given tick.
+    // Steps expire the notes ending before them first, so a step never sees a note that is
+    // already over, however the steps and note-offs are split between blocks.
+    // Notes sustained by MIDI are never in the heap.
+    auto processNoteOffsBefore = [&](long long tickLimit) {
+        while (noteOffHeapSize > 0)
+        {
+            int index = noteOffHeap[0];
+            auto& note = activeNotes[(size_t)index];
+            if (note.noteOffTick >= tickLimit) break;
+            
+            midiMessages.addEvent(juce::MidiMessage::noteOff(note.midiChannel, note.noteNumber), tickToSampleOffset(note.noteOffTick));
+            stopActiveNote(index);
+        }
+    };
     
-    for (long long k = startStepIdx; ; ++k)
-    {
-        // Safe Shuffle Update: Only update on even (unshuffled) steps
-        if (k % 2 == 0)
-            activeShuffleAmount = shuffleAmount;
-
-        lastAbsStep = k;
-        double baseTime = k * stepDuration;
-        double time = baseTime;
+    // Step Scheduler
+    // The next step (shuffle included) is carried over from the previous block, so each
+    // block only visits the steps it actually plays. A jump in host position (seek, loop,
+    // transport start) looks the next step up again from the new position.
+    auto getStepTick = [&](long long k) {
+        long long tick = k * ticksPerStep;
         
-        long long stepCount = k + globalStepOffset;
-        int stepIdx = stepCount % masterLength;
-        if (stepIdx < 0) stepIdx += masterLength;
-
-        // Calculate delay based on active shuffle amount
-        double currentShuffleDelay = 0.0;
-        if (activeShuffleAmount > 1)
-            currentShuffleDelay = ((double)(activeShuffleAmount - 1) / 6.0) * maxDelay;
-
         // Apply shuffle to odd steps (1, 3, 5...)
         // Note: k is 0-based index. 0=Straight, 1=Delayed.
-        if (k % 2 != 0)
-            time += currentShuffleDelay;
-            
-        if (time >= searchEnd) break; // Past the buffer
+        if (k % 2 != 0 && activeShuffleAmount > 1)
+            tick += (activeShuffleAmount - 1) * maxShuffleTicks / 6;
+        return tick;
+    };
+    
+    bool hasJumped = nextStepIndex >= 0 && std::abs(blockStartTick - lastPositionTick) > maxPositionDrift;
+    
+    // Note-off times refer to the old position, so end everything that is still sounding
+    if (hasJumped)
+        stopAllActiveNotes(midiMessages, 0);
+    
+    if (nextStepIndex < 0 || hasJumped)
+    {
+        activeShuffleAmount = shuffleAmount;
+        nextStepIndex = juce::jmax(0LL, floorDiv(blockStartTick, ticksPerStep));
+        nextStepTick = getStepTick(nextStepIndex);
+        
+        // An odd step can still be ahead of us because of its shuffle delay
+        while (nextStepTick < blockStartTick)
+            nextStepTick = getStepTick(++nextStepIndex);
         
-        if (time >= searchStart)
+        // Continue from where the lanes would be at that step, however we got here
+        for (int t = 0; t < numTracks; ++t)
         {
-            // Process this step
-            // Calculate sample offset
-            double offsetPPQ = time - currentPPQ;
-            int sampleOffset = (int)(offsetPPQ * samplesPerQuarterNote);
-            sampleOffset = juce::jlimit(0, numSamples - 1, sampleOffset);
-            
-            // Process Ramps up to here
-            int samplesToProcess = sampleOffset - currentSamplePos;
-            if (samplesToProcess > 0) processCCRamps(currentSamplePos, samplesToProcess);
-            currentSamplePos = sampleOffset;
-            
-            // Update MIDI State up to this sample offset
-            if (isMidiGateMode)
-            {
-                // Process events that happened before or at this step
-                auto it = midiEvents.begin();
-                while (it != midiEvents.end())
-                {
-                    if (it->sampleOffset <= sampleOffset)
-                    {
-                        if (it->isNoteOn) {
-                            heldMidiNotes.insert(it->noteNumber);
-                            pendingMidiTrigger = true;
-                        }
-                        else {
-                            heldMidiNotes.erase(it->noteNumber);
-                            
-                            // Kill specific sustained notes linked to this MIDI note
-                            for (auto& note : activeNotes) {
-                                if (note.isActive && note.isMidiSustain && note.sourceMidiNote == it->noteNumber) {
-                                    midiMessages.addEvent(juce::MidiMessage::noteOff(note.midiChannel, note.noteNumber), it->sampleOffset);
-                                    note.isActive = false;
-                                }
-                            }
-                        }
-                        it = midiEvents.erase(it);
-                    }
-                    else
-                    {
-                        ++it;
-                    }
-                }
-            }
-            
-            // Calculate actual step duration for length logic
-            double nextStepBaseTime = (k + 1) * stepDuration;
-            double nextStepTime = nextStepBaseTime;
-            if ((k + 1) % 2 != 0)
-                nextStepTime += currentShuffleDelay;
+            seekLanesTo(tracks[(size_t)t], seekCheckpoints[(size_t)t], nextStepIndex, bars);
+            tracks[(size_t)t].lanesToSeek = 0;
+        }
+    }
+    
+    // Lanes and tracks switched on since the last block join the ones already running
+    for (int t = 0; t < numTracks; ++t)
+    {
+        auto& track = tracks[(size_t)t];
+        if (track.lanesToSeek == 0) continue;
+        
+        seekLanesTo(track, seekCheckpoints[(size_t)t], nextStepIndex, bars, track.lanesToSeek);
+        track.lanesToSeek = 0;
+    }
+    
+    // Step Core
+    // One track's part of step k. The caller does the work the tracks share (MIDI input,
+    // note-offs, scheduling) once per step, then runs every playing track in order.
+    auto playTrackStep = [&](int trackIndex, long long k, long long tick, int sampleOffset, long long actualStepTicks, bool isBarStart) {
+        auto& track = tracks[(size_t)trackIndex];
+        auto& lanes = track.lanes;
+        
+        int stepIdx = track.getMasterStepIndex(k);
+        track.currentMasterStep = stepIdx;
+        
+        // Automatic Resets (Intervals), on the first step of the bar
+        if (isBarStart)
+        {
+            auto& checkpoints = seekCheckpoints[(size_t)trackIndex];
+            if (checkpoints.isExact && !isMidiGateMode)
+                recordSeekCheckpoint(track, checkpoints, k, bars, track.probabilityRandom);
             
-            // int nextStepIdx = (stepCount + 1) % masterLength;
-            // if (nextStepIdx < 0) nextStepIdx += masterLength;
+            lanes.applyIntervalResets(bars.getBarOfStep(k));
+        }
+        
+        // Restart the random streams so every bar / loop replays the same draws
+        if ((track.randomReseed == RandomReseed::EveryLoop && stepIdx == 0)
+            || (track.randomReseed == RandomReseed::EveryBar && isBarStart))
+            reseedRandomStreams(track);
+        
+        // Check Probability (Needed for advancement logic)
+        bool probCheck = true;
+        if (track.masterProbEnabled[(size_t)stepIdx])
+        {
+            int roll = track.probabilityRandom.nextInt(100);
+            if (roll >= track.masterProbability) probCheck = false;
+        }
+        
+        bool isGateOpen = heldMidiNotes.any();
 
-            double actualStepDuration = nextStepTime - time;
-            if (actualStepDuration <= 0) actualStepDuration = 0.01;
+        // 1. Advance Values (Advance Before Play)
+        // In MIDI Gate Mode, the master source advances only on a new MIDI trigger (Step Advance)
+        bool masterHit = track.masterTriggers[(size_t)stepIdx] && probCheck;
+        bool masterAdvance = isMidiGateMode ? (pendingMidiTrigger && probCheck) : masterHit;
         
-            // --- CORE LOGIC ---
-            currentMasterStep = stepIdx;
-            
-            // Check Probability (Needed for advancement logic)
-            bool probCheck = true;
-            if (masterProbEnabled[(size_t)stepIdx])
-            {
-                int roll = random.nextInt(100);
-                if (roll >= masterProbability) probCheck = false;
-            }
-            
-            bool isGateOpen = !heldMidiNotes.empty();
-
-            // 1. Advance Values (Advance Before Play)
-            auto processValueAdvancement = [&](SequencerLane& lane) {
-                bool masterHit = false;
-                if (isMidiGateMode) {
-                    // In MIDI Gate Mode, advance only on new MIDI trigger (Step Advance)
-                    masterHit = lane.enableMasterSource && pendingMidiTrigger && probCheck;
-                } else {
-                    masterHit = lane.enableMasterSource && masterTriggers[(size_t)stepIdx] && probCheck;
-                }
+        // Hit masks use the current trigger step, which stays put until step 4
+        const auto lanesToAdvance = lanes.getHitMask(masterAdvance);
+        const auto lanesToSend = lanes.getHitMask(masterHit);
+        lanes.advanceValues(lanesToAdvance);
+        
+        // Update Active Step for UI and Playback
+        // Note: activeValueStep is updated every step to show current sequencer position
+        lanes.latchActiveSteps();
+
+        // Use currentValueStep for logic (the value waiting to be played)
+        int l = lanes.getCurrentValue(lengthLaneIndex);
+        bool isHold = (l == 9);
+
+        // Define CC Processing Helper
+        auto processCCLanes = [&](bool onlyPGM) {
+            for (int lane = firstCCLaneIndex; lane < lanes.numActiveLanes; ++lane) {
+                const auto i = (size_t)lane;
+                if (lanes.midiCC[i] == 0) continue; // OFF
+                if (lanes.midiCC[i] == 130) continue; // CHORD Mode (Handled in Note Logic)
                 
-                // Use current trigger step state
-                int localStep = lane.currentTriggerStep;
-                bool localHit = lane.enableLocalSource && lane.triggers[(size_t)localStep];
+                bool isPGM = (lanes.midiCC[i] == 128);
+                if (onlyPGM != isPGM) continue;
+                if (((lanesToSend >> lane) & 1) == 0) continue;
                 
-                if (masterHit || localHit)
-                    lane.advanceValue(random);
-            };
-            
-            processValueAdvancement(noteLane);
-            processValueAdvancement(octaveLane);
-            processValueAdvancement(velocityLane);
-            processValueAdvancement(lengthLane);
-            
-            processValueAdvancement(ccLane1);
-            processValueAdvancement(ccLane2);
-            processValueAdvancement(ccLane3);
-            processValueAdvancement(ccLane4);
-            
-            // Update Active Step for UI and Playback
-            // Note: activeValueStep is updated every step to show current sequencer position
-            
-            noteLane.activeTriggerStep = noteLane.currentTriggerStep;
-            octaveLane.activeTriggerStep = octaveLane.currentTriggerStep;
-            velocityLane.activeTriggerStep = velocityLane.currentTriggerStep;
-            lengthLane.activeTriggerStep = lengthLane.currentTriggerStep;
-
-            noteLane.activeValueStep = noteLane.currentValueStep;
-            octaveLane.activeValueStep = octaveLane.currentValueStep;
-            velocityLane.activeValueStep = velocityLane.currentValueStep;
-            lengthLane.activeValueStep = lengthLane.currentValueStep;
-
-            ccLane1.activeTriggerStep = ccLane1.currentTriggerStep;
-            ccLane2.activeTriggerStep = ccLane2.currentTriggerStep;
-            ccLane3.activeTriggerStep = ccLane3.currentTriggerStep;
-            ccLane4.activeTriggerStep = ccLane4.currentTriggerStep;
-            
-            ccLane1.activeValueStep = ccLane1.currentValueStep;
-            ccLane2.activeValueStep = ccLane2.currentValueStep;
-            ccLane3.activeValueStep = ccLane3.currentValueStep;
-            ccLane4.activeValueStep = ccLane4.currentValueStep;
-
-            // Use currentValueStep for logic (the value waiting to be played)
-            int l = lengthLane.values[(size_t)lengthLane.currentValueStep];
-            bool isHold = (l == 9);
-
-            // Define CC Processing Helper
-            auto processCCLane = [&](SequencerLane& lane, bool onlyPGM) {
-                if (lane.midiCC == 0) return; // OFF
-                if (lane.midiCC == 130) return; // CHORD Mode (Handled in Note Logic)
+                int val = juce::jlimit(0, 127, lanes.getCurrentValue(lane));
+                auto& ramp = lanes.ramps[i];
                 
-                bool isPGM = (lane.midiCC == 128);
-                if (onlyPGM && !isPGM) return;
-                if (!onlyPGM && isPGM) return;
-
-                bool masterHit = lane.enableMasterSource && masterTriggers[(size_t)stepIdx] && probCheck;
-                bool localHit = lane.enableLocalSource && lane.triggers[(size_t)lane.activeTriggerStep];
+                // Max ramp duration (smoothing 100) = 1/32 note = samplesPerQuarterNote / 8.0
+                // PGM is never smoothed
+                double dur = isPGM ? 0.0 : (lanes.smoothing[i] / 100.0) * (samplesPerQuarterNote / 8.0);
                 
-                if (masterHit || localHit)
+                if (dur < 1.0)
                 {
-                    int val = lane.values[(size_t)lane.currentValueStep];
-                    val = juce::jlimit(0, 127, val);
-                    
-                    lane.targetCCValue = val;
+                    ramp.targetCCValue = val;
+                    ramp.isRamping = false;
+                    ramp.currentSmoothedValue = (float)val;
                     
-                    if (isPGM) // PGM is never smoothed
-                    {
-                         lane.isRamping = false;
-                         lane.currentSmoothedValue = (float)val;
-                         
-                         if (val != lane.lastSentCCValue) {
-                             sendCC(lane, sampleOffset, val);
-                             lane.lastSentCCValue = val;
-                         }
-                    }
-                    else 
-                    {
-                        if (lane.smoothing == 0)
-                        {
-                            lane.isRamping = false;
-                            lane.currentSmoothedValue = (float)val;
-                            
-                            if (val != lane.lastSentCCValue) {
-                                sendCC(lane, sampleOffset, val);
-                                lane.lastSentCCValue = val;
-                            }
-                        }
-                        else
-                        {
-                            // Setup Ramp
-                            // Max duration (100) = 1/32 note
-                            // 1/32 note = samplesPerQuarterNote / 8.0
-                            double maxDur = samplesPerQuarterNote / 8.0;
-                            double dur = (lane.smoothing / 100.0) * maxDur;
-                            
-                            if (dur < 1.0) {
-                                 lane.isRamping = false;
-                                 lane.currentSmoothedValue = (float)val;
-                                 
-                                 if (val != lane.lastSentCCValue) {
-                                     sendCC(lane, sampleOffset, val);
-                                     lane.lastSentCCValue = val;
-                                 }
-                            } else {
-                                 // Only start ramp if target is different from current output
-                                 if (val != lane.lastSentCCValue) {
-                                     lane.isRamping = true;
-                                     lane.rampSamplesRemaining = (int)dur;
-                                     lane.rampIncrement = (val - lane.currentSmoothedValue) / dur;
-                                 }
-                            }
-                        }
+                    if (val != ramp.lastSentCCValue) {
+                        sendCC(lanes, lane, sampleOffset, val);
+                        ramp.lastSentCCValue = val;
                     }
                 }
-            };
-
-            // Priority 1: Process PGM Changes (Before Notes)
-            processCCLane(ccLane1, true);
-            processCCLane(ccLane2, true);
-            processCCLane(ccLane3, true);
-            processCCLane(ccLane4, true);
-
-            // 2. Play Note (Only if Master Trigger is active OR Hold is active)
-            bool shouldTrigger = false;
-            if (isMidiGateMode) {
-                // In MIDI Mode, trigger only on new MIDI trigger (Step Advance)
-                shouldTrigger = pendingMidiTrigger && probCheck;
-            } else {
-                shouldTrigger = (masterTriggers[(size_t)stepIdx] && probCheck);
+                else if (val != ramp.lastSentCCValue) // Only start ramp if target is different from current output
+                {
+                    ramp.startRamp(blockStartSample + sampleOffset, val, dur);
+                }
+                else
+                {
+                    ramp.targetCCValue = val;
+                }
             }
-            if (shouldTrigger || (isHold && isHoldActive))
-            {
-                 int n = noteLane.values[(size_t)noteLane.currentValueStep];
-                 int o = octaveLane.values[(size_t)octaveLane.currentValueStep];
-                 int v = velocityLane.values[(size_t)velocityLane.currentValueStep];
-                 // int l is already defined above
-                 
-                 // Note: 0-11 (C to B)
-                 // Octave: -2 to 8
-                 // C-2 is MIDI 0.
-                 // Formula: (Octave + 2) * 12 + Note
-                 
-                 int mNote = (o + 2) * 12 + n + transposeOffset;
-                 mNote = juce::jlimit(0, 127, mNote);
+        };
 
-                 // CHORD LOGIC
-                 std::vector<int> chordOffsets;
-                 chordOffsets.push_back(0); // Root
-                 
-                 int chordType = 0;
-                 auto checkChord = [&](SequencerLane& lane) {
-                     if (lane.midiCC == 130) {
-                         // Always read the current value for CHORD mode, regardless of trigger state
-                         int val = lane.values[(size_t)lane.currentValueStep];
-                         if (val > 0) chordType = val;
-                     }
-                 };
-                 checkChord(ccLane1); checkChord(ccLane2); checkChord(ccLane3); checkChord(ccLane4);
+        // Priority 1: Process PGM Changes (Before Notes)
+        processCCLanes(true);
+
+        // 2. Play Note (Only if Master Trigger is active OR Hold is active)
+        bool shouldTrigger = false;
+        if (isMidiGateMode) {
+            // In MIDI Mode, trigger only on new MIDI trigger (Step Advance)
+            shouldTrigger = pendingMidiTrigger && probCheck;
+        } else {
+            shouldTrigger = (track.masterTriggers[(size_t)stepIdx] && probCheck);
+        }
+        if (shouldTrigger || (isHold && track.isHoldActive))
+        {
+             int n = lanes.getCurrentValue(noteLaneIndex);
+             int o = lanes.getCurrentValue(octaveLaneIndex);
+             int v = lanes.getCurrentValue(velocityLaneIndex);
+             // int l is already defined above
+             
+             // Note: 0-11 (C to B)
+             // Octave: -2 to 8
+             // C-2 is MIDI 0.
+             // Formula: (Octave + 2) * 12 + Note
+             
+             int mNote = (o + 2) * 12 + n + transposeOffset;
+             mNote = juce::jlimit(0, 127, mNote);
+
+             // CHORD LOGIC
+             int chordType = 0;
+             for (int lane = firstCCLaneIndex; lane < lanes.numActiveLanes; ++lane) {
+                 if (lanes.midiCC[(size_t)lane] == 130) {
+                     // Always read the current value for CHORD mode, regardless of trigger state
+                     int val = lanes.getCurrentValue(lane);
+                     if (val > 0) chordType = val;
+                 }
+             }
+             const auto& chord = getLiveChordTable(track).get(chordType);
+             const int noteChannel = lanes.midiChannel[noteLaneIndex];
+             
+             long long dur = ticksPerStep;
+             // bool play = true;
+             
+             // Length Values: 
+             // 0:OFF, 1:128n, 2:128d, 3:64n, 4:64d, 5:32n, 6:32d, 7:16n, 8:LEG, 9:HOLD
+             bool isHoldStep = (l == 9);
+             bool shouldPlay = (l != 0);
+             
+             if (isMidiGateMode && l == 0) shouldPlay = true; // Treat 0 as Sustain in MIDI Mode
+
+             if (l == 0) { /* play = false; */ }
+             else if (l == 1) dur = ticksPerQuarterNote / 32;
+             else if (l == 2) dur = ticksPerQuarterNote * 3 / 64;
+             else if (l == 3) dur = ticksPerQuarterNote / 16;
+             else if (l == 4) dur = ticksPerQuarterNote * 3 / 32;
+             else if (l == 5) dur = ticksPerQuarterNote / 8;
+             else if (l == 6) dur = ticksPerQuarterNote * 3 / 16;
+             else if (l == 7) dur = actualStepTicks * 24 / 25;
+             else if (l == 8) dur = actualStepTicks + 10; // Legato
+             else if (l == 9) {
+                 // play = true; // HOLD triggers a note
+                 dur = actualStepTicks; // Default to fill step
+             }
+             
+             bool extended = false;
+             
+             // Check if we are continuing a hold chain
+             // Only extend if there is NO new trigger (Gate OFF) OR if it is an explicit HOLD step
+             if (track.isHoldActive && track.lastTriggeredGroupID >= 0 && (!track.masterTriggers[(size_t)stepIdx] || isHoldStep))
+             {
+                 // Verify at least one note in group is still active
+                 bool groupFound = (track.lastTriggeredGroupHead >= 0);
                  
-                 if (chordType > 0) {
-                     switch(chordType) {
-                         // 3-Note Chords (1-12)
-                         case 1: chordOffsets = {0, 4, 7}; break; // Maj
-                         case 2: chordOffsets = {0, 3, 7}; break; // Min
-                         case 3: chordOffsets = {0, 3, 6}; break; // Dim
-                         case 4: chordOffsets = {0, 4, 8}; break; // Aug
-                         case 5: chordOffsets = {0, 2, 7}; break; // Sus2
-                         case 6: chordOffsets = {0, 5, 7}; break; // Sus4
-                         case 7: chordOffsets = {0, 7, 12}; break; // Power (Root+5+8)
-                         case 8: chordOffsets = {0, 4, 12}; break; // Maj (Open/Inv)
-                         case 9: chordOffsets = {0, 3, 12}; break; // Min (Open/Inv)
-                         case 10: chordOffsets = {0, 7, 16}; break; // Maj (Spread)
-                         case 11: chordOffsets = {0, 7, 15}; break; // Min (Spread)
-                         case 12: chordOffsets = {0, 12, 24}; break; // Octaves
-                         
-                         // 4-Note Chords (13-24)
-                         case 13: chordOffsets = {0, 4, 7, 11}; break; // Maj7
-                         case 14: chordOffsets = {0, 3, 7, 10}; break; // Min7
-                         case 15: chordOffsets = {0, 4, 7, 10}; break; // Dom7
-                         case 16: chordOffsets = {0, 3, 6, 9}; break; // Dim7
-                         case 17: chordOffsets = {0, 3, 6, 10}; break; // HalfDim7
-                         case 18: chordOffsets = {0, 3, 7, 11}; break; // MinMaj7
-                         case 19: chordOffsets = {0, 4, 7, 9}; break; // Maj6
-                         case 20: chordOffsets = {0, 3, 7, 9}; break; // Min6
-                         case 21: chordOffsets = {0, 4, 11, 14}; break; // Maj9 (No 5)
-                         case 22: chordOffsets = {0, 3, 10, 14}; break; // Min9 (No 5)
-                         case 23: chordOffsets = {0, 5, 7, 10}; break; // 7sus4
-                         case 24: chordOffsets = {0, 4, 10, 15}; break; // 7#9
-                         
-                         default: chordOffsets = {0, 4, 7}; break; // Default to Maj
+                 if (groupFound && shouldPlay)
+                 {
+                     // Extend ALL notes in the group
+                     for (int i = track.lastTriggeredGroupHead; i >= 0; i = activeNotes[(size_t)i].nextInGroup) {
+                         activeNotes[(size_t)i].noteOffTick = tick + dur;
+                         rescheduleNoteOff(i);
                      }
+                     extended = true;
+                     
+                     // Update State
+                     if (!isHoldStep) track.isHoldActive = false; // End of chain
                  }
-                 
-                 double dur = 0.25;
-                 // bool play = true;
-                 
-                 // Length Values: 
-                 // 0:OFF, 1:128n, 2:128d, 3:64n, 4:64d, 5:32n, 6:32d, 7:16n, 8:LEG, 9:HOLD
-                 bool isHoldStep = (l == 9);
-                 bool shouldPlay = (l != 0);
-                 
-                 if (isMidiGateMode && l == 0) shouldPlay = true; // Treat 0 as Sustain in MIDI Mode
-
-                 if (l == 0) { /* play = false; */ }
-                 else if (l == 1) dur = 0.03125;
-                 else if (l == 2) dur = 0.046875;
-                 else if (l == 3) dur = 0.0625;
-                 else if (l == 4) dur = 0.09375;
-                 else if (l == 5) dur = 0.125;
-                 else if (l == 6) dur = 0.1875;
-                 else if (l == 7) dur = actualStepDuration * 0.96;
-                 else if (l == 8) dur = actualStepDuration + 0.01; // Legato
-                 else if (l == 9) {
-                     // play = true; // HOLD triggers a note
-                     dur = actualStepDuration; // Default to fill step
+                 else
+                 {
+                     track.isHoldActive = false; // Note died or Rest, can't extend
                  }
+             }
+             
+             if (!extended && shouldPlay && v > 0)
+             {
+                 currentGroupID++; // New group for this trigger
+                 track.lastTriggeredGroupID = currentGroupID;
+                 track.lastTriggeredGroupHead = -1;
                  
-                 bool extended = false;
-                 
-                 // Check if we are continuing a hold chain
-                 // Only extend if there is NO new trigger (Gate OFF) OR if it is an explicit HOLD step
-                 if (isHoldActive && lastTriggeredGroupID >= 0 && (!masterTriggers[(size_t)stepIdx] || isHoldStep))
-                 {
-                     // Verify at least one note in group is still active
-                     bool groupFound = false;
-                     for (auto& note : activeNotes) {
-                         if (note.isActive && note.groupID == lastTriggeredGroupID) {
-                             groupFound = true;
-                             break;
-                         }
+                 // Determine Source MIDI Note for Sustain
+                 int sourceMidiNote = -1;
+                 bool isSustain = false;
+                 if (isMidiGateMode && l == 0) {
+                     if (heldMidiNotes.any()) {
+                         isSustain = true;
+                         sourceMidiNote = getHighestHeldMidiNote();
+                     } else {
+                         // Gate closed before step triggered (staccato tap)
+                         // Play short note instead of sustaining
+                         isSustain = false;
+                         dur = ticksPerQuarterNote / 8;
                      }
+                 }
+
+                 for (int c = 0; c < chord.numNotes; ++c) {
+                     int offset = chord.offsets[(size_t)c];
+                     int currentNote = juce::jlimit(0, 127, mNote + offset);
                      
-                     if (groupFound && shouldPlay)
+                     // Handle overlapping notes of same pitch
+                     for (int i = notesByPitch[(size_t)(noteChannel - 1)][(size_t)currentNote]; i >= 0; )
                      {
-                         // Extend ALL notes in the group
-                         for (auto& note : activeNotes) {
-                             if (note.isActive && note.groupID == lastTriggeredGroupID) {
-                                 note.noteOffPosition = time + dur;
-                             }
+                         auto& note = activeNotes[(size_t)i];
+                         int next = note.nextSamePitch;
+                         if (note.noteOffTick >= tick)
+                         {
+                             midiMessages.addEvent(juce::MidiMessage::noteOff(noteChannel, currentNote), sampleOffset);
+                             stopActiveNote(i);
                          }
-                         extended = true;
-                         
-                         // Update State
-                         if (!isHoldStep) isHoldActive = false; // End of chain
-                     }
-                     else
-                     {
-                         isHoldActive = false; // Note died or Rest, can't extend
+                         i = next;
                      }
-                 }
-                 
-                 if (!extended && shouldPlay && v > 0)
-                 {
-                     currentGroupID++; // New group for this trigger
-                     lastTriggeredGroupID = currentGroupID;
-                     
-                     // Determine Source MIDI Note for Sustain
-                     int sourceMidiNote = -1;
-                     bool isSustain = false;
-                     if (isMidiGateMode && l == 0) {
-                         if (!heldMidiNotes.empty()) {
-                             isSustain = true;
-                             sourceMidiNote = *heldMidiNotes.rbegin();
-                         } else {
-                             // Gate closed before step triggered (staccato tap)
-                             // Play short note instead of sustaining
-                             isSustain = false;
-                             dur = 0.125; 
-                         }
-                     }
-
-                     for (int offset : chordOffsets) {
-                         int currentNote = juce::jlimit(0, 127, mNote + offset);
-                         
-                         // Handle overlapping notes of same pitch
-                         for (auto& note : activeNotes)
-                         {
-                             if (!note.isActive) continue;
-                             if (note.noteNumber == currentNote && note.midiChannel == 1 && note.noteOffPosition >= time - 0.0001)
-                             {
-                                 midiMessages.addEvent(juce::MidiMessage::noteOff(1, currentNote), sampleOffset);
-                                 note.isActive = false;
-                             }
-                         }
 
-                         midiMessages.addEvent(juce::MidiMessage::noteOn(1, currentNote, (juce::uint8)v), sampleOffset);
-                         
-                         // Find free slot
-                         for (int i = 0; i < maxActiveNotes; ++i)
-                         {
-                             auto& note = activeNotes[(size_t)i];
-                             if (!note.isActive)
-                             {
-                                 note.isActive = true;
-                                 note.noteNumber = currentNote;
-                                 note.midiChannel = 1;
-                                 note.groupID = currentGroupID;
-                                 
-                                 if (isSustain) {
-                                     note.isMidiSustain = true;
-                                     note.sourceMidiNote = sourceMidiNote;
-                                     note.noteOffPosition = time + 10000.0; // Infinite
-                                 } else {
-                                     note.isMidiSustain = false;
-                                     note.sourceMidiNote = -1;
-                                     note.noteOffPosition = time + dur;
-                                 }
-                                 
-                                 isHoldActive = true; 
-                                 
-                                 break;
-                             }
-                         }
+                     // Claim a voice before the note-on, so every note-on we send gets its note-off
+                     int i = allocateNote(midiMessages, sampleOffset);
+                     if (i < 0) continue;
+                     
+                     midiMessages.addEvent(juce::MidiMessage::noteOn(noteChannel, currentNote, (juce::uint8)v), sampleOffset);
+                     
+                     auto& note = activeNotes[(size_t)i];
+                     note.isActive = true;
+                     note.noteNumber = currentNote;
+                     note.midiChannel = noteChannel;
+                     note.velocity = v;
+                     note.groupID = currentGroupID;
+                     note.track = trackIndex;
+                     
+                     if (isSustain) {
+                         note.isMidiSustain = true;
+                         note.sourceMidiNote = sourceMidiNote;
+                         note.noteOffTick = tick + 10000LL * ticksPerQuarterNote; // Infinite
+                     } else {
+                         note.isMidiSustain = false;
+                         note.sourceMidiNote = -1;
+                         note.noteOffTick = tick + dur;
                      }
+                     
+                     startActiveNote(i);
+                     track.isHoldActive = true;
                  }
-                 else if (!shouldPlay)
-                 {
-                     isHoldActive = false;
-                 }
-            }
-            else
-            {
-                // Master Trigger OFF -> Break Hold
-                isHoldActive = false;
-            }
-
-            // 3. Process CC Lanes (Priority 3: Deferred/Smoothed)
-            processCCLane(ccLane1, false);
-            processCCLane(ccLane2, false);
-            processCCLane(ccLane3, false);
-            processCCLane(ccLane4, false);
-        
-            // 4. Advance Triggers (Post-Processing)
-            auto processTriggerAdvancement = [&](SequencerLane& lane) {
-                // Advance trigger step for next time
-                lane.advanceTrigger(random);
-            };
-            
-            processTriggerAdvancement(noteLane);
-            processTriggerAdvancement(octaveLane);
-            processTriggerAdvancement(velocityLane);
-            processTriggerAdvancement(lengthLane);
-            
-            processTriggerAdvancement(ccLane1);
-            processTriggerAdvancement(ccLane2);
-            processTriggerAdvancement(ccLane3);
-            processTriggerAdvancement(ccLane4);
-            
-            // Reset Pending Trigger after processing step
-            if (isMidiGateMode) pendingMidiTrigger = false;
+             }
+             else if (!shouldPlay)
+             {
+                 track.isHoldActive = false;
+             }
         }
+        else
+        {
+            // Master Trigger OFF -> Break Hold
+            track.isHoldActive = false;
+        }
+
+        // 3. Process CC Lanes (Priority 3: Deferred/Smoothed)
+        processCCLanes(false);
+    
+        // 4. Advance Triggers (Post-Processing)
+        lanes.advanceTriggers();
+    };
+    
+    while (nextStepTick < blockEndTick)
+    {
+        const long long k = nextStepIndex;
+        const long long tick = nextStepTick;
+        
+        // Safe Shuffle Update: Only update on even (unshuffled) steps,
+        // so the odd step that follows is scheduled with the amount latched here
+        if (k % 2 == 0)
+            activeShuffleAmount = shuffleAmount;
+        
+        int sampleOffset = tickToSampleOffset(tick);
+        
+        // Process Ramps up to here
+        processCCRampsUpTo(sampleOffset);
+        
+        // Update MIDI State up to this sample offset
+        processMidiEventsUpTo(sampleOffset); // Events that happened before or at this step
+        
+        processNoteOffsBefore(tick);
+        
+        // Schedule the following step; its time also gives the actual step duration for length logic
+        nextStepIndex = k + 1;
+        nextStepTick = getStepTick(nextStepIndex);
+
+        long long actualStepTicks = nextStepTick - tick;
+        if (actualStepTicks <= 0) actualStepTicks = 10;
+    
+        // --- CORE LOGIC ---
+        const bool isBarStart = bars.isFirstStepOfBar(k);
+        
+        for (int t = 0; t < numTracks; ++t)
+            playTrackStep(t, k, tick, sampleOffset, actualStepTicks, isBarStart);
+        
+        // Reset Pending Trigger after processing step
+        if (isMidiGateMode) pendingMidiTrigger = false;
     }
+    lastAbsStep = nextStepIndex; // First step not yet played
     
     // Process remaining ramps
-    int remaining = numSamples - currentSamplePos;
-    if (remaining > 0) processCCRamps(currentSamplePos, remaining);
+    processCCRampsUpTo(numSamples);
     
     // Process any remaining MIDI events after the last step
-    if (isMidiGateMode)
+    processMidiEventsUpTo(std::numeric_limits<int>::max());
+    
+    // Note offs left in this block
+    processNoteOffsBefore(blockEndTick);
+    
+    lastPositionTick = blockEndTick;
+}
+
+int ShequencerAudioProcessor::getHighestHeldMidiNote() const
+{
+    for (int n = 127; n >= 0; --n)
+        if (heldMidiNotes.test((size_t)n)) return n;
+    return -1;
+}
+
+bool ShequencerAudioProcessor::isNoteSounding(int midiChannel, int noteNumber) const
+{
+    if (midiChannel < 1 || midiChannel > 16 || noteNumber < 0 || noteNumber > 127) return false;
+    return notesByPitch[(size_t)(midiChannel - 1)][(size_t)noteNumber] >= 0;
+}
+
+int ShequencerAudioProcessor::allocateNote(juce::MidiBuffer& midi, int sampleOffset)
+{
+    auto releaseNote = [&](int index) {
+        const auto& note = activeNotes[(size_t)index];
+        midi.addEvent(juce::MidiMessage::noteOff(note.midiChannel, note.noteNumber), sampleOffset);
+        stopActiveNote(index);
+    };
+    
+    while (numActiveNotes >= maxPolyphony || firstFreeNote < 0)
     {
-        auto it = midiEvents.begin();
-        while (it != midiEvents.end())
+        int victim = chooseNoteToSteal();
+        if (victim < 0) return -1;
+        
+        if (voiceStealMode == VoiceStealMode::SameGroup)
         {
-            if (it->isNoteOn) {
-                heldMidiNotes.insert(it->noteNumber);
-                pendingMidiTrigger = true; // Persist to next block
-            }
-            else {
-                heldMidiNotes.erase(it->noteNumber);
-                
-                // Kill specific sustained notes linked to this MIDI note
-                for (auto& note : activeNotes) {
-                    if (note.isActive && note.isMidiSustain && note.sourceMidiNote == it->noteNumber) {
-                        midiMessages.addEvent(juce::MidiMessage::noteOff(note.midiChannel, note.noteNumber), it->sampleOffset);
-                        note.isActive = false;
-                    }
-                }
+            // Rewind to the first note of the victim's group, then release all of it
+            int first = victim;
+            while (activeNotes[(size_t)first].prevInGroup >= 0) first = activeNotes[(size_t)first].prevInGroup;
+            
+            for (int i = first; i >= 0; )
+            {
+                int next = activeNotes[(size_t)i].nextInGroup;
+                releaseNote(i);
+                i = next;
             }
-            it = midiEvents.erase(it);
+        }
+        else
+        {
+            releaseNote(victim);
         }
     }
-    // Process Note Offs (Time-based Expiry)
-    for (auto& note : activeNotes)
-    {
-        if (!note.isActive) continue;
-        
-        // Skip if sustained by MIDI
-        if (note.isMidiSustain) continue;
+    
+    int index = firstFreeNote;
+    firstFreeNote = activeNotes[(size_t)index].nextFree;
+    activeNotes[(size_t)index].nextFree = -1;
+    return index;
+}
 
-        if (currentPPQ >= note.noteOffPosition) // Already passed?
+int ShequencerAudioProcessor::chooseNoteToSteal() const
+{
+    // Prefer notes outside the group being triggered, so a big chord doesn't steal from itself
+    int fallback = -1;
+    int best = -1;
+    
+    for (int i = oldestNote; i >= 0; i = activeNotes[(size_t)i].nextByAge)
+    {
+        const auto& note = activeNotes[(size_t)i];
+        if (note.groupID == currentGroupID)
         {
-             midiMessages.addEvent(juce::MidiMessage::noteOff(note.midiChannel, note.noteNumber), 0);
-             note.isActive = false;
+            if (fallback < 0) fallback = i;
+            continue;
         }
-        else if (note.noteOffPosition < endPPQ) // Will happen in this block
+        
+        if (voiceStealMode != VoiceStealMode::Quietest) return i;
+        if (best < 0 || note.velocity < activeNotes[(size_t)best].velocity) best = i;
+    }
+    
+    return best >= 0 ? best : fallback;
+}
+
+void ShequencerAudioProcessor::startActiveNote(int index)
+{
+    auto& note = activeNotes[(size_t)index];
+    auto& track = tracks[(size_t)note.track];
+    jassert(note.isActive && note.groupID == track.lastTriggeredGroupID);
+    
+    // Age list (newest at the end)
+    note.prevByAge = newestNote;
+    note.nextByAge = -1;
+    if (newestNote >= 0) activeNotes[(size_t)newestNote].nextByAge = index;
+    else oldestNote = index;
+    newestNote = index;
+    ++numActiveNotes;
+    note.startOrder = noteStartCounter++;
+    
+    // Group list (new notes always join their track's last triggered group)
+    note.prevInGroup = -1;
+    note.nextInGroup = track.lastTriggeredGroupHead;
+    if (track.lastTriggeredGroupHead >= 0) activeNotes[(size_t)track.lastTriggeredGroupHead].prevInGroup = index;
+    track.lastTriggeredGroupHead = index;
+    
+    // Pitch list
+    auto& pitchHead = notesByPitch[(size_t)(note.midiChannel - 1)][(size_t)note.noteNumber];
+    note.prevSamePitch = -1;
+    note.nextSamePitch = pitchHead;
+    if (pitchHead >= 0) activeNotes[(size_t)pitchHead].prevSamePitch = index;
+    pitchHead = index;
+    
+    // Note-off heap (MIDI sustained notes end on the gate note-off instead)
+    if (note.isMidiSustain)
+    {
+        note.heapIndex = -1;
+    }
+    else
+    {
+        note.heapIndex = noteOffHeapSize;
+        noteOffHeap[(size_t)noteOffHeapSize++] = index;
+        noteOffHeapSiftUp(note.heapIndex);
+    }
+}
+
+void ShequencerAudioProcessor::stopActiveNote(int index)
+{
+    auto& note = activeNotes[(size_t)index];
+    if (!note.isActive) return;
+    
+    if (note.heapIndex >= 0)
+    {
+        int pos = note.heapIndex;
+        int last = noteOffHeap[(size_t)--noteOffHeapSize];
+        if (last != index)
         {
-            double offsetPPQ = note.noteOffPosition - currentPPQ;
-            int sampleOffset = (int)(offsetPPQ * samplesPerQuarterNote);
-            sampleOffset = juce::jlimit(0, numSamples - 1, sampleOffset);
-            
-            midiMessages.addEvent(juce::MidiMessage::noteOff(note.midiChannel, note.noteNumber), sampleOffset);
-            note.isActive = false;
+            noteOffHeap[(size_t)pos] = last;
+            activeNotes[(size_t)last].heapIndex = pos;
+            noteOffHeapSiftUp(pos);
+            noteOffHeapSiftDown(activeNotes[(size_t)last].heapIndex);
         }
+        note.heapIndex = -1;
+    }
+    
+    if (note.prevInGroup >= 0) activeNotes[(size_t)note.prevInGroup].nextInGroup = note.nextInGroup;
+    else if (tracks[(size_t)note.track].lastTriggeredGroupHead == index) tracks[(size_t)note.track].lastTriggeredGroupHead = note.nextInGroup;
+    if (note.nextInGroup >= 0) activeNotes[(size_t)note.nextInGroup].prevInGroup = note.prevInGroup;
+    note.prevInGroup = note.nextInGroup = -1;
+    
+    if (note.prevSamePitch >= 0) activeNotes[(size_t)note.prevSamePitch].nextSamePitch = note.nextSamePitch;
+    else notesByPitch[(size_t)(note.midiChannel - 1)][(size_t)note.noteNumber] = note.nextSamePitch;
+    if (note.nextSamePitch >= 0) activeNotes[(size_t)note.nextSamePitch].prevSamePitch = note.prevSamePitch;
+    note.prevSamePitch = note.nextSamePitch = -1;
+    
+    if (note.prevByAge >= 0) activeNotes[(size_t)note.prevByAge].nextByAge = note.nextByAge;
+    else oldestNote = note.nextByAge;
+    if (note.nextByAge >= 0) activeNotes[(size_t)note.nextByAge].prevByAge = note.prevByAge;
+    else newestNote = note.prevByAge;
+    note.prevByAge = note.nextByAge = -1;
+    --numActiveNotes;
+    
+    note.nextFree = firstFreeNote;
+    firstFreeNote = index;
+    note.isActive = false;
+}
+
+void ShequencerAudioProcessor::stopAllActiveNotes(juce::MidiBuffer& midi, int sampleOffset)
+{
+    for (int i = oldestNote; i >= 0; )
+    {
+        const auto& note = activeNotes[(size_t)i];
+        int next = note.nextByAge;
+        midi.addEvent(juce::MidiMessage::noteOff(note.midiChannel, note.noteNumber), sampleOffset);
+        stopActiveNote(i);
+        i = next;
+    }    
+    // Nothing is left for a HOLD step to extend
+    for (auto& track : tracks)
+        track.isHoldActive = false;
+}
+
+void ShequencerAudioProcessor::clearActiveNotes()
+{
+    for (int i = 0; i < maxActiveNotes; ++i)
+    {
+        auto& note = activeNotes[(size_t)i];
+        note.isActive = false;
+        note.heapIndex = -1;
+        note.prevInGroup = note.nextInGroup = -1;
+        note.prevSamePitch = note.nextSamePitch = -1;
+        note.prevByAge = note.nextByAge = -1;
+        note.nextFree = (i + 1 < maxActiveNotes) ? i + 1 : -1;
     }
     
-    lastPositionInQuarterNotes = endPPQ;
+    noteOffHeapSize = 0;
+    for (auto& channel : notesByPitch) channel.fill(-1);
+    for (auto& track : tracks) track.lastTriggeredGroupHead = -1;
+    
+    firstFreeNote = 0;
+    numActiveNotes = 0;
+    oldestNote = newestNote = -1;
+}
+
+void ShequencerAudioProcessor::rescheduleNoteOff(int index)
+{
+    if (activeNotes[(size_t)index].heapIndex < 0) return;
+    
+    noteOffHeapSiftUp(activeNotes[(size_t)index].heapIndex);
+    noteOffHeapSiftDown(activeNotes[(size_t)index].heapIndex);
+}
+
+bool ShequencerAudioProcessor::isNoteOffBefore(int a, int b) const
+{
+    // Ties go to the note started first, so simultaneous note-offs come out in a stable order
+    const auto& noteA = activeNotes[(size_t)a];
+    const auto& noteB = activeNotes[(size_t)b];
+    if (noteA.noteOffTick != noteB.noteOffTick) return noteA.noteOffTick < noteB.noteOffTick;
+    return (juce::int32)(noteA.startOrder - noteB.startOrder) < 0;
+}
+
+void ShequencerAudioProcessor::noteOffHeapSiftUp(int pos)
+{
+    while (pos > 0)
+    {
+        int parent = (pos - 1) / 2;
+        if (!isNoteOffBefore(noteOffHeap[(size_t)pos], noteOffHeap[(size_t)parent])) break;
+        
+        std::swap(noteOffHeap[(size_t)pos], noteOffHeap[(size_t)parent]);
+        activeNotes[(size_t)noteOffHeap[(size_t)pos]].heapIndex = pos;
+        activeNotes[(size_t)noteOffHeap[(size_t)parent]].heapIndex = parent;
+        pos = parent;
+    }
+}
+
+void ShequencerAudioProcessor::noteOffHeapSiftDown(int pos)
+{
+    for (;;)
+    {
+        int smallest = pos;
+        int left = pos * 2 + 1;
+        int right = left + 1;
+        
+        if (left < noteOffHeapSize && isNoteOffBefore(noteOffHeap[(size_t)left], noteOffHeap[(size_t)smallest])) smallest = left;
+        if (right < noteOffHeapSize && isNoteOffBefore(noteOffHeap[(size_t)right], noteOffHeap[(size_t)smallest])) smallest = right;
+        if (smallest == pos) break;
+        
+        std::swap(noteOffHeap[(size_t)pos], noteOffHeap[(size_t)smallest]);
+        activeNotes[(size_t)noteOffHeap[(size_t)pos]].heapIndex = pos;
+        activeNotes[(size_t)noteOffHeap[(size_t)smallest]].heapIndex = smallest;
+        pos = smallest;
+    }
 }
 
 bool ShequencerAudioProcessor::hasEditor() const
@@ -994,208 +1068,631 @@ juce::AudioProcessorEditor* ShequencerAudioProcessor::createEditor()
     return new ShequencerAudioProcessorEditor (*this);
 }
 
-void ShequencerAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
+// XML / JSON tag of each lane, in LaneIndex order
+static const char* const noteLaneTags[] { "NOTE_LANE", "OCTAVE_LANE", "VELOCITY_LANE", "LENGTH_LANE" };
+static constexpr const char* ccLaneTagPrefix = "CC_LANE_";
+
+static juce::String getLaneTagName(size_t lane)
 {
-    juce::XmlElement xml("SHEQUENCER_STATE");
-    
-    // Save Master Data
-    xml.setAttribute("masterLength", masterLength);
-    xml.setAttribute("shuffleAmount", shuffleAmount);
-    xml.setAttribute("isShuffleGlobal", isShuffleGlobal);
-    xml.setAttribute("masterColor", (int)masterColor.getARGB());
-    
-    // Save Selection State
-    xml.setAttribute("currentBank", currentBank);
-    xml.setAttribute("loadedBank", loadedBank);
-    xml.setAttribute("loadedSlot", loadedSlot);
-    
-    juce::String masterTrigStr;
-    for (bool b : masterTriggers) masterTrigStr += (b ? "1" : "0");
-    xml.setAttribute("masterTriggers", masterTrigStr);
-
-    // Helper to save lane
-    auto saveLane = [&](SequencerLane& lane, juce::String name) {
-        auto* laneXml = xml.createNewChildElement(name);
-        laneXml->setAttribute("midiCC", lane.midiCC);
-        laneXml->setAttribute("valueLoopLength", lane.valueLoopLength);
-        laneXml->setAttribute("triggerLoopLength", lane.triggerLoopLength);
-        laneXml->setAttribute("valueResetInterval", lane.valueResetInterval);
-        laneXml->setAttribute("triggerResetInterval", lane.triggerResetInterval);
-        laneXml->setAttribute("randomRange", lane.randomRange);
-        laneXml->setAttribute("enableMasterSource", lane.enableMasterSource);
-        laneXml->setAttribute("enableLocalSource", lane.enableLocalSource);
-        laneXml->setAttribute("valueDirection", (int)lane.valueDirection);
-        laneXml->setAttribute("triggerDirection", (int)lane.triggerDirection);
-        laneXml->setAttribute("customColor", (int)lane.customColor.getARGB());
-        
-        juce::String valStr;
-        for (int v : lane.values) valStr += juce::String(v) + ",";
-        laneXml->setAttribute("values", valStr);
-        
-        juce::String trigStr;
-        for (bool b : lane.triggers) trigStr += (b ? "1" : "0");
-        laneXml->setAttribute("triggers", trigStr);
-    };
+    if (lane < (size_t)ShequencerAudioProcessor::firstCCLaneIndex) return noteLaneTags[lane];
+    return ccLaneTagPrefix + juce::String((int)lane - ShequencerAudioProcessor::firstCCLaneIndex + 1);
+}
+
+// The lane a tag names, -1 for none
+static int findLaneIndex(const char* tag)
+{
+    for (int i = 0; i < ShequencerAudioProcessor::firstCCLaneIndex; ++i)
+        if (std::strcmp(tag, noteLaneTags[i]) == 0) return i;
     
-    saveLane(noteLane, "NOTE_LANE");
-    saveLane(octaveLane, "OCTAVE_LANE");
-    saveLane(velocityLane, "VELOCITY_LANE");
-    saveLane(lengthLane, "LENGTH_LANE");
+    const auto prefixLength = std::strlen(ccLaneTagPrefix);
+    if (std::strncmp(tag, ccLaneTagPrefix, prefixLength) != 0) return -1;
     
-    saveLane(ccLane1, "CC_LANE_1");
-    saveLane(ccLane2, "CC_LANE_2");
-    saveLane(ccLane3, "CC_LANE_3");
-    saveLane(ccLane4, "CC_LANE_4");
+    // Exactly as getLaneTagName writes it: no sign, no leading zeros
+    const char* digits = tag + prefixLength;
+    if (*digits < '1' || *digits > '9') return -1;
     
-    // Save Banks
-    auto* banksXml = xml.createNewChildElement("BANKS");
-    for (int b = 0; b < 4; ++b)
+    int number = 0;
+    for (const char* c = digits; *c != 0; ++c)
+    {
+        if (*c < '0' || *c > '9' || number > ShequencerAudioProcessor::numLanes) return -1;
+        number = number * 10 + (*c - '0');
+    }
+    
+    const int lane = ShequencerAudioProcessor::firstCCLaneIndex + number - 1;
+    return lane < ShequencerAudioProcessor::numLanes ? lane : -1;
+}
+
+// Trigger rows are stored as "1"/"0" strings, step 0 first. Reads the steps present in the
+// string; steps past its end keep their current value.
+static void stepsFromString(const char* str, LaneBank::StepMask& steps)
+{
+    for (size_t i = 0; i < steps.size() && str[i] != 0; ++i)
+        steps[i] = (str[i] == '1');
+}
+
+static void stepsFromString(const juce::String& str, LaneBank::StepMask& steps)
+{
+    stepsFromString(str.toRawUTF8(), steps);
+}
+
+// Chord sets are stored as [ { "name": "Maj", "notes": [0, 4, 7] }, ... ] in both JSON and XML state
+static ChordTable chordTableFromVar(const juce::var& list)
+{
+    ChordTable table;
+    if (!list.isArray()) return table;
+    
+    for (int c = 0; c < list.size(); ++c)
     {
-        auto* bankXml = banksXml->createNewChildElement("BANK");
-        bankXml->setAttribute("index", b);
+        auto chordObj = list[c];
+        auto notes = chordObj.getProperty("notes", juce::var());
         
-        for (int s = 0; s < 16; ++s)
-        {
-            const auto& pat = patternBanks[(size_t)b][(size_t)s];
-            if (!pat.isEmpty)
-            {
-                auto* patXml = bankXml->createNewChildElement("PATTERN");
-                patXml->setAttribute("slot", s);
-                patXml->setAttribute("masterLength", pat.masterLength);
-                patXml->setAttribute("shuffleAmount", pat.shuffleAmount);
-                
-                juce::String mTrig;
-                for (bool v : pat.masterTriggers) mTrig += (v ? "1" : "0");
-                patXml->setAttribute("masterTriggers", mTrig);
-
-                auto savePatLane = [&](const PatternData::LaneData& ld, juce::String name) {
-                    auto* lXml = patXml->createNewChildElement(name);
-                    lXml->setAttribute("midiCC", ld.midiCC);
-                    lXml->setAttribute("valueLoopLength", ld.valueLoopLength);
-                    lXml->setAttribute("triggerLoopLength", ld.triggerLoopLength);
-                    lXml->setAttribute("valueResetInterval", ld.valueResetInterval);
-                    lXml->setAttribute("triggerResetInterval", ld.triggerResetInterval);
-                    lXml->setAttribute("randomRange", ld.randomRange);
-                    lXml->setAttribute("enableMasterSource", ld.enableMasterSource);
-                    lXml->setAttribute("enableLocalSource", ld.enableLocalSource);
-                    lXml->setAttribute("valueDirection", ld.valueDirection);
-                    lXml->setAttribute("triggerDirection", ld.triggerDirection);
-                    lXml->setAttribute("customColor", (int)ld.customColor);
-                    
-                    juce::String vStr;
-                    for (int v : ld.values) vStr += juce::String(v) + ",";
-                    lXml->setAttribute("values", vStr);
-                    
-                    juce::String tStr;
-                    for (bool v : ld.triggers) tStr += (v ? "1" : "0");
-                    lXml->setAttribute("triggers", tStr);
-                };
-                
-                savePatLane(pat.noteLane, "NOTE_LANE");
-                savePatLane(pat.octaveLane, "OCTAVE_LANE");
-                savePatLane(pat.velocityLane, "VELOCITY_LANE");
-                
-                savePatLane(pat.ccLane1, "CC_LANE_1");
-                savePatLane(pat.ccLane2, "CC_LANE_2");
-                savePatLane(pat.ccLane3, "CC_LANE_3");
-                savePatLane(pat.ccLane4, "CC_LANE_4");
-                savePatLane(pat.lengthLane, "LENGTH_LANE");
-            }
-        }
+        std::array<int, ChordTable::maxNotes> offsets {};
+        int numNotes = 0;
+        if (notes.isArray())
+            for (int n = 0; n < notes.size() && numNotes < ChordTable::maxNotes; ++n)
+                offsets[(size_t)numNotes++] = (int)notes[n];
+        
+        if (!table.add(chordObj.getProperty("name", "").toString().toRawUTF8(), offsets.data(), numNotes))
+            break;
     }
+    return table;
+}
+
+static const ChordTable& chordTableFor(const std::array<std::array<PatternData, 16>, 4>& banks, int bank, int slot)
+{
+    if (bank < 0 || bank >= 4 || slot < 0 || slot >= 16) return ChordTable::builtIn();
     
-    copyXmlToBinary(xml, destData);
+    const auto& chords = banks[(size_t)bank][(size_t)slot].chords;
+    return chords.isEmpty() ? ChordTable::builtIn() : chords;
 }
 
-void ShequencerAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+static void storeTrackMaster(const SequencerTrack& track, PatternData& pat)
 {
-    std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
+    pat.masterLength = track.masterLength;
+    pat.masterProbability = track.masterProbability;
+    pat.masterTriggers = track.masterTriggers;
+    pat.masterProbEnabled = track.masterProbEnabled;
+    pat.masterColor = track.masterColor.getARGB();
+    pat.probabilitySeed = track.probabilitySeed;
+    pat.randomReseed = (int)track.randomReseed;
+}
+
+// The master row and lanes of a track, as a stored pattern holds them
+static void storeTrack(const SequencerTrack& track, PatternData& pat)
+{
+    storeTrackMaster(track, pat);
+    pat.storeLanes(track.lanes);
+}
+
+// Loads a stored pattern's master row and lanes into a track
+static void recallTrack(const PatternData& pat, SequencerTrack& track)
+{
+    track.masterLength = juce::jlimit(1, stepCapacity, pat.masterLength);
+    track.masterProbability = pat.masterProbability;
+    track.masterTriggers = pat.masterTriggers;
+    track.masterProbEnabled = pat.masterProbEnabled;
+    track.masterColor = juce::Colour(pat.masterColor);
+    track.probabilitySeed = pat.probabilitySeed;
+    track.randomReseed = (RandomReseed)juce::jlimit(0, 2, pat.randomReseed);
+    pat.recallLanes(track.lanes);
+}
+
+// Takes over a restored track's master row, lanes and loaded slot; its playback state stays
+static void copyTrackPattern(const SequencerTrack& restored, SequencerTrack& track)
+{
+    track.masterTriggers = restored.masterTriggers;
+    track.masterProbEnabled = restored.masterProbEnabled;
+    track.masterLength = restored.masterLength;
+    track.masterProbability = restored.masterProbability;
+    track.masterColor = restored.masterColor;
+    track.probabilitySeed = restored.probabilitySeed;
+    track.randomReseed = restored.randomReseed;
+    track.loadedBank = restored.loadedBank;
+    track.loadedSlot = restored.loadedSlot;
+    track.lanes.copyPattern(restored.lanes);
+}
+
+// Binary State
+// "SHQB", the format version and a compression flag, then the body (GZIP'd when flagged):
+// the step and lane capacity it was written with, global settings, each track as a pattern
+// record plus its playback fields, then every stored pattern with its bank and slot.
+// Step rows and lane values go out as byte blocks. A body from a build with other capacities
+// is trimmed or padded on the way in.
+static constexpr int binaryStateMagic = 0x42514853; // "SHQB" little endian
+static constexpr int binaryStateVersion = 1;
+static constexpr bool compressBinaryState = true;
+static constexpr int maxStoredSteps = 128; // Largest step capacity any build writes
+static constexpr int packedLaneSettingsSize = 9; // The byte settings after each lane's rows
+static constexpr int chordRecordSize = ChordTable::maxNameLength + 1 + ChordTable::maxNotes + 1;
+
+struct BinaryStateLayout
+{
+    int numSteps = stepCapacity;
+    int numLanes = LaneBank::numLanes;
+};
+
+static void writeSteps(juce::OutputStream& out, const LaneBank::StepMask& steps)
+{
+    std::array<juce::uint8, (size_t)(stepCapacity + 7) / 8> bytes {};
+    for (size_t i = 0; i < steps.size(); ++i)
+        bytes[i / 8] |= (juce::uint8)((steps[i] ? 1 : 0) << (i % 8));
+    out.write(bytes.data(), bytes.size());
+}
+
+static void readSteps(juce::InputStream& in, const BinaryStateLayout& layout, LaneBank::StepMask& steps)
+{
+    std::array<juce::uint8, (size_t)maxStoredSteps / 8> bytes {};
+    in.read(bytes.data(), (layout.numSteps + 7) / 8);
     
-    if (xmlState != nullptr && xmlState->hasTagName("SHEQUENCER_STATE"))
+    steps.reset();
+    for (size_t i = 0; i < (size_t)juce::jmin(layout.numSteps, stepCapacity); ++i)
+        steps[i] = ((bytes[i / 8] >> (i % 8)) & 1) != 0;
+}
+
+static void writePackedLane(juce::OutputStream& out, const PatternData::PackedLane& lane)
+{
+    out.write(lane.values.data(), lane.values.size());
+    writeSteps(out, lane.triggers);
+    out.writeInt((int)lane.randomSeed);
+    out.writeInt((int)lane.customColor);
+    
+    const juce::uint8 settings[packedLaneSettingsSize] { lane.valueLoopLength, lane.triggerLoopLength, lane.valueResetInterval, lane.triggerResetInterval,
+                                                         lane.randomRange, lane.midiCC, lane.smoothing, lane.directions, lane.flags };
+    out.write(settings, sizeof(settings));
+}
+
+static void readPackedLane(juce::InputStream& in, const BinaryStateLayout& layout, PatternData::PackedLane& lane)
+{
+    std::array<juce::int8, (size_t)maxStoredSteps> values {};
+    in.read(values.data(), layout.numSteps);
+    std::copy_n(values.begin(), juce::jmin(layout.numSteps, stepCapacity), lane.values.begin());
+    readSteps(in, layout, lane.triggers);
+    lane.randomSeed = (juce::uint32)in.readInt();
+    lane.customColor = (juce::uint32)in.readInt();
+    
+    juce::uint8 settings[packedLaneSettingsSize] {};
+    in.read(settings, sizeof(settings));
+    lane.valueLoopLength = (juce::uint8)juce::jlimit(1, stepCapacity, (int)settings[0]);
+    lane.triggerLoopLength = (juce::uint8)juce::jlimit(1, stepCapacity, (int)settings[1]);
+    lane.valueResetInterval = settings[2];
+    lane.triggerResetInterval = settings[3];
+    lane.randomRange = settings[4];
+    lane.midiCC = settings[5];
+    lane.smoothing = settings[6];
+    lane.directions = settings[7];
+    lane.flags = settings[8];
+}
+
+static void writeChords(juce::OutputStream& out, const ChordTable& table)
+{
+    out.writeInt(table.numChords);
+    for (size_t c = 1; c <= (size_t)table.numChords; ++c)
     {
-        masterLength = xmlState->getIntAttribute("masterLength", 16);
-        shuffleAmount = xmlState->getIntAttribute("shuffleAmount", 1);
-        isShuffleGlobal = xmlState->getBoolAttribute("isShuffleGlobal", true);
-        masterColor = juce::Colour((juce::uint32)xmlState->getIntAttribute("masterColor", 0));
+        const auto& chord = table.chords[c];
+        out.write(chord.name.data(), chord.name.size());
+        out.write(chord.offsets.data(), chord.offsets.size());
+        out.writeByte((char)chord.numNotes);
+    }
+}
 
-        currentBank = xmlState->getIntAttribute("currentBank", 0);
-        loadedBank = xmlState->getIntAttribute("loadedBank", -1);
-        loadedSlot = xmlState->getIntAttribute("loadedSlot", -1);
+static ChordTable readChords(juce::InputStream& in)
+{
+    ChordTable table;
+    table.numChords = juce::jlimit(0, ChordTable::maxChords, in.readInt());
+    for (size_t c = 1; c <= (size_t)table.numChords; ++c)
+    {
+        auto& chord = table.chords[c];
+        in.read(chord.name.data(), (int)chord.name.size());
+        chord.name.back() = 0;
+        in.read(chord.offsets.data(), (int)chord.offsets.size());
+        chord.numNotes = (juce::uint8)juce::jlimit(1, ChordTable::maxNotes, (int)(juce::uint8)in.readByte());
+    }
+    return table;
+}
+
+// A pattern record is the master part, each packed lane, then the chord set
+static void writePatternMaster(juce::OutputStream& out, const PatternData& pat)
+{
+    out.writeInt(pat.masterLength);
+    out.writeInt(pat.shuffleAmount);
+    out.writeInt(pat.masterProbability);
+    out.writeInt((int)pat.masterColor);
+    out.writeInt((int)pat.probabilitySeed);
+    out.writeInt(pat.randomReseed);
+    writeSteps(out, pat.masterTriggers);
+    writeSteps(out, pat.masterProbEnabled);
+}
+
+static void writePatternRecord(juce::OutputStream& out, const PatternData& pat)
+{
+    writePatternMaster(out, pat);
+    
+    for (const auto& lane : pat.lanes)
+        writePackedLane(out, lane);
+    
+    writeChords(out, pat.chords);
+}
+
+static PatternData readPatternRecord(juce::InputStream& in, const BinaryStateLayout& layout)
+{
+    PatternData pat;
+    pat.isEmpty = false;
+    pat.masterLength = juce::jlimit(1, stepCapacity, in.readInt());
+    pat.shuffleAmount = in.readInt();
+    pat.masterProbability = juce::jlimit(0, 100, in.readInt());
+    pat.masterColor = (juce::uint32)in.readInt();
+    pat.probabilitySeed = (juce::uint32)in.readInt();
+    pat.randomReseed = in.readInt();
+    readSteps(in, layout, pat.masterTriggers);
+    readSteps(in, layout, pat.masterProbEnabled);
+    
+    // Lanes keep their index meaning across capacities: note lanes, then the CC lanes in order
+    for (int i = 0; i < layout.numLanes; ++i)
+    {
+        PatternData::PackedLane lane;
+        readPackedLane(in, layout, lane);
+        if (i < LaneBank::numLanes) pat.lanes[(size_t)i] = lane;
+    }
+    
+    pat.chords = readChords(in);
+    return pat;
+}
+
+// A pattern record is fixed size up to its chord count, then one fixed size entry per chord.
+// Copies one record without decoding it.
+static void copyPatternRecord(juce::InputStream& in, const BinaryStateLayout& layout, juce::OutputStream& out)
+{
+    const int stepBytes = (layout.numSteps + 7) / 8;
+    const int laneBytes = layout.numSteps + stepBytes + 2 * 4 + packedLaneSettingsSize;
+    out.writeFromInputStream(in, 6 * 4 + 2 * stepBytes + layout.numLanes * laneBytes);
+    
+    const int numChords = in.readInt();
+    out.writeInt(numChords);
+    out.writeFromInputStream(in, juce::jlimit(0, ChordTable::maxChords, numChords) * chordRecordSize);
+}
+
+// Allocation free, the audio thread decodes a slot the first time it loads it
+static PatternData decodePatternRecord(const EncodedPatterns& encoded, int bank, int slot)
+{
+    const auto& record = encoded.slots[(size_t)bank][(size_t)slot];
+    juce::MemoryInputStream in(static_cast<const char*>(encoded.records.getData()) + record.offset, (size_t)record.size, false);
+    return readPatternRecord(in, { encoded.numSteps, encoded.numLanes });
+}
 
-        juce::String masterTrigStr = xmlState->getStringAttribute("masterTriggers");
-        for (int i = 0; i < 16 && i < masterTrigStr.length(); ++i)
-            masterTriggers[(size_t)i] = (masterTrigStr[i] == '1');
+void ShequencerAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
+{
+    const juce::ScopedLock sl(patternLock);
+    
+    // The edited copy only changes under the lock, so the body is one consistent snapshot
+    syncEditedTracks();
+    
+    juce::MemoryBlock body;
+    {
+        juce::MemoryOutputStream bodyOut(body, false);
+        writeStateBody(bodyOut);
+    }
+    
+    // Nothing changed since the last save: skip compressing it again
+    if (body != lastStateBody || lastState.getSize() == 0)
+    {
+        lastState.reset();
+        {
+            juce::MemoryOutputStream out(lastState, false);
+            out.writeInt(binaryStateMagic);
+            out.writeInt(binaryStateVersion);
+            out.writeBool(compressBinaryState);
             
-        auto loadLane = [&](SequencerLane& lane, juce::String name) {
-            auto* laneXml = xmlState->getChildByName(name);
-            if (laneXml)
+            if (compressBinaryState)
             {
-                lane.midiCC = laneXml->getIntAttribute("midiCC", 0);
-                lane.valueLoopLength = laneXml->getIntAttribute("valueLoopLength", 16);
-                lane.triggerLoopLength = laneXml->getIntAttribute("triggerLoopLength", 16);
-                lane.valueResetInterval = laneXml->getIntAttribute("valueResetInterval", 0);
-                lane.triggerResetInterval = laneXml->getIntAttribute("triggerResetInterval", 0);
-                lane.randomRange = laneXml->getIntAttribute("randomRange", 0);
-                lane.enableMasterSource = laneXml->getBoolAttribute("enableMasterSource", false);
-                lane.enableLocalSource = laneXml->getBoolAttribute("enableLocalSource", true);
-                lane.valueDirection = (SequencerLane::Direction)laneXml->getIntAttribute("valueDirection", 0);
-                lane.triggerDirection = (SequencerLane::Direction)laneXml->getIntAttribute("triggerDirection", 0);
-                lane.customColor = juce::Colour((juce::uint32)laneXml->getIntAttribute("customColor", 0));
-                
-                juce::String valStr = laneXml->getStringAttribute("values");
-                juce::StringArray tokens;
-                tokens.addTokens(valStr, ",", "");
-                for (int i = 0; i < 16 && i < tokens.size(); ++i)
-                    lane.values[(size_t)i] = tokens[i].getIntValue();
-                    
-                juce::String trigStr = laneXml->getStringAttribute("triggers");
-                for (int i = 0; i < 16 && i < trigStr.length(); ++i)
-                    lane.triggers[(size_t)i] = (trigStr[i] == '1');
+                // Fastest level: the step rows are mostly runs, which compress well at any level
+                juce::GZIPCompressorOutputStream zipped(out, 1);
+                zipped.write(body.getData(), body.getSize());
             }
-        };
-        
-        loadLane(noteLane, "NOTE_LANE");
-        loadLane(octaveLane, "OCTAVE_LANE");
-        loadLane(velocityLane, "VELOCITY_LANE");
-        loadLane(lengthLane, "LENGTH_LANE");
-        
-        loadLane(ccLane1, "CC_LANE_1");
-        loadLane(ccLane2, "CC_LANE_2");
-        loadLane(ccLane3, "CC_LANE_3");
-        loadLane(ccLane4, "CC_LANE_4");
+            else
+            {
+                out.write(body.getData(), body.getSize());
+            }
+        }
+        lastStateBody = std::move(body);
+    }
+    
+    destData = lastState;
+}
+
+void ShequencerAudioProcessor::writeStateBody(juce::OutputStream& out)
+{
+    out.writeInt(maxSteps);
+    out.writeInt(numLanes);
+    
+    // Global Data
+    out.writeInt(shuffleAmount);
+    out.writeBool(isShuffleGlobal);
+    out.writeInt(edited.numTracks);
+    out.writeInt(edited.maxPolyphony);
+    out.writeInt((int)edited.voiceStealMode);
+    out.writeInt(currentBank);
+    
+    // Tracks from the edited copy, written as a pattern record: the master part is encoded afresh
+    // (it is small), the lanes come from their records
+    for (int t = 0; t < edited.numTracks; ++t)
+    {
+        const auto& track = edited.tracks[(size_t)t];
+        PatternData pat;
+        pat.shuffleAmount = shuffleAmount;
+        storeTrackMaster(track, pat);
+        writePatternMaster(out, pat);
         
-        // Load Banks
-        auto* banksXml = xmlState->getChildByName("BANKS");
-        if (banksXml)
+        const auto dirty = dirtyLanes[(size_t)t].exchange(0);
+        for (size_t i = 0; i < (size_t)numLanes; ++i)
         {
-            for (auto* bankXml : banksXml->getChildIterator())
+            auto& record = laneRecords[(size_t)t][i];
+            if (((dirty >> i) & 1) || record.getSize() == 0)
             {
-                int b = bankXml->getIntAttribute("index");
-                if (b >= 0 && b < 4)
-                {
-                    for (auto* patXml : bankXml->getChildIterator())
-                    {
-                        int s = patXml->getIntAttribute("slot");
-                        if (s >= 0 && s < 16)
-                        {
-                            auto& pat = patternBanks[(size_t)b][(size_t)s];
-                            pat.isEmpty = false;
-                            pat.masterLength = patXml->getIntAttribute("masterLength", 16);
+                pat.storeLane(i, track.lanes);
+                juce::MemoryOutputStream recordOut(record, false);
+                writePackedLane(recordOut, pat.lanes[i]);
+            }
+            out.write(record.getData(), record.getSize());
+        }
+        writeChords(out, pat.chords);
+        
+        out.writeInt(track.getNumCCLanes());
+        out.writeInt(track.loadedBank);
+        out.writeInt(track.loadedSlot);
+    }
+    
+    // Banks
+    const juce::ScopedLock sl(patternLock);
+    
+    int numStored = 0;
+    for (const auto& bank : patternBanks)
+        for (const auto& pat : bank)
+            numStored += pat.isEmpty ? 0 : 1;
+    
+    out.writeInt(numStored);
+    for (size_t b = 0; b < patternBanks.size(); ++b)
+    {
+        for (size_t s = 0; s < patternBanks[b].size(); ++s)
+        {
+            if (patternBanks[b][s].isEmpty) continue;
+            
+            out.writeByte((char)b);
+            out.writeByte((char)s);
+            
+            // Slots nobody touched since the state was restored go back out as they came in
+            if (encodedSlots[b * 16 + s] && encodedPatterns->numSteps == maxSteps && encodedPatterns->numLanes == numLanes)
+            {
+                const auto& record = encodedPatterns->slots[b][s];
+                out.write(static_cast<const char*>(encodedPatterns->records.getData()) + record.offset, (size_t)record.size);
+                continue;
+            }
+            
+            decodeStoredPattern((int)b, (int)s);
+            auto& record = patternRecords[b][s];
+            if (!cachedPatternRecords[b * 16 + s])
+            {
+                juce::MemoryOutputStream recordOut(record, false);
+                writePatternRecord(recordOut, patternBanks[b][s]);
+                cachedPatternRecords.set(b * 16 + s);
+            }
+            out.write(record.getData(), record.getSize());
+        }
+    }
+}
+
+void ShequencerAudioProcessor::readStateBody(juce::InputStream& in)
+{
+    BinaryStateLayout layout;
+    layout.numSteps = in.readInt();
+    layout.numLanes = in.readInt();
+    if (layout.numSteps < 1 || layout.numSteps > maxStoredSteps || layout.numLanes < 1 || layout.numLanes > 64) return;
+    
+    const juce::ScopedLock sl(patternLock);
+    
+    // The tracks decode into a staging copy, the engine takes it over through restoreSession.
+    // Tracks the state leaves out keep what the edited copy has.
+    syncEditedTracks();
+    auto session = std::make_unique<EditedState>(edited);
+    
+    // Global Data
+    shuffleAmount = in.readInt();
+    isShuffleGlobal = in.readBool();
+    const int storedTracks = in.readInt();
+    session->numTracks = juce::jlimit(1, maxTracks, storedTracks);
+    session->maxPolyphony = juce::jlimit(1, maxActiveNotes, in.readInt());
+    session->voiceStealMode = (VoiceStealMode)juce::jlimit(0, 2, in.readInt());
+    currentBank = juce::jlimit(0, 3, in.readInt());
+    
+    // Tracks past this build's maximum are read and dropped
+    for (int t = 0; t < storedTracks && !in.isExhausted(); ++t)
+    {
+        const auto pat = readPatternRecord(in, layout);
+        const int numCCLanes = in.readInt();
+        const int loadedBank = in.readInt();
+        const int loadedSlot = in.readInt();
+        if (t >= maxTracks) continue;
+        
+        auto& track = session->tracks[(size_t)t];
+        recallTrack(pat, track);
+        track.lanes.numActiveLanes = firstCCLaneIndex + juce::jlimit(0, maxCCLanes, numCCLanes);
+        track.loadedBank = loadedBank;
+        track.loadedSlot = loadedSlot;
+    }
+    
+    // Banks: the records are only copied here, each slot is decoded when first used
+    auto encoded = std::make_shared<EncodedPatterns>();
+    encoded->numSteps = layout.numSteps;
+    encoded->numLanes = layout.numLanes;
+    
+    for (auto& bank : patternBanks)
+        for (auto& pat : bank)
+            pat = {};
+    encodedSlots.reset();
+    cachedPatternRecords.reset();
+    
+    {
+        juce::MemoryOutputStream records(encoded->records, false);
+        const int numStored = in.readInt();
+        for (int i = 0; i < numStored && !in.isExhausted(); ++i)
+        {
+            const auto b = (size_t)(juce::uint8)in.readByte();
+            const auto s = (size_t)(juce::uint8)in.readByte();
+            const int offset = (int)records.getPosition();
+            copyPatternRecord(in, layout, records);
+            if (b >= patternBanks.size() || s >= patternBanks[b].size()) continue;
+            
+            encoded->slots[b][s] = { offset, (int)records.getPosition() - offset };
+            patternBanks[b][s].isEmpty = false;
+            encodedSlots.set(b * 16 + s);
+        }
+    }
+    
+    encodedPatterns = std::move(encoded);
+    
+    // The loaded slots are the live state (their chords play), so those are decoded now
+    for (int t = 0; t < session->numTracks; ++t)
+    {
+        const auto& track = session->tracks[(size_t)t];
+        if (track.loadedBank >= 0 && track.loadedBank < 4 && track.loadedSlot >= 0 && track.loadedSlot < 16)
+            decodeStoredPattern(track.loadedBank, track.loadedSlot);
+    }
+    
+    publishPatternBanks();
+    restoreSession(std::move(session));
+}
+
+void ShequencerAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    juce::MemoryInputStream in(data, (size_t)sizeInBytes, false);
+    if (sizeInBytes > 9 && in.readInt() == binaryStateMagic)
+    {
+        const int version = in.readInt();
+        const bool isCompressed = in.readBool();
+        if (version < 1 || version > binaryStateVersion) return; // Written by a newer build
+        
+        if (isCompressed)
+        {
+            juce::GZIPDecompressorInputStream unzipped(in);
+            readStateBody(unzipped);
+        }
+        else
+        {
+            readStateBody(in);
+        }
+        return;
+    }
+    
+    // Sessions saved before the binary state are XML
+    std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
+    
+    if (xmlState != nullptr && xmlState->hasTagName("SHEQUENCER_STATE"))
+    {
+        const juce::ScopedLock sl(patternLock);
+        
+        // As with the binary state, the tracks decode into a staging copy
+        syncEditedTracks();
+        auto session = std::make_unique<EditedState>(edited);
+        
+        shuffleAmount = xmlState->getIntAttribute("shuffleAmount", 1);
+        isShuffleGlobal = xmlState->getBoolAttribute("isShuffleGlobal", true);
+        session->numTracks = juce::jlimit(1, maxTracks, xmlState->getIntAttribute("numTracks", 1));
+        
+        session->maxPolyphony = juce::jlimit(1, maxActiveNotes, xmlState->getIntAttribute("maxPolyphony", maxActiveNotes));
+        session->voiceStealMode = (VoiceStealMode)juce::jlimit(0, 2, xmlState->getIntAttribute("voiceStealMode", 0));
+
+        currentBank = xmlState->getIntAttribute("currentBank", 0);
+        
+        auto loadTrack = [&](const juce::XmlElement& trackXml, SequencerTrack& track) {
+            auto& lanes = track.lanes;
+            track.masterLength = juce::jlimit(1, maxSteps, trackXml.getIntAttribute("masterLength", 16));
+            track.masterColor = juce::Colour((juce::uint32)trackXml.getIntAttribute("masterColor", 0));
+            track.probabilitySeed = (juce::uint32)trackXml.getIntAttribute("probabilitySeed", 1);
+            track.randomReseed = (RandomReseed)juce::jlimit(0, 2, trackXml.getIntAttribute("randomReseed", 0));
+            lanes.numActiveLanes = firstCCLaneIndex + juce::jlimit(0, maxCCLanes, trackXml.getIntAttribute("numCCLanes", 4));
+            track.loadedBank = trackXml.getIntAttribute("loadedBank", -1);
+            track.loadedSlot = trackXml.getIntAttribute("loadedSlot", -1);
+            
+            stepsFromString(trackXml.getStringAttribute("masterTriggers"), track.masterTriggers);
+            
+            for (size_t lane = 0; lane < (size_t)numLanes; ++lane)
+            {
+                auto* laneXml = trackXml.getChildByName(getLaneTagName(lane));
+                if (laneXml)
+                {
+                    lanes.midiCC[lane] = laneXml->getIntAttribute("midiCC", 0);
+                    lanes.midiChannel[lane] = juce::jlimit(1, 16, laneXml->getIntAttribute("midiChannel", 1));
+                    lanes.valueLoopLength[lane] = juce::jlimit(1, maxSteps, laneXml->getIntAttribute("valueLoopLength", 16));
+                    lanes.triggerLoopLength[lane] = juce::jlimit(1, maxSteps, laneXml->getIntAttribute("triggerLoopLength", 16));
+                    lanes.valueResetInterval[lane] = laneXml->getIntAttribute("valueResetInterval", 0);
+                    lanes.triggerResetInterval[lane] = laneXml->getIntAttribute("triggerResetInterval", 0);
+                    lanes.randomRange[lane] = laneXml->getIntAttribute("randomRange", 0);
+                    lanes.randomSeed[lane] = (juce::uint32)laneXml->getIntAttribute("randomSeed", (int)LaneBank::defaultRandomSeed);
+                    lanes.setMasterSource((int)lane, laneXml->getBoolAttribute("enableMasterSource", false));
+                    lanes.setLocalSource((int)lane, laneXml->getBoolAttribute("enableLocalSource", true));
+                    lanes.valueDirection[lane] = (LaneDirection)laneXml->getIntAttribute("valueDirection", 0);
+                    lanes.triggerDirection[lane] = (LaneDirection)laneXml->getIntAttribute("triggerDirection", 0);
+                    lanes.customColor[lane] = juce::Colour((juce::uint32)laneXml->getIntAttribute("customColor", 0));
+                    
+                    juce::String valStr = laneXml->getStringAttribute("values");
+                    juce::StringArray tokens;
+                    tokens.addTokens(valStr, ",", "");
+                    for (int i = 0; i < maxSteps && i < tokens.size(); ++i)
+                        lanes.values[lane][(size_t)i] = tokens[i].getIntValue();
+                        
+                    stepsFromString(laneXml->getStringAttribute("triggers"), lanes.triggers[lane]);
+                }
+            }
+        };
+        
+        loadTrack(*xmlState, session->tracks[0]);
+        for (auto* trackXml : xmlState->getChildWithTagNameIterator("TRACK"))
+        {
+            const int t = trackXml->getIntAttribute("index", -1);
+            if (t > 0 && t < maxTracks)
+                loadTrack(*trackXml, session->tracks[(size_t)t]);
+        }
+        
+        // Load Banks
+        auto* banksXml = xmlState->getChildByName("BANKS");
+        if (banksXml)
+        {
+            // The XML only names the slots it stores, the others keep their contents
+            decodeAllStoredPatterns();
+            cachedPatternRecords.reset();
+            
+            for (auto* bankXml : banksXml->getChildIterator())
+            {
+                int b = bankXml->getIntAttribute("index");
+                if (b >= 0 && b < 4)
+                {
+                    for (auto* patXml : bankXml->getChildIterator())
+                    {
+                        int s = patXml->getIntAttribute("slot");
+                        if (s >= 0 && s < 16)
+                        {
+                            auto& pat = patternBanks[(size_t)b][(size_t)s];
+                            pat.isEmpty = false;
+                            pat.masterLength = juce::jlimit(1, maxSteps, patXml->getIntAttribute("masterLength", 16));
 
                             pat.shuffleAmount = patXml->getIntAttribute("shuffleAmount", 1);
+                            pat.probabilitySeed = (juce::uint32)patXml->getIntAttribute("probabilitySeed", 1);
+                            pat.randomReseed = patXml->getIntAttribute("randomReseed", 0);
+                            
+                            stepsFromString(patXml->getStringAttribute("masterTriggers"), pat.masterTriggers);
                             
-                            juce::String mTrig = patXml->getStringAttribute("masterTriggers");
-                            for(int i=0; i<16 && i<mTrig.length(); ++i) pat.masterTriggers[(size_t)i] = (mTrig[i] == '1');
+                            pat.chords = chordTableFromVar(juce::JSON::parse(patXml->getStringAttribute("chords")));
                             
                             auto loadPatLane = [&](PatternData::LaneData& ld, juce::String name) {
                                 auto* lXml = patXml->getChildByName(name);
                                 if (lXml) {
                                     ld.midiCC = lXml->getIntAttribute("midiCC", 0);
-                                    ld.valueLoopLength = lXml->getIntAttribute("valueLoopLength", 16);
-                                    ld.triggerLoopLength = lXml->getIntAttribute("triggerLoopLength", 16);
+                                    ld.midiChannel = juce::jlimit(1, 16, lXml->getIntAttribute("midiChannel", 1));
+                                    ld.valueLoopLength = juce::jlimit(1, maxSteps, lXml->getIntAttribute("valueLoopLength", 16));
+                                    ld.triggerLoopLength = juce::jlimit(1, maxSteps, lXml->getIntAttribute("triggerLoopLength", 16));
                                     ld.valueResetInterval = lXml->getIntAttribute("valueResetInterval", 0);
                                     ld.triggerResetInterval = lXml->getIntAttribute("triggerResetInterval", 0);
                                     ld.randomRange = lXml->getIntAttribute("randomRange", 0);
+                                    ld.randomSeed = (juce::uint32)lXml->getIntAttribute("randomSeed", (int)LaneBank::defaultRandomSeed);
                                     ld.enableMasterSource = lXml->getBoolAttribute("enableMasterSource", false);
                                     ld.enableLocalSource = lXml->getBoolAttribute("enableLocalSource", true);
                                     ld.valueDirection = lXml->getIntAttribute("valueDirection", 0);
@@ -1204,362 +1701,1524 @@ void ShequencerAudioProcessor::setStateInformation (const void* data, int sizeIn
                                     
                                     juce::String vStr = lXml->getStringAttribute("values");
                                     juce::StringArray toks; toks.addTokens(vStr, ",", "");
-                                    for(int i=0; i<16 && i<toks.size(); ++i) ld.values[(size_t)i] = toks[i].getIntValue();
+                                    for(int i=0; i<maxSteps && i<toks.size(); ++i) ld.values[(size_t)i] = toks[i].getIntValue();
                                     
-                                    juce::String tStr = lXml->getStringAttribute("triggers");
-                                    for(int i=0; i<16 && i<tStr.length(); ++i) ld.triggers[(size_t)i] = (tStr[i] == '1');
+                                    stepsFromString(lXml->getStringAttribute("triggers"), ld.triggers);
                                 }
                             };
                             
-                            loadPatLane(pat.noteLane, "NOTE_LANE");
-                            loadPatLane(pat.octaveLane, "OCTAVE_LANE");
-                            loadPatLane(pat.velocityLane, "VELOCITY_LANE");
-                            loadPatLane(pat.lengthLane, "LENGTH_LANE");
-                            
-                            loadPatLane(pat.ccLane1, "CC_LANE_1");
-                            loadPatLane(pat.ccLane2, "CC_LANE_2");
-                            loadPatLane(pat.ccLane3, "CC_LANE_3");
-                            loadPatLane(pat.ccLane4, "CC_LANE_4");
+                            for (size_t i = 0; i < (size_t)numLanes; ++i)
+                            {
+                                auto ld = pat.getLane(i);
+                                loadPatLane(ld, getLaneTagName(i));
+                                pat.setLane(i, ld);
+                            }
                         }
                     }
                 }
             }
+            
+            publishPatternBanks();
+        }
+        
+        restoreSession(std::move(session));
+    }
+}
+
+void ShequencerAudioProcessor::savePattern(int bank, int slot)
+{
+    if (bank < 0 || bank >= 4 || slot < 0 || slot >= 16) return;
+    
+    const juce::ScopedLock sl(patternLock);
+    
+    syncEditedTracks();
+    decodeStoredPattern(bank, slot);
+    cachedPatternRecords.reset((size_t)(bank * 16 + slot));
+    auto& pat = patternBanks[(size_t)bank][(size_t)slot];
+    const auto& track = getEditedTrack();
+    
+    // The lanes were written against the loaded pattern's chords, so those travel with them
+    if (track.loadedBank >= 0 && track.loadedSlot >= 0)
+    {
+        decodeStoredPattern(track.loadedBank, track.loadedSlot);
+        pat.chords = patternBanks[(size_t)track.loadedBank][(size_t)track.loadedSlot].chords;
+    }
+    
+    sendLaneEdit(LaneEditCommand::Type::SetLoadedPattern, 0, bank * 16 + slot);
+    
+    pat.isEmpty = false;
+    
+    pat.shuffleAmount = shuffleAmount;
+    storeTrack(track, pat);
+    
+    publishPatternBanks();
+}
+
+void ShequencerAudioProcessor::loadPattern(int bank, int slot)
+{
+    loadPattern(bank, slot, editedTrack);
+}
+
+void ShequencerAudioProcessor::loadPattern(int bank, int slot, int track)
+{
+    if (bank < 0 || bank >= 4 || slot < 0 || slot >= 16 || track < 0 || track >= maxTracks) return;
+    pendingPatternLoads[(size_t)track] = bank * 16 + slot;
+}
+
+void ShequencerAudioProcessor::publishPatternBanks()
+{
+    // Reclaim whatever the audio thread has handed back since the last publish
+    freeRetiredPatterns();
+    
+    auto snapshot = std::make_unique<PatternBankSnapshot>();
+    snapshot->banks = patternBanks;
+    snapshot->encoded = encodedPatterns;
+    snapshot->encodedSlots = encodedSlots;
+    
+    // A snapshot still sitting in pendingPatterns was never seen by the audio thread,
+    // so it is safe to delete it here.
+    delete pendingPatterns.exchange(snapshot.release(), std::memory_order_acq_rel);
+}
+
+void ShequencerAudioProcessor::decodeStoredPattern(int bank, int slot)
+{
+    const auto index = (size_t)(bank * 16 + slot);
+    if (!encodedSlots[index]) return;
+    
+    patternBanks[(size_t)bank][(size_t)slot] = decodePatternRecord(*encodedPatterns, bank, slot);
+    encodedSlots.reset(index);
+    
+    // Its record stays good for saving as long as this build writes the same layout
+    if (encodedPatterns->numSteps == maxSteps && encodedPatterns->numLanes == numLanes)
+    {
+        const auto& record = encodedPatterns->slots[(size_t)bank][(size_t)slot];
+        patternRecords[(size_t)bank][(size_t)slot].replaceAll(static_cast<const char*>(encodedPatterns->records.getData()) + record.offset, (size_t)record.size);
+        cachedPatternRecords.set(index);
+    }
+    
+    // The last snapshot holding the records lets go of them once it is retired
+    if (encodedSlots.none())
+        encodedPatterns.reset();
+}
+
+void ShequencerAudioProcessor::decodeAllStoredPatterns()
+{
+    for (int bank = 0; bank < 4; ++bank)
+        for (int slot = 0; slot < 16; ++slot)
+            decodeStoredPattern(bank, slot);
+}
+
+void ShequencerAudioProcessor::freeRetiredPatterns()
+{
+    int start1, size1, start2, size2;
+    retiredPatternsFifo.prepareToRead(retiredPatternsFifo.getNumReady(), start1, size1, start2, size2);
+    
+    for (int i = 0; i < size1; ++i) delete retiredPatterns[(size_t)(start1 + i)];
+    for (int i = 0; i < size2; ++i) delete retiredPatterns[(size_t)(start2 + i)];
+    
+    retiredPatternsFifo.finishedRead(size1 + size2);
+}
+
+void ShequencerAudioProcessor::adoptPendingPatterns()
+{
+    if (pendingPatterns.load(std::memory_order_acquire) == nullptr) return;
+    
+    // Only take the new snapshot if the old one can be handed back, never delete here
+    if (retiredPatternsFifo.getFreeSpace() < 1) return;
+    
+    auto* incoming = pendingPatterns.exchange(nullptr, std::memory_order_acq_rel);
+    if (incoming == nullptr) return;
+    
+    int start1, size1, start2, size2;
+    retiredPatternsFifo.prepareToWrite(1, start1, size1, start2, size2);
+    retiredPatterns[(size_t)start1] = livePatterns.release();
+    retiredPatternsFifo.finishedWrite(1);
+    
+    livePatterns.reset(incoming);
+}
+
+void ShequencerAudioProcessor::applyPendingPatternLoad()
+{
+    // Pick up any edits to the banks first, so a save followed by a load lands in the same block
+    adoptPendingPatterns();
+    
+    for (int t = 0; t < numTracks; ++t)
+    {
+        if (pendingPatternLoads[(size_t)t].load() == -1) continue;
+        
+        const int load = pendingPatternLoads[(size_t)t].exchange(-1);
+        const int bank = load / 16;
+        const int slot = load % 16;
+        if (load < 0 || bank >= 4) continue;
+        
+        auto& live = *livePatterns;
+        if (live.encodedSlots[(size_t)load])
+        {
+            live.banks[(size_t)bank][(size_t)slot] = decodePatternRecord(*live.encoded, bank, slot);
+            live.encodedSlots.reset((size_t)load);
+        }
+        
+        const auto& pat = live.banks[(size_t)bank][(size_t)slot];
+        if (pat.isEmpty) continue;
+        
+        auto& track = tracks[(size_t)t];
+        track.loadedBank = bank;
+        track.loadedSlot = slot;
+        
+        if (!isShuffleGlobal) shuffleAmount = pat.shuffleAmount;
+        recallTrack(pat, track);
+        forgetSeekCheckpoints(t);
+        
+        // Tell the edited copy, which loads the same pattern on its next sync
+        auto& applied = appliedPatternLoads[(size_t)t];
+        applied.store((((applied.load(std::memory_order_relaxed) >> 8) + 1) << 8) | (juce::uint32)load, std::memory_order_release);
+        
+        // Reset Playheads on Pattern Load
+        track.lanes.resetAll();
+        reseedRandomStreams(track);
+    }
+}
+
+void ShequencerAudioProcessor::clearPattern(int bank, int slot)
+{
+    if (bank < 0 || bank >= 4 || slot < 0 || slot >= 16) return;
+    
+    const juce::ScopedLock sl(patternLock);
+    
+    encodedSlots.reset((size_t)(bank * 16 + slot));
+    cachedPatternRecords.reset((size_t)(bank * 16 + slot));
+    patternBanks[(size_t)bank][(size_t)slot].isEmpty = true;
+    patternBanks[(size_t)bank][(size_t)slot].masterProbEnabled.reset();
+    patternBanks[(size_t)bank][(size_t)slot].masterProbability = 100;
+    patternBanks[(size_t)bank][(size_t)slot].chords = {};
+    
+    publishPatternBanks();
+}
+
+bool ShequencerAudioProcessor::loadChordSet(int bank, int slot, const juce::File& file)
+{
+    if (bank < 0 || bank >= 4 || slot < 0 || slot >= 16) return false;
+    
+    juce::var root = juce::JSON::parse(file);
+    auto chords = chordTableFromVar(root.isArray() ? root : root.getProperty("chords", juce::var()));
+    
+    const juce::ScopedLock sl(patternLock);
+    
+    decodeStoredPattern(bank, slot);
+    auto& pat = patternBanks[(size_t)bank][(size_t)slot];
+    if (pat.isEmpty) return false;
+    
+    pat.chords = chords;
+    cachedPatternRecords.reset((size_t)(bank * 16 + slot));
+    publishPatternBanks();
+    return true;
+}
+
+const ChordTable& ShequencerAudioProcessor::getLoadedChordTable()
+{
+    const auto& playback = getEditedTrackState();
+    
+    const juce::ScopedLock sl(patternLock);
+    if (playback.loadedBank >= 0 && playback.loadedBank < 4 && playback.loadedSlot >= 0 && playback.loadedSlot < 16)
+        decodeStoredPattern(playback.loadedBank, playback.loadedSlot);
+    return chordTableFor(patternBanks, playback.loadedBank, playback.loadedSlot);
+}
+
+const ChordTable& ShequencerAudioProcessor::getLiveChordTable(const SequencerTrack& track) const
+{
+    return chordTableFor(livePatterns->banks, track.loadedBank, track.loadedSlot);
+}
+
+// Pattern Bank Files
+// { "banks": [ { "index": 0, "patterns": [ { "slot": 0, "masterLength": 16, ..., "chords": [...],
+// "NOTE_LANE": { "midiCC": 0, ..., "values": "60,62,", "triggers": "1001" }, ... } ] } ] }
+// Neither direction builds a var tree: saving streams straight into the file, loading pulls the
+// document apart token by token into a staging bank.
+using PatternBankArray = decltype(PatternBankSnapshot::banks);
+
+// Writes indented JSON to a stream as it goes
+class JsonStreamWriter
+{
+public:
+    explicit JsonStreamWriter(juce::OutputStream& stream) : out(stream) {}
+    
+    // A null key for array elements and the root
+    void beginObject(const char* key = nullptr) { beginValue(key); open('{'); }
+    void endObject() { close('}'); }
+    void beginArray(const char* key = nullptr) { beginValue(key); open('['); }
+    void endArray() { close(']'); }
+    
+    void write(const char* key, int value) { beginValue(key); writeNumber(value); }
+    void write(const char* key, bool value) { beginValue(key); out.write(value ? "true" : "false", value ? 4 : 5); }
+    void write(const char* key, const char* text) { beginValue(key); writeString(text); }
+    
+    // Step rows as a "1"/"0" string, step 0 first
+    template <size_t NumSteps>
+    void writeSteps(const char* key, const std::bitset<NumSteps>& steps)
+    {
+        beginValue(key);
+        out.writeByte('"');
+        for (size_t i = 0; i < NumSteps; ++i) out.writeByte(steps[i] ? '1' : '0');
+        out.writeByte('"');
+    }
+    
+    // Numbers as a "v,v,v," string
+    template <typename GetNumber>
+    void writeNumberList(const char* key, int numValues, GetNumber&& getNumber)
+    {
+        beginValue(key);
+        out.writeByte('"');
+        for (int i = 0; i < numValues; ++i)
+        {
+            writeNumber(getNumber(i));
+            out.writeByte(',');
+        }
+        out.writeByte('"');
+    }
+    
+    // Numbers as an array on one line
+    template <typename GetNumber>
+    void writeNumberArray(const char* key, int numValues, GetNumber&& getNumber)
+    {
+        beginValue(key);
+        out.writeByte('[');
+        for (int i = 0; i < numValues; ++i)
+        {
+            if (i > 0) out.write(", ", 2);
+            writeNumber(getNumber(i));
+        }
+        out.writeByte(']');
+    }
+    
+private:
+    static constexpr int maxDepth = 8;
+    
+    juce::OutputStream& out;
+    std::array<bool, maxDepth + 1> isFirst {};
+    int depth = 0;
+    
+    void beginValue(const char* key)
+    {
+        if (depth > 0)
+        {
+            if (!isFirst[(size_t)depth]) out.writeByte(',');
+            isFirst[(size_t)depth] = false;
+            newLine();
+        }
+        
+        if (key != nullptr)
+        {
+            writeString(key);
+            out.write(": ", 2);
+        }
+    }
+    
+    void open(char bracket)
+    {
+        jassert(depth < maxDepth);
+        out.writeByte(bracket);
+        isFirst[(size_t)++depth] = true;
+    }
+    
+    void close(char bracket)
+    {
+        const bool isEmpty = isFirst[(size_t)depth--];
+        if (!isEmpty) newLine();
+        out.writeByte(bracket);
+        if (depth == 0) out.writeByte('\n');
+    }
+    
+    void newLine()
+    {
+        out.writeByte('\n');
+        out.writeRepeatedByte(' ', (size_t)depth * 2);
+    }
+    
+    void writeNumber(int value)
+    {
+        char text[12];
+        char* start = text + sizeof(text);
+        auto magnitude = value < 0 ? (juce::uint32)0 - (juce::uint32)value : (juce::uint32)value;
+        do { *--start = (char)('0' + magnitude % 10); magnitude /= 10; } while (magnitude != 0);
+        if (value < 0) *--start = '-';
+        out.write(start, (size_t)(text + sizeof(text) - start));
+    }
+    
+    void writeString(const char* text)
+    {
+        static const char hexDigits[] = "0123456789abcdef";
+        
+        out.writeByte('"');
+        for (const char* c = text; *c != 0; ++c)
+        {
+            const auto byte = (juce::uint8)*c;
+            if (byte == '"' || byte == '\\')
+            {
+                out.writeByte('\\');
+                out.writeByte(*c);
+            }
+            else if (byte < 0x20)
+            {
+                const char escaped[] { '\\', 'u', '0', '0', hexDigits[byte >> 4], hexDigits[byte & 15] };
+                out.write(escaped, sizeof(escaped));
+            }
+            else
+            {
+                out.writeByte(*c); // UTF-8 passes through
+            }
         }
+        out.writeByte('"');
     }
+};
+
+// Pulls a JSON document apart token by token. Strings are unescaped in place, into the
+// null terminated buffer they were read from, so reading allocates nothing and a string
+// stays valid as long as the buffer. Walk it with
+//     if (reader.beginObject()) while (reader.nextMember(key)) { read or skip one value }
+// Reading a value of some other type skips it and gives a default, as juce::var would convert
+// it. A syntax error fails the whole read: every later call gives nothing.
+class JsonPullReader
+{
+public:
+    explicit JsonPullReader(char* text) : pos(text) {}
+    
+    bool failed() const { return error; }
+    
+    bool beginObject() { return begin('{'); }
+    bool beginArray() { return begin('['); }
+    
+    // False at the closing brace, with the object done
+    bool nextMember(const char*& key)
+    {
+        if (!next('}')) return false;
+        
+        key = readRawString();
+        if (peek() != ':') return fail();
+        ++pos;
+        return !error;
+    }
+    
+    // False at the closing bracket, with the array done
+    bool nextElement() { return next(']'); }
+    
+    const char* readString()
+    {
+        if (peek() == '"') return readRawString();
+        skipValue();
+        return "";
+    }
+    
+    juce::int64 readInt()
+    {
+        switch (peek())
+        {
+            case '"': return std::strtoll(readRawString(), nullptr, 10);
+            case 't': return readLiteral("true") ? 1 : 0;
+            case 'f': readLiteral("false"); return 0;
+            case 'n': readLiteral("null"); return 0;
+            case '{': case '[': skipValue(); return 0;
+            default: break;
+        }
+        
+        const auto number = readNumber();
+        return number.isInteger ? number.integer : (juce::int64)juce::jlimit(-9.0e18, 9.0e18, number.real);
+    }
+    
+    bool readBool()
+    {
+        switch (peek())
+        {
+            case 't': return readLiteral("true");
+            case '"':
+            {
+                const char* text = readRawString();
+                return std::strtoll(text, nullptr, 10) != 0 || juce::String(juce::CharPointer_UTF8(text)).trim().equalsIgnoreCase("true");
+            }
+            case 'f': case 'n': case '{': case '[': return readInt() != 0;
+            default: break;
+        }
+        
+        const auto number = readNumber();
+        return number.isInteger ? number.integer != 0 : !juce::exactlyEqual(number.real, 0.0);
+    }
+    
+    void skipValue()
+    {
+        const char* key;
+        switch (peek())
+        {
+            case '{': if (beginObject()) while (nextMember(key)) skipValue(); break;
+            case '[': if (beginArray()) while (nextElement()) skipValue(); break;
+            case '"': readRawString(); break;
+            case 't': readLiteral("true"); break;
+            case 'f': readLiteral("false"); break;
+            case 'n': readLiteral("null"); break;
+            default: readNumber(); break;
+        }
+    }
+    
+private:
+    static constexpr int maxDepth = 64;
+    
+    struct Number
+    {
+        juce::int64 integer = 0;
+        double real = 0.0;
+        bool isInteger = true;
+    };
+    
+    char* pos;
+    bool error = false;
+    std::array<bool, maxDepth + 1> isFirst {};
+    int depth = 0;
+    
+    bool fail()
+    {
+        error = true;
+        return false;
+    }
+    
+    char peek()
+    {
+        if (error) return 0;
+        while (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r') ++pos;
+        return *pos;
+    }
+    
+    bool begin(char bracket)
+    {
+        if (peek() != bracket)
+        {
+            skipValue();
+            return false;
+        }
+        
+        if (depth == maxDepth) return fail();
+        ++pos;
+        isFirst[(size_t)++depth] = true;
+        return true;
+    }
+    
+    bool next(char closingBracket)
+    {
+        const char c = peek();
+        if (c == 0) return fail();
+        
+        if (c == closingBracket)
+        {
+            ++pos;
+            --depth;
+            return false;
+        }
+        
+        if (!isFirst[(size_t)depth])
+        {
+            if (c != ',') return fail();
+            ++pos;
+        }
+        isFirst[(size_t)depth] = false;
+        return true;
+    }
+    
+    bool readLiteral(const char* literal)
+    {
+        const auto length = std::strlen(literal);
+        if (std::strncmp(pos, literal, length) != 0) return fail();
+        pos += length;
+        return true;
+    }
+    
+    // Integers are read exactly, anything with a fraction or an exponent as a double
+    Number readNumber()
+    {
+        Number number;
+        if (peek() != '-' && (*pos < '0' || *pos > '9'))
+        {
+            fail();
+            return number;
+        }
+        
+        char* end = nullptr;
+        number.integer = std::strtoll(pos, &end, 10);
+        if (*end == '.' || *end == 'e' || *end == 'E')
+        {
+            number.real = std::strtod(pos, &end);
+            number.isInteger = false;
+        }
+        
+        if (end == pos) fail();
+        pos = end;
+        return number;
+    }
+    
+    static int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+    
+    bool readHex4(juce::uint32& value)
+    {
+        value = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            const int digit = hexValue(pos[i]);
+            if (digit < 0) return fail();
+            value = (value << 4) | (juce::uint32)digit;
+        }
+        pos += 4;
+        return true;
+    }
+    
+    // Unescaping never lengthens a string, so it is written over itself
+    const char* readRawString()
+    {
+        if (peek() != '"')
+        {
+            fail();
+            return "";
+        }
+        
+        char* text = ++pos;
+        char* dest = text;
+        
+        for (;;)
+        {
+            const char c = *pos++;
+            if (c == 0) { --pos; fail(); return ""; }
+            if (c == '"') break;
+            if (c != '\\') { *dest++ = c; continue; }
+            
+            switch (*pos++)
+            {
+                case '"': *dest++ = '"'; break;
+                case '\\': *dest++ = '\\'; break;
+                case '/': *dest++ = '/'; break;
+                case 'b': *dest++ = '\b'; break;
+                case 'f': *dest++ = '\f'; break;
+                case 'n': *dest++ = '\n'; break;
+                case 'r': *dest++ = '\r'; break;
+                case 't': *dest++ = '\t'; break;
+                case 'u':
+                {
+                    juce::uint32 codePoint;
+                    if (!readHex4(codePoint)) return "";
+                    
+                    // A surrogate pair is one code point; an unpaired half is kept as it is
+                    char* afterFirst = pos;
+                    juce::uint32 low;
+                    if (codePoint >= 0xd800 && codePoint < 0xdc00 && pos[0] == '\\' && pos[1] == 'u')
+                    {
+                        pos += 2;
+                        if (!readHex4(low)) return "";
+                        
+                        if (low >= 0xdc00 && low < 0xe000)
+                            codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                        else
+                            pos = afterFirst;
+                    }
+                    
+                    dest += writeUTF8(dest, codePoint);
+                    break;
+                }
+                default: --pos; fail(); return "";
+            }
+        }
+        
+        *dest = 0;
+        return text;
+    }
+    
+    static int writeUTF8(char* dest, juce::uint32 codePoint)
+    {
+        if (codePoint < 0x80) { dest[0] = (char)codePoint; return 1; }
+        if (codePoint < 0x800)
+        {
+            dest[0] = (char)(0xc0 | (codePoint >> 6));
+            dest[1] = (char)(0x80 | (codePoint & 0x3f));
+            return 2;
+        }
+        if (codePoint < 0x10000)
+        {
+            dest[0] = (char)(0xe0 | (codePoint >> 12));
+            dest[1] = (char)(0x80 | ((codePoint >> 6) & 0x3f));
+            dest[2] = (char)(0x80 | (codePoint & 0x3f));
+            return 3;
+        }
+        dest[0] = (char)(0xf0 | (codePoint >> 18));
+        dest[1] = (char)(0x80 | ((codePoint >> 12) & 0x3f));
+        dest[2] = (char)(0x80 | ((codePoint >> 6) & 0x3f));
+        dest[3] = (char)(0x80 | (codePoint & 0x3f));
+        return 4;
+    }
+};
+
+static void writePatternLane(JsonStreamWriter& json, const PatternData::PackedLane& lane, const char* tag)
+{
+    json.beginObject(tag);
+    json.write("midiCC", (int)lane.midiCC);
+    json.write("midiChannel", lane.getMidiChannel());
+    json.write("valueLoopLength", (int)lane.valueLoopLength);
+    json.write("triggerLoopLength", (int)lane.triggerLoopLength);
+    json.write("valueResetInterval", (int)lane.valueResetInterval);
+    json.write("triggerResetInterval", (int)lane.triggerResetInterval);
+    json.write("randomRange", (int)lane.randomRange);
+    json.write("randomSeed", (int)lane.randomSeed);
+    json.write("enableMasterSource", lane.usesMasterSource());
+    json.write("enableLocalSource", lane.usesLocalSource());
+    json.write("valueDirection", lane.getValueDirection());
+    json.write("triggerDirection", lane.getTriggerDirection());
+    json.write("customColor", (int)lane.customColor);
+    json.write("smoothing", (int)lane.smoothing);
+    json.writeNumberList("values", stepCapacity, [&](int step) { return lane.getValue((size_t)step); });
+    json.writeSteps("triggers", lane.triggers);
+    json.endObject();
+}
+
+static void writePattern(JsonStreamWriter& json, const PatternData& pat, int slot, const juce::StringArray& laneTags)
+{
+    json.beginObject();
+    json.write("slot", slot);
+    json.write("masterLength", pat.masterLength);
+    json.write("shuffleAmount", pat.shuffleAmount);
+    json.write("masterProbability", pat.masterProbability);
+    json.write("masterColor", (int)pat.masterColor);
+    json.write("probabilitySeed", (int)pat.probabilitySeed);
+    json.write("randomReseed", pat.randomReseed);
+    json.writeSteps("masterTriggers", pat.masterTriggers);
+    json.writeSteps("masterProbEnabled", pat.masterProbEnabled);
+    
+    if (!pat.chords.isEmpty())
+    {
+        json.beginArray("chords");
+        for (int c = 1; c <= pat.chords.numChords; ++c)
+        {
+            const auto& chord = pat.chords.chords[(size_t)c];
+            json.beginObject();
+            json.write("name", chord.name.data());
+            json.writeNumberArray("notes", chord.numNotes, [&](int n) { return (int)chord.offsets[(size_t)n]; });
+            json.endObject();
+        }
+        json.endArray();
+    }
+    
+    for (size_t i = 0; i < (size_t)LaneBank::numLanes; ++i)
+        writePatternLane(json, pat.lanes[i], laneTags[(int)i].toRawUTF8());
+    
+    json.endObject();
+}
+
+static void writePatternBankFile(juce::OutputStream& out, const PatternBankArray& banks)
+{
+    juce::StringArray laneTags;
+    for (size_t i = 0; i < (size_t)LaneBank::numLanes; ++i) laneTags.add(getLaneTagName(i));
+    
+    JsonStreamWriter json(out);
+    json.beginObject();
+    json.beginArray("banks");
+    
+    for (int b = 0; b < 4; ++b)
+    {
+        json.beginObject();
+        json.write("index", b);
+        json.beginArray("patterns");
+        
+        for (int s = 0; s < 16; ++s)
+            if (!banks[(size_t)b][(size_t)s].isEmpty)
+                writePattern(json, banks[(size_t)b][(size_t)s], s, laneTags);
+        
+        json.endArray();
+        json.endObject();
+    }
+    
+    json.endArray();
+    json.endObject();
+}
+
+// Read like chordTableFromVar: chords past a full table are dropped
+static ChordTable readChordTable(JsonPullReader& reader)
+{
+    ChordTable table;
+    bool isFull = false;
+    
+    if (reader.beginArray())
+    {
+        while (reader.nextElement())
+        {
+            const char* name = "";
+            std::array<int, ChordTable::maxNotes> offsets {};
+            int numNotes = 0;
+            
+            const char* key;
+            if (reader.beginObject())
+            {
+                while (reader.nextMember(key))
+                {
+                    if (std::strcmp(key, "name") == 0)
+                    {
+                        name = reader.readString();
+                    }
+                    else if (std::strcmp(key, "notes") == 0)
+                    {
+                        numNotes = 0;
+                        if (reader.beginArray())
+                        {
+                            while (reader.nextElement())
+                            {
+                                const int note = (int)reader.readInt();
+                                if (numNotes < ChordTable::maxNotes) offsets[(size_t)numNotes++] = note;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        reader.skipValue();
+                    }
+                }
+            }
+            
+            if (!isFull && !table.add(name, offsets.data(), numNotes))
+                isFull = true;
+        }
+    }
+    return table;
+}
+
+// Settings missing from the object keep the LaneData defaults, steps missing from the
+// value and trigger strings keep their current contents
+static bool readPatternLane(JsonPullReader& reader, PatternData::LaneData& ld)
+{
+    if (!reader.beginObject()) return false;
+    
+    const char* key;
+    while (reader.nextMember(key))
+    {
+        auto is = [key](const char* name) { return std::strcmp(key, name) == 0; };
+        
+        if (is("midiCC")) ld.midiCC = (int)reader.readInt();
+        else if (is("midiChannel")) ld.midiChannel = juce::jlimit(1, 16, (int)reader.readInt());
+        else if (is("valueLoopLength")) ld.valueLoopLength = juce::jlimit(1, stepCapacity, (int)reader.readInt());
+        else if (is("triggerLoopLength")) ld.triggerLoopLength = juce::jlimit(1, stepCapacity, (int)reader.readInt());
+        else if (is("valueResetInterval")) ld.valueResetInterval = (int)reader.readInt();
+        else if (is("triggerResetInterval")) ld.triggerResetInterval = (int)reader.readInt();
+        else if (is("randomRange")) ld.randomRange = (int)reader.readInt();
+        else if (is("randomSeed")) ld.randomSeed = (juce::uint32)(int)reader.readInt();
+        else if (is("enableMasterSource")) ld.enableMasterSource = reader.readBool();
+        else if (is("enableLocalSource")) ld.enableLocalSource = reader.readBool();
+        else if (is("valueDirection")) ld.valueDirection = (int)reader.readInt();
+        else if (is("triggerDirection")) ld.triggerDirection = (int)reader.readInt();
+        else if (is("customColor")) ld.customColor = (juce::uint32)(int)reader.readInt();
+        else if (is("smoothing")) ld.smoothing = (int)reader.readInt();
+        else if (is("triggers")) stepsFromString(reader.readString(), ld.triggers);
+        else if (is("values"))
+        {
+            const char* text = reader.readString();
+            for (size_t step = 0; step < (size_t)stepCapacity && *text != 0; ++step)
+            {
+                ld.values[step] = (int)std::strtol(text, nullptr, 10);
+                text = std::strchr(text, ',');
+                if (text == nullptr) break;
+                ++text;
+            }
+        }
+        else reader.skipValue();
+    }
+    return true;
+}
+
+// Returns the pattern's slot, -1 if it names none
+static int readPattern(JsonPullReader& reader, PatternData& pat)
+{
+    int slot = -1;
+    if (!reader.beginObject()) return slot;
+    
+    const char* key;
+    while (reader.nextMember(key))
+    {
+        auto is = [key](const char* name) { return std::strcmp(key, name) == 0; };
+        
+        if (is("slot")) slot = (int)reader.readInt();
+        else if (is("masterLength")) pat.masterLength = juce::jlimit(1, stepCapacity, (int)reader.readInt());
+        else if (is("shuffleAmount")) pat.shuffleAmount = (int)reader.readInt();
+        else if (is("masterProbability")) pat.masterProbability = (int)reader.readInt();
+        else if (is("masterColor")) pat.masterColor = (juce::uint32)(int)reader.readInt();
+        else if (is("probabilitySeed")) pat.probabilitySeed = (juce::uint32)(int)reader.readInt();
+        else if (is("randomReseed")) pat.randomReseed = (int)reader.readInt();
+        else if (is("masterTriggers")) stepsFromString(reader.readString(), pat.masterTriggers);
+        else if (is("masterProbEnabled")) stepsFromString(reader.readString(), pat.masterProbEnabled);
+        else if (is("chords")) pat.chords = readChordTable(reader);
+        else
+        {
+            const int lane = findLaneIndex(key);
+            if (lane < 0)
+            {
+                reader.skipValue();
+                continue;
+            }
+            
+            auto ld = pat.getLane((size_t)lane);
+            if (readPatternLane(reader, ld))
+                pat.setLane((size_t)lane, ld);
+        }
+    }
+    return slot;
+}
+
+// The bank index may come after its patterns, so they wait in bankPatterns until the object ends
+static void readPatternBank(JsonPullReader& reader, PatternBankArray& banks, std::array<PatternData, 16>& bankPatterns)
+{
+    if (!reader.beginObject()) return;
+    
+    int index = -1;
+    std::bitset<16> slotsRead;
+    
+    const char* key;
+    while (reader.nextMember(key))
+    {
+        if (std::strcmp(key, "index") == 0)
+        {
+            index = (int)reader.readInt();
+        }
+        else if (std::strcmp(key, "patterns") == 0)
+        {
+            if (!reader.beginArray()) continue;
+            
+            while (reader.nextElement())
+            {
+                PatternData pat;
+                pat.isEmpty = false;
+                const int slot = readPattern(reader, pat);
+                if (slot < 0 || slot >= 16) continue;
+                
+                bankPatterns[(size_t)slot] = pat;
+                slotsRead.set((size_t)slot);
+            }
+        }
+        else
+        {
+            reader.skipValue();
+        }
+    }
+    
+    if (index < 0 || index >= 4) return;
+    for (size_t s = 0; s < 16; ++s)
+        if (slotsRead[s])
+            banks[(size_t)index][s] = bankPatterns[s];
+}
+
+// Decodes into banks, which start out empty. False if the file is not a JSON object.
+static bool readPatternBankFile(char* text, PatternBankArray& banks)
+{
+    if (std::strncmp(text, "\xef\xbb\xbf", 3) == 0) text += 3; // UTF-8 byte order mark
+    
+    JsonPullReader reader(text);
+    if (!reader.beginObject()) return false;
+    
+    auto bankPatterns = std::make_unique<std::array<PatternData, 16>>();
+    
+    const char* key;
+    while (reader.nextMember(key))
+    {
+        if (std::strcmp(key, "banks") != 0)
+        {
+            reader.skipValue();
+            continue;
+        }
+        
+        if (reader.beginArray())
+            while (reader.nextElement())
+                readPatternBank(reader, banks, *bankPatterns);
+    }
+    
+    return !reader.failed();
+}
+
+void ShequencerAudioProcessor::saveAllPatternsToJson(const juce::File& file)
+{
+    // Only the copy is made under the lock; encoded slots are decoded into it afterwards
+    auto banks = std::make_unique<PatternBankArray>();
+    std::shared_ptr<const EncodedPatterns> encoded;
+    std::bitset<64> encodedInCopy;
+    {
+        const juce::ScopedLock sl(patternLock);
+        *banks = patternBanks;
+        encoded = encodedPatterns;
+        encodedInCopy = encodedSlots;
+    }
+    
+    for (int b = 0; b < 4; ++b)
+        for (int s = 0; s < 16; ++s)
+            if (encodedInCopy[(size_t)(b * 16 + s)])
+                (*banks)[(size_t)b][(size_t)s] = decodePatternRecord(*encoded, b, s);
+    
+    // Written next to the file and moved over it once complete
+    juce::TemporaryFile temp(file);
+    {
+        juce::FileOutputStream out(temp.getFile());
+        if (!out.openedOk()) return;
+        
+        writePatternBankFile(out, *banks);
+        out.flush();
+        if (out.getStatus().failed()) return;
+    }
+    temp.overwriteTargetFileWithTemporary();
+}
+
+void ShequencerAudioProcessor::loadAllPatternsFromJson(const juce::File& file)
+{
+    juce::MemoryBlock text;
+    if (!file.loadFileAsData(text)) return;
+    text.append("", 1); // The reader works on a null terminated buffer
+    
+    // Decoded without the lock into a staging bank, which replaces every stored pattern at
+    // once. A file that fails to parse leaves them alone.
+    auto staging = std::make_unique<PatternBankArray>();
+    if (!readPatternBankFile(static_cast<char*>(text.getData()), *staging)) return;
+    
+    const juce::ScopedLock sl(patternLock);
+    
+    patternBanks = *staging;
+    encodedSlots.reset();
+    encodedPatterns.reset();
+    cachedPatternRecords.reset();
+    
+    publishPatternBanks();
+}
+
+juce::uint32 ShequencerAudioProcessor::sendLaneEdit(const LaneEditCommand& command)
+{
+    const juce::ScopedLock sl(patternLock);
+    
+    // The edited copy takes the edit at once, against the pattern the editor was showing
+    applyEditedLaneEdit(command);
+    
+    LaneEditCommand queued = command;
+    if (command.track >= 0 && command.track < maxTracks)
+        queued.patternLoads = edited.patternLoads[(size_t)command.track];
+    
+    // Behind any edits still waiting for room, so the audio thread takes them in order
+    queuePendingLaneEdits();
+    if (!pendingLaneEdits.empty() || !writeLaneEdit(queued))
+        pendingLaneEdits.push_back(queued);
+    
+    if (++laneEditsSent == 0) ++laneEditsSent; // 0 is reserved for "no edit"
+    juce::uint32 ticket = laneEditsSent;
+    
+    // Without a running audio thread nobody else will drain the queue, so apply it here
+    if (!isAudioThreadActive.load())
+    {
+        applyAllLaneEdits();
+        publishPlaybackState();
+    }
+    
+    return ticket;
+}
+
+bool ShequencerAudioProcessor::writeLaneEdit(const LaneEditCommand& command)
+{
+    int start1, size1, start2, size2;
+    laneEditFifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 + size2 < 1) return false;
+    
+    laneEditQueue[(size_t)(size1 > 0 ? start1 : start2)] = command;
+    laneEditFifo.finishedWrite(1);
+    return true;
+}
+
+void ShequencerAudioProcessor::queuePendingLaneEdits()
+{
+    size_t numQueued = 0;
+    while (numQueued < pendingLaneEdits.size() && writeLaneEdit(pendingLaneEdits[numQueued]))
+        ++numQueued;
+    
+    pendingLaneEdits.erase(pendingLaneEdits.begin(), pendingLaneEdits.begin() + (std::ptrdiff_t)numQueued);
+}
+
+void ShequencerAudioProcessor::applyAllLaneEdits()
+{
+    applyLaneEdits();
+    while (!pendingLaneEdits.empty())
+    {
+        queuePendingLaneEdits();
+        applyLaneEdits();
+    }
+}
+
+juce::uint32 ShequencerAudioProcessor::sendLaneEdit(LaneEditCommand::Type type, int lane, int value)
+{
+    LaneEditCommand command;
+    command.type = type;
+    command.track = editedTrack;
+    command.lane = lane;
+    command.value = value;
+    return sendLaneEdit(command);
+}
+
+const ShequencerAudioProcessor::PlaybackState& ShequencerAudioProcessor::getPlaybackState()
+{
+    // Only swap when the producer has published something newer, otherwise keep our buffer
+    if (playbackMiddleIndex.load(std::memory_order_relaxed) & playbackFreshBit)
+        playbackReadIndex = playbackMiddleIndex.exchange(playbackReadIndex, std::memory_order_acq_rel) & 3;
+    
+    return playbackStates[(size_t)playbackReadIndex];
 }
 
-void ShequencerAudioProcessor::savePattern(int bank, int slot)
+void ShequencerAudioProcessor::publishPlaybackState()
 {
-    if (bank < 0 || bank >= 4 || slot < 0 || slot >= 16) return;
+    auto& state = playbackStates[(size_t)playbackWriteIndex];
     
-    const juce::ScopedLock sl(patternLock);
+    state.version = ++playbackVersion;
+    state.numTracks = numTracks;
     
-    loadedBank = bank;
-    loadedSlot = slot;
+    for (size_t t = 0; t < (size_t)numTracks; ++t)
+    {
+        const auto& track = tracks[t];
+        auto& trackState = state.tracks[t];
+        trackState.currentMasterStep = track.currentMasterStep;
+        trackState.loadedBank = track.loadedBank;
+        trackState.loadedSlot = track.loadedSlot;
+        trackState.numCCLanes = track.getNumCCLanes();
+        
+        trackState.activeValueStep = track.lanes.activeValueStep;
+        trackState.activeTriggerStep = track.lanes.activeTriggerStep;
+    }
     
-    auto& pat = patternBanks[(size_t)bank][(size_t)slot];
-    pat.isEmpty = false;
+    playbackWriteIndex = playbackMiddleIndex.exchange(playbackWriteIndex | playbackFreshBit, std::memory_order_acq_rel) & 3;
+}
+
+bool ShequencerAudioProcessor::isLaneEditApplied(juce::uint32 ticket) const
+{
+    if (ticket == 0) return true;
+    return (juce::int32)(laneEditsApplied.load(std::memory_order_acquire) - ticket) >= 0;
+}
+
+int ShequencerAudioProcessor::getVisibleStepCount() const
+{
+    const auto& track = getEditedTrack();
+    const auto& lanes = track.lanes;
     
-    pat.masterLength = masterLength;
-    pat.shuffleAmount = shuffleAmount;
-    pat.masterProbability = masterProbability;
-    pat.masterTriggers = masterTriggers;
-    pat.masterProbEnabled = masterProbEnabled;
-    pat.masterColor = masterColor.getARGB();
-    
-    auto copyLane = [](const SequencerLane& src, PatternData::LaneData& dst) {
-        dst.midiCC = src.midiCC;
-        dst.values = src.values;
-        dst.triggers = src.triggers;
-        dst.valueLoopLength = src.valueLoopLength;
-        dst.triggerLoopLength = src.triggerLoopLength;
-        dst.valueResetInterval = src.valueResetInterval;
-        dst.triggerResetInterval = src.triggerResetInterval;
-        dst.randomRange = src.randomRange;
-        dst.enableMasterSource = src.enableMasterSource;
-        dst.enableLocalSource = src.enableLocalSource;
-        dst.valueDirection = (int)src.valueDirection;
-        dst.triggerDirection = (int)src.triggerDirection;
-        dst.customColor = src.customColor.getARGB();
-        dst.smoothing = src.smoothing;
-    };
+    int longest = track.masterLength;
+    for (size_t l = 0; l < (size_t)lanes.numActiveLanes; ++l)
+        longest = juce::jmax(longest, lanes.valueLoopLength[l], lanes.triggerLoopLength[l]);
+    
+    return juce::jlimit(16, maxSteps, (longest + 15) / 16 * 16);
+}
+
+void ShequencerAudioProcessor::applyLaneEdits()
+{
+    int start1, size1, start2, size2;
+    laneEditFifo.prepareToRead(laneEditFifo.getNumReady(), start1, size1, start2, size2);
     
-    copyLane(noteLane, pat.noteLane);
-    copyLane(octaveLane, pat.octaveLane);
-    copyLane(velocityLane, pat.velocityLane);
-    copyLane(lengthLane, pat.lengthLane);
+    for (int i = 0; i < size1; ++i) applyLaneEdit(laneEditQueue[(size_t)(start1 + i)]);
+    for (int i = 0; i < size2; ++i) applyLaneEdit(laneEditQueue[(size_t)(start2 + i)]);
     
-    copyLane(ccLane1, pat.ccLane1);
-    copyLane(ccLane2, pat.ccLane2);
-    copyLane(ccLane3, pat.ccLane3);
-    copyLane(ccLane4, pat.ccLane4);
+    int numApplied = size1 + size2;
+    laneEditFifo.finishedRead(numApplied);
+    
+    if (numApplied > 0)
+    {
+        // Keep the counter in step with the ticket numbering, which skips 0
+        juce::uint32 applied = laneEditsApplied.load(std::memory_order_relaxed);
+        for (int i = 0; i < numApplied; ++i)
+            if (++applied == 0) ++applied;
+        laneEditsApplied.store(applied, std::memory_order_release);
+    }
 }
 
-void ShequencerAudioProcessor::loadPattern(int bank, int slot)
+// Edits that change what a stored pattern holds, as opposed to playheads and global settings
+static bool isPatternEdit(LaneEditCommand::Type type)
 {
-    if (bank < 0 || bank >= 4 || slot < 0 || slot >= 16) return;
-    pendingLoadBank = bank;
-    pendingLoadSlot = slot;
+    using Type = LaneEditCommand::Type;
+    switch (type)
+    {
+        case Type::SetValueIndex: case Type::SetTriggerIndex: case Type::SyncLaneToBar:
+        case Type::SetGlobalStepIndex: case Type::SetMidiGateMode: case Type::SetMaxPolyphony:
+        case Type::SetVoiceStealMode: case Type::SetNumCCLanes: case Type::SetNumTracks:
+        case Type::RestoreSession:
+            return false;
+        case Type::SetValues: case Type::SetTriggers: case Type::SetValueLoopLength:
+        case Type::SetTriggerLoopLength: case Type::SetValueDirection: case Type::SetTriggerDirection:
+        case Type::SetValueResetInterval: case Type::SetTriggerResetInterval: case Type::SetRandomRange:
+        case Type::SetEnableMasterSource: case Type::SetEnableLocalSource: case Type::SetMidiCC:
+        case Type::SetMidiChannel: case Type::SetSmoothing: case Type::SetRandomSeed:
+        case Type::ShiftValues: case Type::ShiftTriggers: case Type::ResetLane:
+        case Type::SetCustomColor: case Type::SetMasterSteps: case Type::SetMasterLength:
+        case Type::SetMasterProbability: case Type::ShiftMasterTriggers: case Type::ClearMasterTriggers:
+        case Type::SetLoadedPattern: case Type::SetProbabilitySeed: case Type::SetRandomReseed:
+        case Type::SetMasterColor: case Type::ResetAllLanes:
+            return true;
+    }
+    return false;
 }
 
-void ShequencerAudioProcessor::applyPendingPatternLoad()
+static void resetLanePattern(LaneBank& lanes, int lane, int defaultValue)
+{
+    const auto i = (size_t)lane;
+    lanes.values[i].fill(defaultValue);
+    lanes.triggers[i].set();
+    lanes.valueLoopLength[i] = 16;
+    lanes.triggerLoopLength[i] = 16;
+    lanes.valueResetInterval[i] = 0;
+    lanes.triggerResetInterval[i] = 0;
+    lanes.valueDirection[i] = LaneDirection::Forward;
+    lanes.triggerDirection[i] = LaneDirection::Forward;
+}
+
+// The pattern part of an edit. The audio thread's track and the edited copy both take it, so
+// the two only ever differ in playback state.
+static void applyPatternEdit(SequencerTrack& track, const LaneEditCommand& command)
 {
-    int slot = pendingLoadSlot.load();
-    int bank = pendingLoadBank.load();
+    using Type = LaneEditCommand::Type;
+    auto& lanes = track.lanes;
     
-    if (slot == -1 || bank == -1) return;
+    const bool isLaneEdit = command.type < Type::SetMasterSteps;
+    if (isLaneEdit && (command.lane < 0 || command.lane >= LaneBank::numLanes)) return;
+    const int lane = command.lane;
+    const auto i = (size_t)lane;
     
-    // Try to get lock - if failed (e.g. UI saving), skip this block
-    if (patternLock.tryEnter())
+    switch (command.type)
     {
-        if (bank >= 0 && bank < 4 && slot >= 0 && slot < 16)
-        {
-            const auto& pat = patternBanks[(size_t)bank][(size_t)slot];
-            if (!pat.isEmpty)
+        case Type::SetValues:
+            lanes.values[i] = command.steps;
+            break;
+        case Type::SetTriggers:
+            for (size_t step = 0; step < (size_t)LaneBank::maxSteps; ++step) lanes.triggers[i][step] = (command.steps[step] != 0);
+            break;
+        case Type::SetValueLoopLength:
+            lanes.valueLoopLength[i] = juce::jlimit(1, LaneBank::maxSteps, command.value);
+            break;
+        case Type::SetTriggerLoopLength:
+            lanes.triggerLoopLength[i] = juce::jlimit(1, LaneBank::maxSteps, command.value);
+            break;
+        case Type::SetValueDirection:
+            lanes.valueDirection[i] = (LaneDirection)juce::jlimit(0, 5, command.value);
+            break;
+        case Type::SetTriggerDirection:
+            lanes.triggerDirection[i] = (LaneDirection)juce::jlimit(0, 5, command.value);
+            break;
+        case Type::SetValueResetInterval: lanes.valueResetInterval[i] = command.value; break;
+        case Type::SetTriggerResetInterval: lanes.triggerResetInterval[i] = command.value; break;
+        case Type::SetRandomRange: lanes.randomRange[i] = command.value; break;
+        case Type::SetEnableMasterSource: lanes.setMasterSource(lane, command.value != 0); break;
+        case Type::SetEnableLocalSource: lanes.setLocalSource(lane, command.value != 0); break;
+        case Type::SetMidiCC: lanes.midiCC[i] = command.value; break;
+        case Type::SetMidiChannel: lanes.midiChannel[i] = juce::jlimit(1, 16, command.value); break;
+        case Type::SetSmoothing: lanes.smoothing[i] = juce::jlimit(0, 100, command.value); break;
+        case Type::SetRandomSeed: lanes.randomSeed[i] = (juce::uint32)command.value; break;
+        case Type::ShiftValues: lanes.shiftValues(lane, command.value); break;
+        case Type::ShiftTriggers: lanes.shiftTriggers(lane, command.value); break;
+        case Type::ResetLane: resetLanePattern(lanes, lane, command.value); break;
+        case Type::SetCustomColor: lanes.customColor[i] = juce::Colour((juce::uint32)command.value); break;
+        
+        case Type::SetMasterSteps:
+            for (size_t step = 0; step < (size_t)LaneBank::maxSteps; ++step)
             {
-                loadedBank = bank;
-                loadedSlot = slot;
-                
-                masterLength = pat.masterLength;
-                if (!isShuffleGlobal) shuffleAmount = pat.shuffleAmount;
-                masterProbability = pat.masterProbability;
-                masterTriggers = pat.masterTriggers;
-                masterProbEnabled = pat.masterProbEnabled;
-                masterColor = juce::Colour(pat.masterColor);
-                
-                auto loadLane = [](SequencerLane& dst, const PatternData::LaneData& src) {
-                    dst.midiCC = src.midiCC;
-                    dst.values = src.values;
-                    dst.triggers = src.triggers;
-                    dst.valueLoopLength = src.valueLoopLength;
-                    dst.triggerLoopLength = src.triggerLoopLength;
-                    dst.valueResetInterval = src.valueResetInterval;
-                    dst.triggerResetInterval = src.triggerResetInterval;
-                    dst.randomRange = src.randomRange;
-                    dst.enableMasterSource = src.enableMasterSource;
-                    dst.enableLocalSource = src.enableLocalSource;
-                    dst.valueDirection = (SequencerLane::Direction)src.valueDirection;
-                    dst.triggerDirection = (SequencerLane::Direction)src.triggerDirection;
-                    dst.customColor = juce::Colour(src.customColor);
-                    dst.smoothing = src.smoothing;
-                };
-                
-                loadLane(noteLane, pat.noteLane);
-                loadLane(octaveLane, pat.octaveLane);
-                loadLane(velocityLane, pat.velocityLane);
-                loadLane(lengthLane, pat.lengthLane);
-                loadLane(ccLane1, pat.ccLane1);
-                loadLane(ccLane2, pat.ccLane2);
-                loadLane(ccLane3, pat.ccLane3);
-                loadLane(ccLane4, pat.ccLane4);
-                
-                // Reset Playheads on Pattern Load
-                noteLane.reset();
-                octaveLane.reset();
-                velocityLane.reset();
-                lengthLane.reset();
-                
-                ccLane1.reset();
-                ccLane2.reset();
-                ccLane3.reset();
-                ccLane4.reset();
-                lengthLane.reset();
+                track.masterTriggers[step] = (command.steps[step] & 1) != 0;
+                track.masterProbEnabled[step] = (command.steps[step] & 2) != 0;
             }
+            break;
+        case Type::SetMasterLength: track.masterLength = juce::jlimit(1, LaneBank::maxSteps, command.value); break;
+        case Type::SetMasterProbability: track.masterProbability = juce::jlimit(0, 100, command.value); break;
+        case Type::ShiftMasterTriggers:
+            rotateSteps(track.masterTriggers, track.masterLength, command.value);
+            rotateSteps(track.masterProbEnabled, track.masterLength, command.value);
+            break;
+        case Type::ClearMasterTriggers:
+            track.masterTriggers.reset();
+            track.masterLength = 16;
+            break;
+        case Type::SetLoadedPattern:
+            track.loadedBank = command.value / 16;
+            track.loadedSlot = command.value % 16;
+            break;
+        case Type::SetProbabilitySeed: track.probabilitySeed = (juce::uint32)command.value; break;
+        case Type::SetRandomReseed: track.randomReseed = (RandomReseed)juce::jlimit(0, 2, command.value); break;
+        case Type::SetMasterColor: track.masterColor = juce::Colour((juce::uint32)command.value); break;
+        case Type::ResetAllLanes:
+        {
+            // Note C, Octave 3, Velocity 64, Length 32n, CC lanes cleared and switched OFF
+            static constexpr std::array<int, LaneBank::numLanes> resetValues { 0, 3, 64, 5 };
+            for (int l = 0; l < LaneBank::numLanes; ++l)
+                resetLanePattern(lanes, l, resetValues[(size_t)l]);
+            
+            for (int l = LaneBank::numNoteLanes; l < LaneBank::numLanes; ++l)
+                lanes.midiCC[(size_t)l] = 0;
+            
+            track.masterTriggers.reset();
+            track.masterLength = 16;
+            break;
         }
         
-        pendingLoadSlot = -1;
-        pendingLoadBank = -1;
+        // Playheads and global settings, see isPatternEdit
+        case Type::SetValueIndex: case Type::SetTriggerIndex: case Type::SyncLaneToBar:
+        case Type::SetGlobalStepIndex: case Type::SetMidiGateMode: case Type::SetMaxPolyphony:
+        case Type::SetVoiceStealMode: case Type::SetNumCCLanes: case Type::SetNumTracks:
+        case Type::RestoreSession:
+            break;
+    }
+}
+
+void ShequencerAudioProcessor::applyLaneEdit(const LaneEditCommand& command)
+{
+    using Type = LaneEditCommand::Type;
+    
+    if (command.track < 0 || command.track >= maxTracks) return;
+    auto& track = tracks[(size_t)command.track];
+    auto& lanes = track.lanes;
+    
+    const bool isLaneEdit = command.type < Type::SetMasterSteps;
+    if (isLaneEdit && (command.lane < 0 || command.lane >= numLanes)) return;
+    const int lane = command.lane;
+    
+    if (isPatternEdit(command.type))
+    {
+        // Made against a pattern the track has loaded over since, which the edited copy also lost
+        if (command.patternLoads != appliedPatternLoads[(size_t)command.track].load(std::memory_order_relaxed))
+            return;
+        
+        applyPatternEdit(track, command);
+    }
+    
+    switch (command.type)
+    {
+        // Settings every track shares
+        case Type::SetMidiGateMode:
+            isMidiGateMode = (command.value != 0);
+            
+            // Gate mode steps with the MIDI input, which a replay cannot follow
+            for (auto& checkpoints : seekCheckpoints)
+                checkpoints.isExact = false;
+            return;
+        case Type::SetMaxPolyphony: maxPolyphony = juce::jlimit(1, maxActiveNotes, command.value); return;
+        case Type::SetVoiceStealMode: voiceStealMode = (VoiceStealMode)juce::jlimit(0, 2, command.value); return;
+        case Type::SetNumTracks: applyNumTracks(command.value); return;
+        case Type::RestoreSession: adoptRestoredSession(); return;
+        
+        // Playback state
+        case Type::SetGlobalStepIndex: applyGlobalStepIndex(track, command.value); break;
+        case Type::SetValueIndex: applyLaneValueIndex(track, lane, command.value); break;
+        case Type::SetTriggerIndex: applyLaneTriggerIndex(track, lane, command.value); break;
+        case Type::SyncLaneToBar: applySyncLaneToBar(track, lane); break;
+        case Type::SetNumCCLanes: applyNumCCLanes(track, command.value); break;
+        case Type::SetRandomSeed: lanes.reseed(lane); break;
+        case Type::SetProbabilitySeed: track.probabilityRandom.seed(track.probabilitySeed, probabilityStream); break;
+        case Type::ResetLane: lanes.reset(lane); break;
+        case Type::ResetAllLanes:
+            for (int i = 0; i < numLanes; ++i)
+                lanes.reset(i);
+            break;
         
-        patternLock.exit();
+        // Sounding values, outputs, colours and the loaded slot leave the stepping alone
+        case Type::SetValues: case Type::ShiftValues: case Type::SetRandomRange:
+        case Type::SetMidiCC: case Type::SetMidiChannel: case Type::SetSmoothing:
+        case Type::SetCustomColor: case Type::SetMasterColor: case Type::SetLoadedPattern:
+            return;
+        
+        // Pattern only
+        case Type::SetTriggers: case Type::SetValueLoopLength: case Type::SetTriggerLoopLength:
+        case Type::SetValueDirection: case Type::SetTriggerDirection: case Type::SetValueResetInterval:
+        case Type::SetTriggerResetInterval: case Type::SetEnableMasterSource: case Type::SetEnableLocalSource:
+        case Type::ShiftTriggers: case Type::SetMasterSteps: case Type::SetMasterLength:
+        case Type::SetMasterProbability: case Type::ShiftMasterTriggers: case Type::ClearMasterTriggers:
+        case Type::SetRandomReseed:
+            break;
     }
+    
+    // Anything else changes how the track steps
+    forgetSeekCheckpoints(command.track);
 }
 
-void ShequencerAudioProcessor::clearPattern(int bank, int slot)
+void ShequencerAudioProcessor::applyEditedLaneEdit(const LaneEditCommand& command)
 {
-    if (bank < 0 || bank >= 4 || slot < 0 || slot >= 16) return;
+    using Type = LaneEditCommand::Type;
     
-    const juce::ScopedLock sl(patternLock);
+    if (command.track < 0 || command.track >= maxTracks) return;
+    auto& track = edited.tracks[(size_t)command.track];
     
-    patternBanks[(size_t)bank][(size_t)slot].isEmpty = true;
-    patternBanks[(size_t)bank][(size_t)slot].masterProbEnabled.fill(false);
-    patternBanks[(size_t)bank][(size_t)slot].masterProbability = 100;
+    switch (command.type)
+    {
+        case Type::SetMidiGateMode: edited.isMidiGateMode = (command.value != 0); return;
+        case Type::SetMaxPolyphony: edited.maxPolyphony = juce::jlimit(1, maxActiveNotes, command.value); return;
+        case Type::SetVoiceStealMode: edited.voiceStealMode = (VoiceStealMode)juce::jlimit(0, 2, command.value); return;
+        case Type::SetNumTracks: edited.numTracks = juce::jlimit(1, maxTracks, command.value); return;
+        case Type::RestoreSession: return; // restoreSession set the edited copy already
+        case Type::SetNumCCLanes:
+            track.lanes.numActiveLanes = firstCCLaneIndex + juce::jlimit(0, maxCCLanes, command.value);
+            break;
+        
+        // Playheads, which the edited copy does not follow
+        case Type::SetValueIndex: case Type::SetTriggerIndex: case Type::SyncLaneToBar:
+        case Type::SetGlobalStepIndex:
+            break;
+        
+        case Type::SetValues: case Type::SetTriggers: case Type::SetValueLoopLength:
+        case Type::SetTriggerLoopLength: case Type::SetValueDirection: case Type::SetTriggerDirection:
+        case Type::SetValueResetInterval: case Type::SetTriggerResetInterval: case Type::SetRandomRange:
+        case Type::SetEnableMasterSource: case Type::SetEnableLocalSource: case Type::SetMidiCC:
+        case Type::SetMidiChannel: case Type::SetSmoothing: case Type::SetRandomSeed:
+        case Type::ShiftValues: case Type::ShiftTriggers: case Type::ResetLane:
+        case Type::SetCustomColor: case Type::SetMasterSteps: case Type::SetMasterLength:
+        case Type::SetMasterProbability: case Type::ShiftMasterTriggers: case Type::ClearMasterTriggers:
+        case Type::SetLoadedPattern: case Type::SetProbabilitySeed: case Type::SetRandomReseed:
+        case Type::SetMasterColor: case Type::ResetAllLanes:
+            applyPatternEdit(track, command);
+            break;
+    }
+    
+    // After the edit, so a save that takes the bit also sees the new contents
+    const bool isLaneEdit = command.type < Type::SetMasterSteps;
+    if (isLaneEdit && command.lane >= 0 && command.lane < numLanes)
+        markLanesDirty(command.track, (LaneBank::LaneMask)1 << command.lane);
+    else if (command.type == Type::SetNumCCLanes || command.type == Type::ResetAllLanes)
+        markLanesDirty(command.track, ~(LaneBank::LaneMask)0);
 }
 
-void ShequencerAudioProcessor::saveAllPatternsToJson(const juce::File& file)
+void ShequencerAudioProcessor::syncEditedTracks()
 {
-    juce::var root(new juce::DynamicObject());
-    juce::Array<juce::var> banks;
+    const juce::ScopedLock sl(patternLock);
     
+    // Edits sent while the queue was full go in as the audio thread makes room
+    queuePendingLaneEdits();
+    
+    // Until the audio thread has taken over a restored session, its loads are ones the session drops
+    if (restoresAdopted.load(std::memory_order_acquire) != restoresSent) return;
+    
+    // A track the audio thread loaded a pattern into takes the same pattern here
+    for (size_t t = 0; t < (size_t)maxTracks; ++t)
     {
-        const juce::ScopedLock sl(patternLock);
+        const auto applied = appliedPatternLoads[t].load(std::memory_order_acquire);
+        if (applied == edited.patternLoads[t]) continue;
+        edited.patternLoads[t] = applied;
         
-        for (int b = 0; b < 4; ++b)
-        {
-            juce::var bankObj(new juce::DynamicObject());
-            bankObj.getDynamicObject()->setProperty("index", b);
-            
-            juce::Array<juce::var> patterns;
-            
-            for (int s = 0; s < 16; ++s)
-            {
-                const auto& pat = patternBanks[(size_t)b][(size_t)s];
-                if (!pat.isEmpty)
-                {
-                    juce::var patObj(new juce::DynamicObject());
-                    patObj.getDynamicObject()->setProperty("slot", s);
-                    patObj.getDynamicObject()->setProperty("masterLength", pat.masterLength);
-                    patObj.getDynamicObject()->setProperty("shuffleAmount", pat.shuffleAmount);
-                    patObj.getDynamicObject()->setProperty("masterProbability", pat.masterProbability);
-                    patObj.getDynamicObject()->setProperty("masterColor", (int)pat.masterColor);
-                    
-                    juce::String mTrig;
-                    for (bool v : pat.masterTriggers) mTrig += (v ? "1" : "0");
-                    patObj.getDynamicObject()->setProperty("masterTriggers", mTrig);
+        const int bank = (int)(applied & 0xff) / 16;
+        const int slot = (int)(applied & 0xff) % 16;
+        decodeStoredPattern(bank, slot);
+        
+        auto& track = edited.tracks[t];
+        const auto& pat = patternBanks[(size_t)bank][(size_t)slot];
+        if (!pat.isEmpty)
+            recallTrack(pat, track);
+        track.loadedBank = bank;
+        track.loadedSlot = slot;
+        markLanesDirty((int)t, ~(LaneBank::LaneMask)0);
+    }
+}
 
-                    juce::String mProb;
-                    for (bool v : pat.masterProbEnabled) mProb += (v ? "1" : "0");
-                    patObj.getDynamicObject()->setProperty("masterProbEnabled", mProb);
-                    
-                    auto savePatLane = [&](const PatternData::LaneData& ld, juce::String name) {
-                        juce::var lObj(new juce::DynamicObject());
-                        lObj.getDynamicObject()->setProperty("midiCC", ld.midiCC);
-                        lObj.getDynamicObject()->setProperty("valueLoopLength", ld.valueLoopLength);
-                        lObj.getDynamicObject()->setProperty("triggerLoopLength", ld.triggerLoopLength);
-                        lObj.getDynamicObject()->setProperty("valueResetInterval", ld.valueResetInterval);
-                        lObj.getDynamicObject()->setProperty("triggerResetInterval", ld.triggerResetInterval);
-                        lObj.getDynamicObject()->setProperty("randomRange", ld.randomRange);
-                        lObj.getDynamicObject()->setProperty("enableMasterSource", ld.enableMasterSource);
-                        lObj.getDynamicObject()->setProperty("enableLocalSource", ld.enableLocalSource);
-                        lObj.getDynamicObject()->setProperty("valueDirection", ld.valueDirection);
-                        lObj.getDynamicObject()->setProperty("triggerDirection", ld.triggerDirection);
-                        lObj.getDynamicObject()->setProperty("customColor", (int)ld.customColor);
-                        lObj.getDynamicObject()->setProperty("smoothing", ld.smoothing);
-                        
-                        juce::String vStr;
-                        for (int v : ld.values) vStr += juce::String(v) + ",";
-                        lObj.getDynamicObject()->setProperty("values", vStr);
-                        
-                        juce::String tStr;
-                        for (bool v : ld.triggers) tStr += (v ? "1" : "0");
-                        lObj.getDynamicObject()->setProperty("triggers", tStr);
-                        
-                        patObj.getDynamicObject()->setProperty(name, lObj);
-                    };
-                    
-                    savePatLane(pat.noteLane, "NOTE_LANE");
-                    savePatLane(pat.octaveLane, "OCTAVE_LANE");
-                    savePatLane(pat.velocityLane, "VELOCITY_LANE");
-                    savePatLane(pat.lengthLane, "LENGTH_LANE");
-                    
-                    savePatLane(pat.ccLane1, "CC_LANE_1");
-                    savePatLane(pat.ccLane2, "CC_LANE_2");
-                    savePatLane(pat.ccLane3, "CC_LANE_3");
-                    savePatLane(pat.ccLane4, "CC_LANE_4");
-                    
-                    patterns.add(patObj);
-                }
-            }
-            bankObj.getDynamicObject()->setProperty("patterns", patterns);
-            banks.add(bankObj);
-        }
+void ShequencerAudioProcessor::restoreSession(std::unique_ptr<EditedState> session)
+{
+    int start1, size1, start2, size2;
+    restoredSessionFifo.prepareToWrite(1, start1, size1, start2, size2);
+    
+    if (size1 + size2 < 1)
+    {
+        jassertfalse; // The audio thread is not taking restored sessions
+        return;
     }
     
-    root.getDynamicObject()->setProperty("banks", banks);
+    edited = *session;
+    for (int t = 0; t < maxTracks; ++t)
+        markLanesDirty(t, ~(LaneBank::LaneMask)0);
     
-    juce::String jsonString = juce::JSON::toString(root);
-    file.replaceWithText(jsonString);
+    // Refilling the slot frees the session the audio thread took from it last time round
+    restoredSessions[(size_t)(size1 > 0 ? start1 : start2)] = std::move(session);
+    restoredSessionFifo.finishedWrite(1);
+    ++restoresSent;
+    
+    sendLaneEdit(LaneEditCommand::Type::RestoreSession, 0, 0);
 }
 
-void ShequencerAudioProcessor::loadAllPatternsFromJson(const juce::File& file)
+void ShequencerAudioProcessor::adoptRestoredSession()
 {
-    juce::var root = juce::JSON::parse(file);
-    if (!root.isObject()) return;
+    int start1, size1, start2, size2;
+    restoredSessionFifo.prepareToRead(1, start1, size1, start2, size2);
+    if (size1 + size2 < 1) return;
     
-    const juce::ScopedLock sl(patternLock);
+    const auto& session = *restoredSessions[(size_t)(size1 > 0 ? start1 : start2)];
     
-    // Clear existing patterns
-    for(auto& bank : patternBanks)
-        for(auto& pat : bank)
-            pat.isEmpty = true;
-            
-    auto banks = root.getProperty("banks", juce::var());
-    if (banks.isArray())
+    maxPolyphony = session.maxPolyphony;
+    voiceStealMode = session.voiceStealMode;
+    applyNumTracks(session.numTracks);
+    
+    // Every track starts its restored pattern over and, while playing, is sought to the next step
+    // like a track switched on. Notes already sounding end through the note-off scheduler.
+    for (int t = 0; t < maxTracks; ++t)
     {
-        for (int i = 0; i < banks.size(); ++i)
-        {
-            auto bankObj = banks[i];
-            int b = bankObj.getProperty("index", -1);
-            if (b >= 0 && b < 4)
-            {
-                auto patterns = bankObj.getProperty("patterns", juce::var());
-                if (patterns.isArray())
-                {
-                    for (int j = 0; j < patterns.size(); ++j)
-                    {
-                        auto patObj = patterns[j];
-                        int s = patObj.getProperty("slot", -1);
-                        if (s >= 0 && s < 16)
-                        {
-                            auto& pat = patternBanks[(size_t)b][(size_t)s];
-                            pat.isEmpty = false;
-                            pat.masterLength = patObj.getProperty("masterLength", 16);
-                            pat.shuffleAmount = patObj.getProperty("shuffleAmount", 1);
-                            pat.masterProbability = patObj.getProperty("masterProbability", 100);
-                            pat.masterColor = (juce::uint32)(int)patObj.getProperty("masterColor", 0);
-                            
-                            juce::String mTrig = patObj.getProperty("masterTriggers", "").toString();
-                            for(int k=0; k<16 && k<mTrig.length(); ++k) pat.masterTriggers[(size_t)k] = (mTrig[k] == '1');
-
-                            juce::String mProb = patObj.getProperty("masterProbEnabled", "").toString();
-                            for(int k=0; k<16 && k<mProb.length(); ++k) pat.masterProbEnabled[(size_t)k] = (mProb[k] == '1');
-                            
-                            auto loadPatLane = [&](PatternData::LaneData& ld, juce::String name) {
-                                auto lObj = patObj.getProperty(name, juce::var());
-                                if (lObj.isObject()) {
-                                    ld.midiCC = lObj.getProperty("midiCC", 0);
-                                    ld.valueLoopLength = lObj.getProperty("valueLoopLength", 16);
-                                    ld.triggerLoopLength = lObj.getProperty("triggerLoopLength", 16);
-                                    ld.valueResetInterval = lObj.getProperty("valueResetInterval", 0);
-                                    ld.triggerResetInterval = lObj.getProperty("triggerResetInterval", 0);
-                                    ld.randomRange = lObj.getProperty("randomRange", 0);
-                                    ld.enableMasterSource = lObj.getProperty("enableMasterSource", false);
-                                    ld.enableLocalSource = lObj.getProperty("enableLocalSource", true);
-                                    ld.valueDirection = lObj.getProperty("valueDirection", 0);
-                                    ld.triggerDirection = lObj.getProperty("triggerDirection", 0);
-                                    ld.customColor = (juce::uint32)(int)lObj.getProperty("customColor", 0);
-                                    ld.smoothing = lObj.getProperty("smoothing", 0);
-                                    
-                                    juce::String vStr = lObj.getProperty("values", "").toString();
-                                    juce::StringArray toks; toks.addTokens(vStr, ",", "");
-                                    for(int k=0; k<16 && k<toks.size(); ++k) ld.values[(size_t)k] = toks[k].getIntValue();
-                                    
-                                    juce::String tStr = lObj.getProperty("triggers", "").toString();
-                                    for(int k=0; k<16 && k<tStr.length(); ++k) ld.triggers[(size_t)k] = (tStr[k] == '1');
-                                }
-                            };
-                            
-                            loadPatLane(pat.noteLane, "NOTE_LANE");
-                            loadPatLane(pat.octaveLane, "OCTAVE_LANE");
-                            loadPatLane(pat.velocityLane, "VELOCITY_LANE");
-                            
-                            loadPatLane(pat.ccLane1, "CC_LANE_1");
-                            loadPatLane(pat.ccLane2, "CC_LANE_2");
-                            loadPatLane(pat.ccLane3, "CC_LANE_3");
-                            loadPatLane(pat.ccLane4, "CC_LANE_4");
-                            loadPatLane(pat.lengthLane, "LENGTH_LANE");
-                        }
-                    }
-                }
-            }
-        }
+        auto& track = tracks[(size_t)t];
+        copyTrackPattern(session.tracks[(size_t)t], track);
+        
+        // Loads made since the session was taken are gone again, as they are from the edited copy
+        appliedPatternLoads[(size_t)t].store(session.patternLoads[(size_t)t], std::memory_order_relaxed);
+        track.lanes.resetAll();
+        reseedRandomStreams(track);
+        track.lanesToSeek = isPlaying ? track.lanes.getActiveLaneMask() : 0;
+        forgetSeekCheckpoints(t);
     }
+    
+    restoredSessionFifo.finishedRead(1);
+    restoresAdopted.fetch_add(1, std::memory_order_release);
 }
 
-void ShequencerAudioProcessor::shiftMasterTriggers(int delta)
+void ShequencerAudioProcessor::markLanesDirty(int track, LaneBank::LaneMask lanes)
 {
-    if (masterLength < 2) return;
-    int len = masterLength;
-    delta = delta % len;
-    if (delta < 0) delta += len;
-    
-    auto start = masterTriggers.begin();
-    auto end = masterTriggers.begin() + len;
+    if (track < 0 || track >= maxTracks) return;
+    dirtyLanes[(size_t)track].fetch_or(lanes, std::memory_order_release);
+}
 
-    std::rotate(start, end - delta, end);
-    
-    auto startProb = masterProbEnabled.begin();
-    auto endProb = masterProbEnabled.begin() + len;
-    std::rotate(startProb, endProb - delta, endProb);
+void ShequencerAudioProcessor::shiftMasterTriggers(int delta)
+{
+    sendLaneEdit(LaneEditCommand::Type::ShiftMasterTriggers, 0, delta);
 }
 
 void ShequencerAudioProcessor::setGlobalStepIndex(int targetIndex)
+{
+    sendLaneEdit(LaneEditCommand::Type::SetGlobalStepIndex, 0, targetIndex);
+}
+
+void ShequencerAudioProcessor::setLaneTriggerIndex(int laneIndex, int targetIndex)
+{
+    sendLaneEdit(LaneEditCommand::Type::SetTriggerIndex, laneIndex, targetIndex);
+}
+
+void ShequencerAudioProcessor::setLaneValueIndex(int laneIndex, int targetIndex)
+{
+    sendLaneEdit(LaneEditCommand::Type::SetValueIndex, laneIndex, targetIndex);
+}
+
+void ShequencerAudioProcessor::resetLane(int laneIndex, int defaultValue)
+{
+    sendLaneEdit(LaneEditCommand::Type::ResetLane, laneIndex, defaultValue);
+}
+
+void ShequencerAudioProcessor::resetAllLanes()
+{
+    sendLaneEdit(LaneEditCommand::Type::ResetAllLanes, 0);
+}
+
+void ShequencerAudioProcessor::syncLaneToBar(int laneIndex)
+{
+    sendLaneEdit(LaneEditCommand::Type::SyncLaneToBar, laneIndex);
+}
+
+void ShequencerAudioProcessor::setNumCCLanes(int numCCLanes)
+{
+    sendLaneEdit(LaneEditCommand::Type::SetNumCCLanes, 0, numCCLanes);
+}
+
+void ShequencerAudioProcessor::setNumTracks(int newNumTracks)
+{
+    sendLaneEdit(LaneEditCommand::Type::SetNumTracks, 0, newNumTracks);
+}
+
+void ShequencerAudioProcessor::applyGlobalStepIndex(SequencerTrack& track, int targetIndex)
 {
     // We want the NEXT step (lastAbsStep + 1) to map to targetIndex
     // (lastAbsStep + 1 + globalStepOffset) % masterLength == targetIndex
     // globalStepOffset = targetIndex - (lastAbsStep + 1)
     
     long long nextAbs = lastAbsStep + 1;
-    globalStepOffset = (long long)targetIndex - nextAbs;
+    track.globalStepOffset = (long long)targetIndex - nextAbs;
     
     // Normalize offset to avoid huge negative numbers, though not strictly necessary for correctness if modulo is handled
     // But keeping it clean:
@@ -1568,118 +3227,398 @@ void ShequencerAudioProcessor::setGlobalStepIndex(int targetIndex)
     // Just setting it is fine.
 }
 
-void ShequencerAudioProcessor::setLaneTriggerIndex(SequencerLane& lane, int targetIndex)
+void ShequencerAudioProcessor::applyLaneTriggerIndex(SequencerTrack& track, int lane, int targetIndex)
 {
-    lane.currentTriggerStep = targetIndex;
-    lane.activeTriggerStep = targetIndex;
-    lane.triggerMovingForward = true; // Reset direction state on manual set
+    auto& lanes = track.lanes;
+    const auto i = (size_t)lane;
+    lanes.currentTriggerStep[i] = targetIndex;
+    lanes.activeTriggerStep[i] = targetIndex;
+    lanes.triggerMovingForward[i] = true; // Reset direction state on manual set
 }
 
-void ShequencerAudioProcessor::setLaneValueIndex(SequencerLane& lane, int targetIndex)
+void ShequencerAudioProcessor::applyLaneValueIndex(SequencerTrack& track, int lane, int targetIndex)
 {
-    lane.currentValueStep = targetIndex;
-    lane.activeValueStep = targetIndex;
-    lane.valueMovingForward = true;
-    lane.forceNextStep = true;
+    auto& lanes = track.lanes;
+    const auto i = (size_t)lane;
+    lanes.currentValueStep[i] = targetIndex;
+    lanes.activeValueStep[i] = targetIndex;
+    lanes.valueMovingForward[i] = true;
+    lanes.forceNextStep[i] = true;
 }
 
-void ShequencerAudioProcessor::resetLane(SequencerLane& lane, int defaultValue)
+void ShequencerAudioProcessor::applySyncLaneToBar(SequencerTrack& track, int lane)
 {
-    lane.values.fill(defaultValue);
-    lane.triggers.fill(true);
-    lane.valueLoopLength = 16;
-    lane.triggerLoopLength = 16;
-    lane.valueResetInterval = 0;
-    lane.triggerResetInterval = 0;
-    lane.triggerStepOffset = 0;
-    lane.currentValueStep = lane.valueLoopLength - 1;
-    lane.activeValueStep = 0;
-    lane.currentTriggerStep = 0;
-    lane.activeTriggerStep = 0;
-    lane.valueDirection = SequencerLane::Direction::Forward;
-    lane.triggerDirection = SequencerLane::Direction::Forward;
-    lane.valueMovingForward = true;
-    lane.triggerMovingForward = true;
+    // Reset to start of sequence; the CC lanes always follow along
+    auto& lanes = track.lanes;
+    for (int i = 0; i < lanes.numActiveLanes; ++i)
+    {
+        if (i != lane && i < firstCCLaneIndex) continue;
+        lanes.currentTriggerStep[(size_t)i] = 0;
+        lanes.triggerMovingForward[(size_t)i] = true;
+        lanes.resetValuesAtNextBar[(size_t)i] = true;
+    }
+    
+    // Force update for UI feedback is implicit as we set currentTriggerStep
 }
 
-void ShequencerAudioProcessor::resetAllLanes()
+void ShequencerAudioProcessor::applyNumCCLanes(SequencerTrack& track, int numCCLanes)
 {
-    resetLane(ccLane1, 0);
-    ccLane1.midiCC = 0;
-    resetLane(ccLane2, 0);
-    ccLane2.midiCC = 0;
-    resetLane(ccLane3, 0);
-    ccLane3.midiCC = 0;
-    resetLane(ccLane4, 0);
-    ccLane4.midiCC = 0;
-    
-    resetLane(noteLane, 0);      // C
-    resetLane(octaveLane, 3);    // 3
-    resetLane(velocityLane, 64); // 64
-    resetLane(lengthLane, 5);    // 32n
-    
-    masterTriggers.fill(false);
-    masterLength = 16;
+    auto& lanes = track.lanes;
+    const int previousActiveLanes = lanes.numActiveLanes;
+    lanes.numActiveLanes = firstCCLaneIndex + juce::jlimit(0, maxCCLanes, numCCLanes);
+    
+    // Switched off lanes were not kept up to date, so lanes coming back on start clean
+    // and the next block puts them where they would be had they been playing all along.
+    // The lanes already running are left alone.
+    for (int lane = previousActiveLanes; lane < lanes.numActiveLanes; ++lane)
+    {
+        lanes.reset(lane);
+        lanes.reseed(lane);
+        lanes.ramps[(size_t)lane] = {};
+        
+        if (isPlaying)
+            track.lanesToSeek |= (LaneBank::LaneMask)1 << lane;
+    }
 }
 
-void ShequencerAudioProcessor::syncLaneToBar(SequencerLane& lane)
+void ShequencerAudioProcessor::applyNumTracks(int newNumTracks)
 {
-    // Reset to start of sequence
-    auto syncLane = [&](SequencerLane& l) {
-        l.currentTriggerStep = 0;
-        l.triggerMovingForward = true;
-        l.resetValuesAtNextBar = true;
-    };
+    const int previousNumTracks = numTracks;
+    numTracks = juce::jlimit(1, maxTracks, newNumTracks);
     
-    syncLane(ccLane1);
-    syncLane(ccLane2);
-    syncLane(ccLane3);
-    syncLane(ccLane4);
+    // As with CC lanes: tracks coming back on start clean and are sought to the next step,
+    // without moving the tracks already running. Notes of tracks switched off still end
+    // through the shared note-off scheduler.
+    for (int t = previousNumTracks; t < numTracks; ++t)
+    {
+        auto& track = tracks[(size_t)t];
+        track.lanes.resetAll();
+        track.lanes.ramps.fill({});
+        track.isHoldActive = false;
+        reseedRandomStreams(track);
+        track.lanesToSeek = isPlaying ? track.lanes.getActiveLaneMask() : 0;
+    }
+}
+
+void ShequencerAudioProcessor::seekLanesTo(SequencerTrack& track, SeekCheckpoints& checkpoints, long long step, const BarGrid& bars, LaneBank::LaneMask lanesToSeek)
+{
+    auto& lanes = track.lanes;
+    step = juce::jmax(0LL, step);
+    lanesToSeek &= lanes.getActiveLaneMask();
+    const bool isWholeTrack = lanesToSeek == lanes.getActiveLaneMask();
+    isOnSeekGrid(checkpoints, bars);
+    
+    bool isRandom = (track.masterProbEnabled & getLoopMask<(size_t)maxSteps>(track.masterLength)).any();
+    for (size_t i = 0; i < (size_t)lanes.numActiveLanes; ++i)
+        if ((lanesToSeek >> i) & 1)
+            isRandom = isRandom || !StepOrder::isDeterministic(lanes.valueDirection[i]) || !StepOrder::isDeterministic(lanes.triggerDirection[i]);
+    
+    // Value lanes follow live MIDI notes in gate mode, so they stay where they are
+    const auto gateValueSteps = lanes.currentValueStep;
+    const auto gateValueMovingForward = lanes.valueMovingForward;
+    
+    bool isExact = true;
+    if (isRandom)
+    {
+        isExact = replayLanesTo(track, checkpoints, step, bars, lanesToSeek);
+    }
+    else
+    {
+        for (int lane = 0; lane < lanes.numActiveLanes; ++lane)
+        {
+            const auto i = (size_t)lane;
+            if (((lanesToSeek >> i) & 1) == 0) continue;
+            
+            // Triggers advance every step from their last restart
+            long long triggerStart = 0;
+            if (lanes.triggerResetInterval[i] > 0)
+                triggerStart = juce::jmax(0LL, bars.getLastResetStep(step, lanes.triggerResetInterval[i]));
+            
+            bool movingForward = true;
+            lanes.currentTriggerStep[i] = StepOrder::advance(0, lanes.triggerLoopLength[i], lanes.triggerDirection[i], movingForward, step - triggerStart);
+            lanes.triggerMovingForward[i] = movingForward;
+            
+            // Values advance once per hit, from the song start (parked on the last step) or their last reset
+            long long valueStart = 0;
+            int valueStartStep = lanes.valueLoopLength[i] - 1;
+            if (lanes.valueResetInterval[i] > 0)
+            {
+                const long long resetStep = bars.getLastResetStep(step, lanes.valueResetInterval[i]);
+                if (resetStep >= 0)
+                {
+                    valueStart = resetStep;
+                    valueStartStep = 0;
+                }
+            }
+            
+            movingForward = true;
+            lanes.currentValueStep[i] = StepOrder::advance(valueStartStep, lanes.valueLoopLength[i], lanes.valueDirection[i], movingForward,
+                                                           countLaneHits(track, checkpoints, lane, valueStart, step, bars));
+            lanes.valueMovingForward[i] = movingForward;
+        }
+        
+        // No draws were taken, so the streams are exactly at their seeds
+        for (int lane = 0; lane < lanes.numActiveLanes; ++lane)
+            if ((lanesToSeek >> lane) & 1)
+                lanes.reseed(lane);
+        if (isWholeTrack)
+            reseedRandomStreams(track);
+    }
     
-    lane.currentTriggerStep = 0;
-    lane.triggerMovingForward = true;
+    if (isMidiGateMode)
+    {
+        lanes.currentValueStep = gateValueSteps;
+        lanes.valueMovingForward = gateValueMovingForward;
+        isExact = false;
+    }
     
-    lane.resetValuesAtNextBar = true;
+    // Lanes sought on their own join the ones already running, exact only if both are
+    checkpoints.isExact = isExact && (isWholeTrack || checkpoints.isExact);
     
-    // Force update for UI feedback is implicit as we set currentTriggerStep
+    lanes.latchActiveSteps(lanesToSeek);
+    if (isWholeTrack)
+        track.currentMasterStep = track.getMasterStepIndex(step);
 }
 
-void ShequencerAudioProcessor::syncAllToBar()
+bool ShequencerAudioProcessor::replayLanesTo(SequencerTrack& track, SeekCheckpoints& checkpoints, long long step, const BarGrid& bars, LaneBank::LaneMask lanesToSeek)
 {
-    double barLen = (double)sigNumerator * 4.0 / (double)sigDenominator;
-    double nextBarPPQ = lastBarStartPPQ + barLen;
+    // Pending user requests are not part of the history
+    auto& lanes = track.lanes;
+    const auto pendingForceNextStep = lanes.forceNextStep;
+    
+    auto restartLanes = [&] {
+        for (int lane = 0; lane < lanes.numActiveLanes; ++lane)
+            if ((lanesToSeek >> lane) & 1)
+                lanes.reseed(lane);
+    };
+    
+    for (int lane = 0; lane < lanes.numActiveLanes; ++lane)
+        if ((lanesToSeek >> lane) & 1)
+            lanes.reset(lane);
+    restartLanes();
+    
+    // The rolls are replayed on a copy, the track's own stream only moves with all of its lanes
+    RandomStream probabilityRandom;
+    probabilityRandom.seed(track.probabilitySeed, probabilityStream);
+    
+    long long from = juce::jmax(0LL, step - maxSeekReplaySteps);
+    bool isExact = from == 0;
     
-    while (nextBarPPQ <= lastPositionInQuarterNotes) nextBarPPQ += barLen;
+    const auto* checkpoint = findSeekCheckpoint(checkpoints, step, bars);
+    if (checkpoint != nullptr && checkpoint->step >= from)
+    {
+        from = checkpoint->step;
+        isExact = true;
+        
+        for (size_t i = 0; i < (size_t)lanes.numActiveLanes; ++i)
+        {
+            if (((lanesToSeek >> i) & 1) == 0) continue;
+            lanes.currentValueStep[i] = checkpoint->valueStep[i];
+            lanes.currentTriggerStep[i] = checkpoint->triggerStep[i];
+            lanes.valueMovingForward[i] = checkpoint->valueMovingForward[i];
+            lanes.triggerMovingForward[i] = checkpoint->triggerMovingForward[i];
+            lanes.randomStreams[i] = checkpoint->randomStreams[i];
+        }
+        probabilityRandom = checkpoint->probabilityRandom;
+    }
     
-    long long targetAbsStep = (long long)std::round(nextBarPPQ / 0.25);
+    // Only a whole track on its full history leaves checkpoints on the way
+    const bool canRecord = isExact && lanesToSeek == lanes.getActiveLaneMask();
     
-    // Align Master to Bar
-    // (targetAbsStep + globalOffset) % masterLength == 0
-    globalStepOffset = -targetAbsStep;
+    // Same order as the step core in processBlock, without any output
+    for (long long k = from; k < step; ++k)
+    {
+        const int stepIdx = track.getMasterStepIndex(k);
+        
+        const bool isBarStart = bars.isFirstStepOfBar(k);
+        if (isBarStart)
+        {
+            if (canRecord)
+                recordSeekCheckpoint(track, checkpoints, k, bars, probabilityRandom);
+            
+            lanes.applyIntervalResets(bars.getBarOfStep(k), lanesToSeek);
+        }
+        
+        if ((track.randomReseed == RandomReseed::EveryLoop && stepIdx == 0)
+            || (track.randomReseed == RandomReseed::EveryBar && isBarStart))
+        {
+            restartLanes();
+            probabilityRandom.seed(track.probabilitySeed, probabilityStream);
+        }
+        
+        bool probCheck = true;
+        if (track.masterProbEnabled[(size_t)stepIdx])
+            probCheck = probabilityRandom.nextInt(100) < track.masterProbability;
+        
+        lanes.advanceValues(lanes.getHitMask(track.masterTriggers[(size_t)stepIdx] && probCheck) & lanesToSeek);
+        lanes.advanceTriggers(lanesToSeek);
+    }
     
-    // Reset all lane triggers to 0
-    noteLane.currentTriggerStep = 0;
-    octaveLane.currentTriggerStep = 0;
-    velocityLane.currentTriggerStep = 0;
-    lengthLane.currentTriggerStep = 0;
+    if (lanesToSeek == lanes.getActiveLaneMask())
+        track.probabilityRandom = probabilityRandom;
+    lanes.forceNextStep = pendingForceNextStep;
+    return isExact;
+}
+
+bool ShequencerAudioProcessor::isOnSeekGrid(SeekCheckpoints& checkpoints, const BarGrid& bars)
+{
+    // Checkpoints taken on another bar grid (a new time signature) no longer line up with the
+    // bar resets, and neither does a state played through them
+    const long long origin = bars.barStartTick - bars.barIndex * bars.barTicks;
+    if (checkpoints.gridOrigin == origin && checkpoints.gridBarTicks == bars.barTicks)
+        return true;
+    
+    for (auto& checkpoint : checkpoints.bars)
+        checkpoint.step = -1;
+    checkpoints.gridOrigin = origin;
+    checkpoints.gridBarTicks = bars.barTicks;
+    checkpoints.isExact = false;
+    return false;
+}
+
+void ShequencerAudioProcessor::recordSeekCheckpoint(const SequencerTrack& track, SeekCheckpoints& checkpoints, long long step, const BarGrid& bars, const RandomStream& probabilityRandom)
+{
+    if (!isOnSeekGrid(checkpoints, bars)) return;
+    
+    const long long bar = bars.getBarOfStep(step);
+    auto& checkpoint = checkpoints.bars[(size_t)(bar - floorDiv(bar, SeekCheckpoints::numBars) * SeekCheckpoints::numBars)];
+    const auto& lanes = track.lanes;
+    
+    checkpoint.step = step;
+    checkpoint.valueStep = lanes.currentValueStep;
+    checkpoint.triggerStep = lanes.currentTriggerStep;
+    checkpoint.valueMovingForward = lanes.valueMovingForward;
+    checkpoint.triggerMovingForward = lanes.triggerMovingForward;
+    checkpoint.randomStreams = lanes.randomStreams;
+    checkpoint.probabilityRandom = probabilityRandom;
+}
+
+const ShequencerAudioProcessor::SeekCheckpoint* ShequencerAudioProcessor::findSeekCheckpoint(SeekCheckpoints& checkpoints, long long step, const BarGrid& bars)
+{
+    // The latest one at or before the step
+    if (!isOnSeekGrid(checkpoints, bars)) return nullptr;
+    
+    const SeekCheckpoint* latest = nullptr;
+    for (const auto& checkpoint : checkpoints.bars)
+        if (checkpoint.step >= 0 && checkpoint.step <= step && (latest == nullptr || checkpoint.step > latest->step))
+            latest = &checkpoint;
+    return latest;
+}
+
+void ShequencerAudioProcessor::forgetSeekCheckpoints(int track)
+{
+    auto& checkpoints = seekCheckpoints[(size_t)track];
+    for (auto& checkpoint : checkpoints.bars)
+        checkpoint.step = -1;
+    checkpoints.isExact = false;
+    ++checkpoints.hitTableGeneration; // The hit tables go with them
+}
+
+long long ShequencerAudioProcessor::countLaneHits(const SequencerTrack& track, SeekCheckpoints& checkpoints, int lane, long long from, long long to, const BarGrid& bars)
+{
+    // Hits of a deterministic lane in steps [from, to).
+    // Between two trigger restarts the lane walks through (master step, trigger phase) pairs,
+    // which repeat every lcm(master length, trigger cycle) steps. The pairs fall into
+    // gcd(master length, trigger cycle) such cycles; each one gets a prefix table of its hits,
+    // built on first use and kept until the track's next stepping edit, so a stretch of any
+    // length costs two table reads.
+    const auto& lanes = track.lanes;
+    const auto i = (size_t)lane;
+    const bool useMaster = lanes.usesMasterSource(lane);
+    const bool useLocal = lanes.usesLocalSource(lane);
+    if (from >= to || (!useMaster && !useLocal)) return 0;
+    
+    const int masterLen = juce::jlimit(1, maxSteps, track.masterLength);
+    const int triggerLen = juce::jlimit(1, maxSteps, lanes.triggerLoopLength[i]);
+    const auto triggerDir = lanes.triggerDirection[i];
+    const int triggerPeriod = StepOrder::tables.period[(size_t)triggerDir][(size_t)triggerLen];
+    const int numCycles = std::gcd(masterLen, triggerPeriod);
+    const int period = masterLen / numCycles * triggerPeriod;
+    
+    // The lane's tables, all cycles' room taken at once so the pool never starts over mid-count
+    auto& table = checkpoints.hitTables[i];
+    if (table.generation != checkpoints.hitTableGeneration || table.poolEpoch != seekHitPoolEpoch)
+    {
+        const int tableSize = numCycles * (period + 1);
+        if (seekHitPoolUsed + tableSize > (int)seekHitCounts.size())
+        {
+            if (++seekHitPoolEpoch == 0) ++seekHitPoolEpoch; // 0 is reserved for "never built"
+            seekHitPoolUsed = 0;
+        }
+        
+        table.generation = checkpoints.hitTableGeneration;
+        table.poolEpoch = seekHitPoolEpoch;
+        table.offset = seekHitPoolUsed;
+        table.isCycleBuilt.reset();
+        seekHitPoolUsed += tableSize;
+    }
     
-    noteLane.triggerMovingForward = true;
-    octaveLane.triggerMovingForward = true;
-    velocityLane.triggerMovingForward = true;
-    lengthLane.triggerMovingForward = true;
+    // Cycle c starts at master step c, trigger phase 0
+    auto getCycleCounts = [&](int cycle) {
+        auto* counts = seekHitCounts.data() + (size_t)table.offset + (size_t)cycle * (size_t)(period + 1);
+        if (!table.isCycleBuilt[(size_t)cycle])
+        {
+            int triggerStep = 0;
+            bool movingForward = true;
+            counts[0] = 0;
+            for (int j = 0; j < period; ++j)
+            {
+                const bool hit = (useMaster && track.masterTriggers[(size_t)((cycle + j) % masterLen)])
+                              || (useLocal && lanes.triggers[i][(size_t)triggerStep]);
+                counts[j + 1] = (juce::uint16)(counts[j] + (hit ? 1 : 0));
+                triggerStep = StepOrder::advance(triggerStep, triggerLen, triggerDir, movingForward, 1);
+            }
+            table.isCycleBuilt[(size_t)cycle] = true;
+        }
+        return counts;
+    };
     
-    noteLane.resetValuesAtNextBar = true;
-    octaveLane.resetValuesAtNextBar = true;
-    velocityLane.resetValuesAtNextBar = true;
-    lengthLane.resetValuesAtNextBar = true;
+    // Hits in the first n steps of a stretch that starts at the given master step (trigger phase 0)
+    auto getHitsBefore = [&](int masterStep, long long n) -> long long {
+        const int cycle = masterStep % numCycles;
+        const auto* counts = getCycleCounts(cycle);
+        
+        // Where the stretch enters its cycle: a whole number of trigger cycles in, on masterStep
+        long long offset = 0;
+        while ((cycle + offset) % masterLen != masterStep) offset += triggerPeriod;
+        
+        auto countUpTo = [&](long long end) { return (end / period) * counts[period] + counts[end % period]; };
+        return countUpTo(offset + n) - countUpTo(offset);
+    };
     
-    // Update Master Step
-    long long currentAbsStep = (long long)std::floor(lastPositionInQuarterNotes / 0.25);
-    long long stepCount = currentAbsStep + globalStepOffset;
+    const int interval = lanes.triggerResetInterval[i];
+    long long stretchStart = interval > 0 ? juce::jmax(0LL, bars.getLastResetStep(from, interval)) : 0;
+    long long hits = 0;
     
-    int mStep = stepCount % masterLength;
-    if (mStep < 0) mStep += masterLength;
-    currentMasterStep = mStep;
+    while (stretchStart < to)
+    {
+        long long stretchEnd = to;
+        if (interval > 0)
+        {
+            const long long nextResetBar = (floorDiv(bars.getBarOfStep(stretchStart), interval) + 1) * interval;
+            stretchEnd = juce::jlimit(stretchStart + 1, to, bars.getFirstStepOfBar(nextResetBar));
+        }
+        
+        const int masterStep = track.getMasterStepIndex(stretchStart) % masterLen;
+        hits += getHitsBefore(masterStep, stretchEnd - stretchStart)
+              - getHitsBefore(masterStep, juce::jmax(from, stretchStart) - stretchStart);
+        stretchStart = stretchEnd;
+    }
+    return hits;
+}
+
+void ShequencerAudioProcessor::newRandomSeeds()
+{
+    auto& r = juce::Random::getSystemRandom();
+    for (int lane = 0; lane < numLanes; ++lane)
+        sendLaneEdit(LaneEditCommand::Type::SetRandomSeed, lane, r.nextInt());
+    sendLaneEdit(LaneEditCommand::Type::SetProbabilitySeed, 0, r.nextInt());
+}
+
+void ShequencerAudioProcessor::reseedRandomStreams(SequencerTrack& track)
+{
+    track.lanes.reseedAll();
+    track.probabilityRandom.seed(track.probabilitySeed, probabilityStream);
 }
 
 // This creates new instances of the plugin..
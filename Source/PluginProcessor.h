@@ -3,258 +3,1013 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_core/juce_core.h>
-#include <set>
+#include <bitset>
+#include <numeric>
 
-struct SequencerLane
+// Step Capacity
+// Every lane and pattern stores stepCapacity steps; loop lengths are runtime values up to it.
+// Set at build time (CMake option SHEQUENCER_MAX_STEPS), memory per pattern grows with it.
+#ifndef SHEQUENCER_MAX_STEPS
+ #define SHEQUENCER_MAX_STEPS 64
+#endif
+static constexpr int stepCapacity = SHEQUENCER_MAX_STEPS;
+static_assert(stepCapacity >= 16 && stepCapacity <= 128, "Step tables hold steps in a byte and hit counts in 16 bits");
+
+// Lane Capacity
+// CC lanes available per instance (CMake option SHEQUENCER_MAX_CC_LANES); how many of them
+// are switched on is a runtime setting.
+#ifndef SHEQUENCER_MAX_CC_LANES
+ #define SHEQUENCER_MAX_CC_LANES 16
+#endif
+static constexpr int ccLaneCapacity = SHEQUENCER_MAX_CC_LANES;
+static_assert(ccLaneCapacity >= 4 && ccLaneCapacity <= 32, "The editor pages through up to 32 CC lanes, four at a time");
+
+// Track Capacity
+// Sequencer tracks available per instance (CMake option SHEQUENCER_MAX_TRACKS); how many of
+// them play is a runtime setting.
+#ifndef SHEQUENCER_MAX_TRACKS
+ #define SHEQUENCER_MAX_TRACKS 8
+#endif
+static constexpr int trackCapacity = SHEQUENCER_MAX_TRACKS;
+static_assert(trackCapacity >= 1 && trackCapacity <= 16, "Each track defaults to its own MIDI channel");
+
+enum class LaneDirection { Forward, Backward, PingPong, Bounce, Random, RandomDirection };
+
+// Runtime State for CC Smoothing
+// A ramp is described in closed form: ramp sample j (0-based) has the value
+// currentSmoothedValue + rampIncrement * (j + 1), and the target once j reaches rampLengthSamples.
+// Sample positions are absolute on the processor's sequencer sample clock.
+struct CCRampState
 {
-    // Value Sequence (Bars)
-    std::array<int, 16> values;
-    int valueLoopLength = 16;
-    int currentValueStep = 0;
-    int activeValueStep = 0;
+    float currentSmoothedValue = 0.0f; // Ramp start value while ramping, otherwise the settled value
+    int targetCCValue = 0;
+    bool isRamping = false;
+    double rampIncrement = 0.0;
+    long long rampStartSample = 0;
+    int rampLengthSamples = 0;
+    long long nextRampEventSample = 0;
+    int lastSentCCValue = -1;
 
-    // Trigger Sequence (Buttons)
-    std::array<bool, 16> triggers;
-    int triggerLoopLength = 16;
-    int currentTriggerStep = 0;
-    int activeTriggerStep = 0;
+    // Smoothed value once the ramp has run up to (not including) the given sample
+    float getRampValueAt(long long sample) const
+    {
+        if (!isRamping) return currentSmoothedValue;
+        long long elapsed = juce::jlimit(0LL, (long long)rampLengthSamples, sample - rampStartSample);
+        if (elapsed >= rampLengthSamples) return (float)targetCCValue;
+        return (float)(currentSmoothedValue + rampIncrement * (double)elapsed);
+    }
     
-    // Source Toggles
-    bool enableMasterSource = false; // Yellow Toggle
-    bool enableLocalSource = true;   // Colored Toggle
+    int getRampOutputAt(long long sample) const
+    {
+        return (int)(currentSmoothedValue + rampIncrement * (double)(sample - rampStartSample + 1));
+    }
     
-    int triggerStepOffset = 0;
+    void startRamp(long long sample, int target, double durationSamples)
+    {
+        // Retargeting mid-ramp continues from wherever the running ramp has got to
+        currentSmoothedValue = getRampValueAt(sample);
+        targetCCValue = target;
+        isRamping = true;
+        rampStartSample = sample;
+        rampLengthSamples = (int)durationSamples;
+        rampIncrement = (target - currentSmoothedValue) / durationSamples;
+        nextRampEventSample = findRampChange(sample);
+    }
     
-    bool forceNextStep = false;
-    bool resetValuesAtNextBar = false;
+    // First sample at or after 'from' whose output differs from the last sent value,
+    // or the end of the ramp if the output does not change before then
+    long long findRampChange(long long from) const
+    {
+        const long long rampEnd = rampStartSample + rampLengthSamples;
+        if (from >= rampEnd) return rampEnd;
+        if (getRampOutputAt(from) != lastSentCCValue) return from;
+        if (juce::exactlyEqual(rampIncrement, 0.0)) return rampEnd;
+        
+        // Solve for the crossing of the next integer boundary, then correct for rounding
+        double boundary = rampIncrement > 0.0 ? lastSentCCValue + 1.0 : (double)lastSentCCValue;
+        double steps = (boundary - currentSmoothedValue) / rampIncrement;
+        long long sample = rampStartSample - 1 + (long long)(rampIncrement > 0.0 ? std::ceil(steps) : std::floor(steps) + 1.0);
+        sample = juce::jlimit(from, rampEnd, sample);
+        while (sample > from && getRampOutputAt(sample - 1) != lastSentCCValue) --sample;
+        while (sample < rampEnd && getRampOutputAt(sample) == lastSentCCValue) ++sample;
+        return sample;
+    }
+};
+
+// Step Order Tables
+// Forward, Backward, PingPong and Bounce visit a fixed cycle of steps for each loop length,
+// e.g. PingPong over 3 steps is 0 1 2 2 1 0. A position is a phase in that cycle, so
+// advancing by any number of steps is a phase addition and two table reads.
+template <int MaxLength>
+struct BasicStepOrderTables
+{
+    static constexpr int maxLength = MaxLength;
+    static constexpr int numDirections = 4; // The deterministic LaneDirections
+    static constexpr int maxPeriod = 2 * maxLength;
     
-    // Reset Intervals (0 = OFF, 1, 2, 4, 8, 16, 32, 64, 128)
-    int valueResetInterval = 0;
-    int triggerResetInterval = 0;
+    // Array extents
+    static constexpr size_t directionSlots = (size_t)numDirections;
+    static constexpr size_t lengthSlots = (size_t)maxLength + 1; // Indexed by length, 0 unused
+    static constexpr size_t phaseSlots = (size_t)maxPeriod;
+    static constexpr size_t stepSlots = (size_t)maxLength;
     
-    // Randomization Range (0 = Full Random, >0 = +/- Range)
-    int randomRange = 0;
+    template <typename T, size_t N>
+    using PerLength = std::array<std::array<std::array<T, N>, lengthSlots>, directionSlots>; // [direction][length][...]
     
-    enum class Direction { Forward, Backward, PingPong, Bounce, Random, RandomDirection };
-    Direction valueDirection = Direction::Forward;
-    Direction triggerDirection = Direction::Forward;
+    std::array<std::array<int, lengthSlots>, directionSlots> period {};
+    PerLength<juce::uint8, phaseSlots> step {};
+    PerLength<bool, phaseSlots> movingForward {}; // Direction state after arriving at the phase
+    PerLength<std::array<juce::uint8, 2>, stepSlots> phaseOf {}; // [step][movingForward], steps past the loop fold back into it
     
-    bool valueMovingForward = true;
-    bool triggerMovingForward = true;
+    constexpr BasicStepOrderTables()
+    {
+        for (int d = 0; d < numDirections; ++d)
+        {
+            const auto dir = (LaneDirection)d;
+            
+            for (int len = 1; len <= maxLength; ++len)
+            {
+                const auto di = (size_t)d;
+                const auto li = (size_t)len;
+                
+                int cycle = len;
+                if (len > 1 && dir == LaneDirection::PingPong) cycle = 2 * len;      // 0 1 2 2 1 0
+                else if (len > 1 && dir == LaneDirection::Bounce) cycle = 2 * len - 2; // 0 1 2 1
+                period[di][li] = cycle;
+                
+                for (int phase = 0; phase < cycle; ++phase)
+                {
+                    int s = phase;
+                    bool forward = true;
+                    
+                    if (dir == LaneDirection::Backward)
+                    {
+                        s = (len - phase) % len;
+                    }
+                    else if (phase >= len)
+                    {
+                        s = (dir == LaneDirection::PingPong) ? 2 * len - 1 - phase : 2 * len - 2 - phase;
+                        forward = false;
+                    }
+                    else if (dir == LaneDirection::Bounce && phase == 0 && len > 1)
+                    {
+                        forward = false; // Only reached on the way down, turns on the next step
+                    }
+                    
+                    step[di][li][(size_t)phase] = (juce::uint8)s;
+                    movingForward[di][li][(size_t)phase] = forward;
+                }
+                
+                for (int s = 0; s < maxLength; ++s)
+                {
+                    const int inLoop = std::min(s, len - 1);
+                    int forwardPhase = inLoop;
+                    int backwardPhase = inLoop;
+                    
+                    if (dir == LaneDirection::Forward)
+                    {
+                        forwardPhase = backwardPhase = s % len;
+                    }
+                    else if (dir == LaneDirection::Backward)
+                    {
+                        forwardPhase = backwardPhase = (len - s % len) % len;
+                    }
+                    else if (dir == LaneDirection::PingPong)
+                    {
+                        backwardPhase = (len > 1) ? 2 * len - 1 - inLoop : 0;
+                    }
+                    else if (inLoop > 0 && inLoop < len - 1) // Bounce, the turning points have a single phase
+                    {
+                        backwardPhase = 2 * len - 2 - inLoop;
+                    }
+                    
+                    phaseOf[di][li][(size_t)s][0] = (juce::uint8)backwardPhase;
+                    phaseOf[di][li][(size_t)s][1] = (juce::uint8)forwardPhase;
+                }
+            }
+        }
+    }
+};
+
+template <int MaxLength>
+struct BasicStepOrder
+{
+    using Tables = BasicStepOrderTables<MaxLength>;
+    static constexpr int maxLength = MaxLength;
+    // Built in place; constant-initialised where the compiler's constexpr budget allows,
+    // otherwise once at load time for the larger capacities
+    static inline const Tables tables {};
     
-    // MIDI CC (0 = Off, 1-127 = CC Number)
-    int midiCC = 0;
+    static bool isDeterministic(LaneDirection dir)
+    {
+        return (int)dir < Tables::numDirections;
+    }
+    
+    // Step reached after numSteps advances from (step, movingForward), updating movingForward.
+    // Deterministic directions only.
+    static int advance(int step, int len, LaneDirection dir, bool& movingForward, long long numSteps)
+    {
+        jassert(isDeterministic(dir) && numSteps >= 0);
+        if (len <= 1) return 0;
+        len = juce::jmin(len, maxLength);
+        
+        const auto di = (size_t)dir;
+        const auto li = (size_t)len;
+        const int period = tables.period[di][li];
+        
+        const int start = tables.phaseOf[di][li][(size_t)juce::jlimit(0, maxLength - 1, step)][movingForward ? 1 : 0];
+        const auto phase = (size_t)((start + numSteps % period) % period);
+        
+        // Forward and Backward leave the direction state alone
+        if (dir == LaneDirection::PingPong || dir == LaneDirection::Bounce)
+            movingForward = tables.movingForward[di][li][phase];
+        return tables.step[di][li][phase];
+    }
+};
 
-    // Smoothing (0-100)
-    int smoothing = 0;
+using StepOrder = BasicStepOrder<stepCapacity>;
+
+// Step Masks
+// Trigger and probability rows are packed one bit per step, step 0 in bit 0. At the default
+// capacities a row is a single machine word, so shifting a loop is a masked rotate and
+// never a walk over the steps.
+template <size_t NumSteps>
+std::bitset<NumSteps> getLoopMask(int length)
+{
+    return ~std::bitset<NumSteps>() >> (NumSteps - (size_t)juce::jlimit(0, (int)NumSteps, length));
+}
+
+// Rotates the first length steps later by delta (wrapping inside the loop); steps past the loop stay put
+template <size_t NumSteps>
+void rotateSteps(std::bitset<NumSteps>& steps, int length, int delta)
+{
+    if (length < 2) return;
+    delta = delta % length;
+    if (delta < 0) delta += length;
+    if (delta == 0) return;
     
-    // Runtime State for Smoothing
-    float currentSmoothedValue = 0.0f;
-    int targetCCValue = 0;
-    bool isRamping = false;
-    double rampIncrement = 0.0;
-    int rampSamplesRemaining = 0;
-    int lastSentCCValue = -1;
+    const auto loopMask = getLoopMask<NumSteps>(length);
+    const auto loop = steps & loopMask;
+    steps = (steps & ~loopMask) | (((loop << (size_t)delta) | (loop >> (size_t)(length - delta))) & loopMask);
+}
+
+// Chord vocabulary for CHORD lanes (midiCC 130).
+// Lane value 0 plays the root alone, 1..numChords pick a chord. Everything is stored
+// flat and fixed-size, so a lookup on the audio thread is a plain indexed read and a
+// user chord set compiles into exactly the same layout as the built-in one.
+struct ChordTable
+{
+    static constexpr int maxChords = 64;
+    static constexpr int maxNotes = 6;
+    static constexpr int maxNameLength = 7; // Plus terminator
+
+    struct Chord
+    {
+        std::array<char, maxNameLength + 1> name {};
+        std::array<juce::int8, maxNotes> offsets {}; // Semitones from the root
+        juce::uint8 numNotes = 1;
+    };
 
-    // Custom Color (If transparent, use default)
-    juce::Colour customColor = juce::Colours::transparentBlack;
+    std::array<Chord, maxChords + 1> chords {}; // chords[0] is the bare root
+    int numChords = 0;
 
-    // Helper to advance value
-    void advanceValue(juce::Random& r)
+    bool isEmpty() const { return numChords == 0; }
+
+    // Values past the end of the set clamp to its last chord, like any other lane value
+    // clamped to its range
+    const Chord& get(int value) const
+    {
+        if (value <= 0 || numChords == 0) return chords[0];
+        return chords[(size_t)juce::jmin(value, numChords)];
+    }
+
+    // Returns false once the table is full. Names are truncated, offsets beyond maxNotes dropped.
+    constexpr bool add(const char* name, const int* offsets, int numOffsets)
     {
-        if (forceNextStep)
+        if (numChords >= maxChords) return false;
+        auto& chord = chords[(size_t)++numChords];
+
+        for (int i = 0; i < maxNameLength && name[i] != 0; ++i)
+            chord.name[(size_t)i] = name[i];
+
+        chord.numNotes = (juce::uint8)(numOffsets < 1 ? 1 : (numOffsets > maxNotes ? maxNotes : numOffsets));
+        for (int i = 0; i < numOffsets && i < maxNotes; ++i)
+            chord.offsets[(size_t)i] = (juce::int8)(offsets[i] < -127 ? -127 : (offsets[i] > 127 ? 127 : offsets[i]));
+        return true;
+    }
+
+    constexpr bool add(const char* name, std::initializer_list<int> offsets)
+    {
+        return add(name, offsets.begin(), (int)offsets.size());
+    }
+
+private:
+    static constexpr ChordTable makeBuiltIn()
+    {
+        ChordTable t;
+        // 3-Note Chords (1-12)
+        t.add("Maj",   { 0, 4, 7 });
+        t.add("Min",   { 0, 3, 7 });
+        t.add("Dim",   { 0, 3, 6 });
+        t.add("Aug",   { 0, 4, 8 });
+        t.add("Sus2",  { 0, 2, 7 });
+        t.add("Sus4",  { 0, 5, 7 });
+        t.add("Pow",   { 0, 7, 12 });  // Root+5+8
+        t.add("Maj/1", { 0, 4, 12 });  // Open/Inv
+        t.add("Min/1", { 0, 3, 12 });
+        t.add("Maj/2", { 0, 7, 16 });  // Spread
+        t.add("Min/2", { 0, 7, 15 });
+        t.add("Oct",   { 0, 12, 24 });
+
+        // 4-Note Chords (13-24)
+        t.add("Maj7",  { 0, 4, 7, 11 });
+        t.add("Min7",  { 0, 3, 7, 10 });
+        t.add("Dom7",  { 0, 4, 7, 10 });
+        t.add("Dim7",  { 0, 3, 6, 9 });
+        t.add("hDim7", { 0, 3, 6, 10 });
+        t.add("mM7",   { 0, 3, 7, 11 });
+        t.add("Maj6",  { 0, 4, 7, 9 });
+        t.add("Min6",  { 0, 3, 7, 9 });
+        t.add("Maj9",  { 0, 4, 11, 14 }); // No 5
+        t.add("Min9",  { 0, 3, 10, 14 }); // No 5
+        t.add("7sus",  { 0, 5, 7, 10 });
+        t.add("7#9",   { 0, 4, 10, 15 });
+        return t;
+    }
+
+public:
+    static const ChordTable& builtIn()
+    {
+        static constexpr ChordTable table = makeBuiltIn();
+        return table;
+    }
+};
+
+// Seedable random stream (xoshiro128**)
+// Small and fast enough to give every lane its own, so random lanes draw independently
+// and replay exactly from their seeds.
+struct RandomStream
+{
+    std::array<juce::uint32, 4> state {};
+    
+    // Streams with the same seed but different stream numbers are unrelated
+    void seed(juce::uint32 seedValue, juce::uint32 stream = 0)
+    {
+        // SplitMix64 spreads the seed over the whole state, which then can never be all zero
+        juce::uint64 x = ((juce::uint64)stream << 32) | seedValue;
+        for (size_t i = 0; i < state.size(); i += 2)
         {
-            forceNextStep = false;
+            juce::uint64 z = (x += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            z ^= z >> 31;
+            state[i] = (juce::uint32)z;
+            state[i + 1] = (juce::uint32)(z >> 32);
         }
-        else
+    }
+    
+    juce::uint32 next()
+    {
+        const juce::uint32 result = rotl(state[1] * 5, 7) * 9;
+        const juce::uint32 t = state[1] << 9;
+        
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 11);
+        
+        return result;
+    }
+    
+    // 0 .. maxValue - 1
+    int nextInt(int maxValue)
+    {
+        jassert(maxValue > 0);
+        return (int)(((juce::uint64)next() * (juce::uint64)maxValue) >> 32);
+    }
+    
+    bool nextBool() { return (next() >> 31) != 0; }
+    
+private:
+    static juce::uint32 rotl(juce::uint32 x, int k) { return (x << k) | (x >> (32 - k)); }
+};
+
+// When random streams restart from their seeds during playback
+enum class RandomReseed { Never, EveryBar, EveryLoop };
+
+// All sequencer lanes, stored as structure-of-arrays.
+// Every field is one contiguous array indexed by lane, so the per-step passes below
+// walk plain arrays across all lanes and only touch the fields they need.
+// The switched on lanes are always the first numActiveLanes, the passes stop there.
+template <int MaxSteps>
+struct BasicLaneBank
+{
+    static constexpr int numNoteLanes = 4; // Note, Octave, Velocity, Length
+    static constexpr int numLanes = numNoteLanes + ccLaneCapacity; // Then the CC lanes
+    static constexpr int maxSteps = MaxSteps;
+    using Order = BasicStepOrder<MaxSteps>;
+    
+    template <typename T>
+    using PerLane = std::array<T, (size_t)numLanes>;
+    using LaneMask = juce::uint64; // Bit i = lane i
+    static_assert(numLanes < 64, "LaneMask holds one bit per lane");
+    using StepMask = std::bitset<(size_t)maxSteps>; // Bit i = step i
+    
+    // Note lanes plus the switched on CC lanes; lanes past this are not evaluated at all
+    int numActiveLanes = numNoteLanes + 4;
+    
+    using Direction = LaneDirection;
+    
+    // Value Sequence (Bars)
+    PerLane<std::array<int, (size_t)maxSteps>> values {};
+    PerLane<int> valueLoopLength;
+    PerLane<int> currentValueStep {};
+    PerLane<int> activeValueStep {};
+    
+    // Trigger Sequence (Buttons)
+    PerLane<StepMask> triggers {};
+    PerLane<int> triggerLoopLength;
+    PerLane<int> currentTriggerStep {};
+    PerLane<int> activeTriggerStep {};
+    
+    // Source Toggles, one bit per lane
+    LaneMask masterSourceLanes = 0;  // Yellow Toggle
+    LaneMask localSourceLanes = ~(LaneMask)0; // Colored Toggle
+    
+    PerLane<bool> forceNextStep {};
+    PerLane<bool> resetValuesAtNextBar {};
+    
+    // Reset Intervals (0 = OFF, 1, 2, 4, 8, 16, 32, 64, 128)
+    PerLane<int> valueResetInterval {};
+    PerLane<int> triggerResetInterval {};
+    
+    // Randomization Range (0 = Full Random, >0 = +/- Range)
+    PerLane<int> randomRange {};
+    
+    // Random Streams (Random / RandomDirection), one per lane, restarted from the seed on reset
+    static constexpr juce::uint32 defaultRandomSeed = 1;
+    PerLane<juce::uint32> randomSeed;
+    PerLane<RandomStream> randomStreams;
+    
+    PerLane<Direction> valueDirection;
+    PerLane<Direction> triggerDirection;
+    
+    PerLane<bool> valueMovingForward;
+    PerLane<bool> triggerMovingForward;
+    
+    // MIDI CC (0 = Off, 1-127 = CC Number)
+    PerLane<int> midiCC {};
+    
+    // Output channel (1-16). The note lane's channel is the one notes go out on.
+    PerLane<int> midiChannel;
+    
+    // Smoothing (0-100)
+    PerLane<int> smoothing {};
+    
+    // Cold per-lane state, only touched by CC output and the editor
+    PerLane<CCRampState> ramps;
+    PerLane<juce::Colour> customColor; // If transparent, use default
+    
+    BasicLaneBank()
+    {
+        valueLoopLength.fill(16);
+        triggerLoopLength.fill(16);
+        valueDirection.fill(Direction::Forward);
+        triggerDirection.fill(Direction::Forward);
+        valueMovingForward.fill(true);
+        triggerMovingForward.fill(true);
+        customColor.fill(juce::Colours::transparentBlack);
+        midiChannel.fill(1);
+        randomSeed.fill(defaultRandomSeed);
+        reseedAll();
+    }
+    
+    int getCurrentValue(int lane) const
+    {
+        return values[(size_t)lane][(size_t)currentValueStep[(size_t)lane]];
+    }
+    
+    static int getNextStep(int current, int len, Direction dir, bool& movingForward, RandomStream& r)
+    {
+        if (len <= 1) return 0;
+        
+        switch (dir)
         {
-            auto getNextStep = [&](int current, int len, Direction dir, bool& movingForward) -> int {
-                if (len <= 1) return 0;
+            case Direction::Random:
+                return r.nextInt(len);
+
+            case Direction::RandomDirection:
+            {
+                int stepDir = r.nextBool() ? 1 : -1;
+                return (current + stepDir + len) % len;
+            }
                 
-                switch (dir)
-                {
-                    case Direction::Forward:
-                        return (current + 1) % len;
-                        
-                    case Direction::Backward:
-                        return (current - 1 + len) % len;
-                        
-                    case Direction::PingPong: // 0, 1, 2, 2, 1, 0
-                        if (movingForward) {
-                            if (current >= len - 1) {
-                                movingForward = false;
-                                return current; // Repeat end
-                            }
-                            return current + 1;
-                        } else {
-                            if (current <= 0) {
-                                movingForward = true;
-                                return current; // Repeat start
-                            }
-                            return current - 1;
-                        }
-                        
-                    case Direction::Bounce: // 0, 1, 2, 1, 0
-                        if (movingForward) {
-                            if (current >= len - 1) {
-                                movingForward = false;
-                                return len - 2;
-                            }
-                            return current + 1;
-                        } else {
-                            if (current <= 0) {
-                                movingForward = true;
-                                return 1;
-                            }
-                            return current - 1;
-                        }
-                        
-                    case Direction::Random:
-                        return r.nextInt(len);
-
-                    case Direction::RandomDirection:
-                        int stepDir = r.nextBool() ? 1 : -1;
-                        return (current + stepDir + len) % len;
-                }
-                return 0;
-            };
-            
-            currentValueStep = getNextStep(currentValueStep, valueLoopLength, valueDirection, valueMovingForward);
+            case Direction::Forward:
+            case Direction::Backward:
+            case Direction::PingPong:
+            case Direction::Bounce:
+                break;
         }
+        
+        return Order::advance(current, len, dir, movingForward, 1);
     }
     
-    void advanceTrigger(juce::Random& r)
+    void advanceValue(int lane)
     {
-        auto getNextStep = [&](int current, int len, Direction dir, bool& movingForward) -> int {
-            if (len <= 1) return 0;
-            
-            switch (dir)
-            {
-                case Direction::Forward:
-                    return (current + 1) % len;
-                    
-                case Direction::Backward:
-                    return (current - 1 + len) % len;
-                    
-                case Direction::PingPong:
-                    if (movingForward) {
-                        if (current >= len - 1) {
-                            movingForward = false;
-                            return current; // Repeat end
-                        }
-                        return current + 1;
-                    } else {
-                        if (current <= 0) {
-                            movingForward = true;
-                            return current; // Repeat start
-                        }
-                        return current - 1;
-                    }
-                    
-                case Direction::Bounce:
-                    if (movingForward) {
-                        if (current >= len - 1) {
-                            movingForward = false;
-                            return len - 2;
-                        }
-                        return current + 1;
-                    } else {
-                        if (current <= 0) {
-                            movingForward = true;
-                            return 1;
-                        }
-                        return current - 1;
-                    }
-                    
-                case Direction::Random:
-                    return r.nextInt(len);
-
-                case Direction::RandomDirection:
-                    int stepDir = r.nextBool() ? 1 : -1;
-                    return (current + stepDir + len) % len;
-            }
-            return 0;
-        };
+        const auto i = (size_t)lane;
+        if (forceNextStep[i])
+        {
+            forceNextStep[i] = false;
+            return;
+        }
         
-        currentTriggerStep = getNextStep(currentTriggerStep, triggerLoopLength, triggerDirection, triggerMovingForward);
+        bool movingForward = valueMovingForward[i];
+        currentValueStep[i] = getNextStep(currentValueStep[i], valueLoopLength[i], valueDirection[i], movingForward, randomStreams[i]);
+        valueMovingForward[i] = movingForward;
     }
-
-    void reset() { 
-        currentValueStep = valueLoopLength - 1; 
-        activeValueStep = 0; 
-        currentTriggerStep = 0;
-        activeTriggerStep = 0;
-        forceNextStep = false; 
-        valueMovingForward = true;
-        triggerMovingForward = true;
+    
+    void advanceTrigger(int lane)
+    {
+        const auto i = (size_t)lane;
+        bool movingForward = triggerMovingForward[i];
+        currentTriggerStep[i] = getNextStep(currentTriggerStep[i], triggerLoopLength[i], triggerDirection[i], movingForward, randomStreams[i]);
+        triggerMovingForward[i] = movingForward;
+    }
+    
+    void reset(int lane)
+    {
+        const auto i = (size_t)lane;
+        currentValueStep[i] = valueLoopLength[i] - 1;
+        activeValueStep[i] = 0;
+        currentTriggerStep[i] = 0;
+        activeTriggerStep[i] = 0;
+        forceNextStep[i] = false;
+        valueMovingForward[i] = true;
+        triggerMovingForward[i] = true;
+    }
+    
+    void resetAll()
+    {
+        for (int lane = 0; lane < numActiveLanes; ++lane)
+            reset(lane);
+    }
+    
+    void reseed(int lane)
+    {
+        randomStreams[(size_t)lane].seed(randomSeed[(size_t)lane], (juce::uint32)lane);
+    }
+    
+    void reseedAll()
+    {
+        for (int lane = 0; lane < numActiveLanes; ++lane)
+            reseed(lane);
+    }
+    
+    // Another bank's steps and lane settings; the playheads, random streams and ramps stay
+    void copyPattern(const BasicLaneBank& other)
+    {
+        numActiveLanes = other.numActiveLanes;
+        values = other.values;
+        valueLoopLength = other.valueLoopLength;
+        triggers = other.triggers;
+        triggerLoopLength = other.triggerLoopLength;
+        masterSourceLanes = other.masterSourceLanes;
+        localSourceLanes = other.localSourceLanes;
+        valueResetInterval = other.valueResetInterval;
+        triggerResetInterval = other.triggerResetInterval;
+        randomRange = other.randomRange;
+        randomSeed = other.randomSeed;
+        valueDirection = other.valueDirection;
+        triggerDirection = other.triggerDirection;
+        midiCC = other.midiCC;
+        midiChannel = other.midiChannel;
+        smoothing = other.smoothing;
+        customColor = other.customColor;
     }
     
-    void shiftValues(int delta)
+    void shiftValues(int lane, int delta)
     {
-        if (valueLoopLength < 2) return;
-        int len = valueLoopLength;
+        int len = valueLoopLength[(size_t)lane];
+        if (len < 2) return;
         // Normalize delta
         delta = delta % len;
         if (delta < 0) delta += len;
         
         // Rotate right by delta
-        auto start = values.begin();
-        auto end = values.begin() + len;
+        auto start = values[(size_t)lane].begin();
+        auto end = start + len;
         std::rotate(start, end - delta, end);
     }
     
-    void shiftTriggers(int delta)
+    void shiftTriggers(int lane, int delta)
     {
-        if (triggerLoopLength < 2) return;
-        int len = triggerLoopLength;
-        delta = delta % len;
-        if (delta < 0) delta += len;
+        rotateSteps(triggers[(size_t)lane], triggerLoopLength[(size_t)lane], delta);
+    }
+    
+    bool usesMasterSource(int lane) const { return (masterSourceLanes >> lane) & 1; }
+    bool usesLocalSource(int lane) const { return (localSourceLanes >> lane) & 1; }
+    
+    void setMasterSource(int lane, bool enabled) { setLaneBit(masterSourceLanes, lane, enabled); }
+    void setLocalSource(int lane, bool enabled) { setLaneBit(localSourceLanes, lane, enabled); }
+    
+    LaneMask getActiveLaneMask() const { return ((LaneMask)1 << numActiveLanes) - 1; }
+    
+    // Per-Step Kernels
+    // Each one is a single pass over the active lanes, in index order.
+    
+    // Lanes hit by the master row (when masterHit) or by their own trigger on the current trigger step.
+    // The one per-lane read gathers the trigger bits into a lane mask; the source toggles then
+    // resolve every lane at once.
+    LaneMask getHitMask(bool masterHit) const
+    {
+        LaneMask localHits = 0;
+        for (size_t i = 0; i < (size_t)numActiveLanes; ++i)
+            localHits |= (LaneMask)triggers[i][(size_t)currentTriggerStep[i]] << i;
         
-        auto start = triggers.begin();
-        auto end = triggers.begin() + len;
-        std::rotate(start, end - delta, end);
+        const LaneMask masterHits = masterHit ? masterSourceLanes : 0;
+        return (masterHits | (localHits & localSourceLanes)) & getActiveLaneMask();
+    }
+    
+    void advanceValues(LaneMask lanesToAdvance)
+    {
+        for (int lane = 0; lane < numActiveLanes; ++lane)
+            if ((lanesToAdvance >> lane) & 1)
+                advanceValue(lane);
+    }
+    
+    void advanceTriggers(LaneMask lanesToAdvance = ~(LaneMask)0)
+    {
+        for (int lane = 0; lane < numActiveLanes; ++lane)
+            if ((lanesToAdvance >> lane) & 1)
+                advanceTrigger(lane);
+    }
+    
+    // Publish the current positions as the active (sounding) steps
+    void latchActiveSteps(LaneMask lanesToLatch = ~(LaneMask)0)
+    {
+        for (size_t i = 0; i < (size_t)numActiveLanes; ++i)
+        {
+            if ((lanesToLatch >> i) & 1)
+            {
+                activeValueStep[i] = currentValueStep[i];
+                activeTriggerStep[i] = currentTriggerStep[i];
+            }
+        }
+    }
+    
+    void applyIntervalResets(long long barIndex, LaneMask lanesToReset = ~(LaneMask)0)
+    {
+        for (size_t i = 0; i < (size_t)numActiveLanes; ++i)
+        {
+            if (((lanesToReset >> i) & 1) == 0) continue;
+            
+            // Value Reset
+            if (valueResetInterval[i] > 0 && barIndex % valueResetInterval[i] == 0)
+            {
+                currentValueStep[i] = 0;
+                activeValueStep[i] = 0;
+                valueMovingForward[i] = true;
+            }
+            // Trigger Reset (Step Progression): restart the trigger sequence at the bar
+            if (triggerResetInterval[i] > 0 && barIndex % triggerResetInterval[i] == 0)
+            {
+                currentTriggerStep[i] = 0;
+                triggerMovingForward[i] = true;
+            }
+        }
+    }
+    
+    void applyBarResets()
+    {
+        for (size_t i = 0; i < (size_t)numActiveLanes; ++i)
+        {
+            if (resetValuesAtNextBar[i])
+            {
+                currentValueStep[i] = valueLoopLength[i] - 1;
+                activeValueStep[i] = 0;
+                resetValuesAtNextBar[i] = false;
+            }
+        }
+    }
+    
+private:
+    static void setLaneBit(LaneMask& mask, int lane, bool enabled)
+    {
+        if (enabled) mask |= (LaneMask)1 << lane;
+        else mask &= ~((LaneMask)1 << lane);
     }
 };
 
-struct PatternData
+// Stored Patterns
+// Bank slots hold patterns packed: values in a signed byte, trigger rows as step bits, the
+// directions and the channel in nibbles. The whole pattern is trivially copyable, so publishing
+// the banks is a flat copy, and loading one into a track is a short decode of each lane.
+template <int MaxSteps>
+struct BasicPatternData
 {
+    static constexpr int maxSteps = MaxSteps;
+    using Lanes = BasicLaneBank<MaxSteps>;
+    using StepMask = typename Lanes::StepMask;
+    
     bool isEmpty = true;
     
     // Master
-    std::array<bool, 16> masterTriggers;
-    std::array<bool, 16> masterProbEnabled; // Probability Step Toggle
+    StepMask masterTriggers {};
+    StepMask masterProbEnabled {}; // Probability Step Toggle
     int masterLength = 16;
     int shuffleAmount = 1;
     int masterProbability = 100; // 0-100%
     juce::uint32 masterColor = 0; // 0 = Transparent/Default
+    juce::uint32 probabilitySeed = 1;
+    int randomReseed = 0; // Stored as int
     
-    // Lanes
+    // Unpacked lane settings, as the XML / JSON state reads and writes them
     struct LaneData {
-        std::array<int, 16> values;
-        std::array<bool, 16> triggers;
+        std::array<int, (size_t)maxSteps> values {};
+        StepMask triggers {};
         int valueLoopLength = 16;
         int triggerLoopLength = 16;
         int valueResetInterval = 0;
         int triggerResetInterval = 0;
         int randomRange = 0;
+        juce::uint32 randomSeed = Lanes::defaultRandomSeed;
         bool enableMasterSource = false;
         bool enableLocalSource = true;
         int valueDirection = 0; // Stored as int
         int triggerDirection = 0;
         int midiCC = 0;
+        int midiChannel = 1;
         int smoothing = 0;
         juce::uint32 customColor = 0; // 0 = Transparent/Default
     };
     
-    LaneData noteLane;
-    LaneData octaveLane;
-    LaneData velocityLane;
-    LaneData lengthLane;
+    // One lane as stored in the bank. Every setting fits a byte or a nibble; out of range
+    // settings are clamped on the way in.
+    struct PackedLane
+    {
+        static constexpr juce::uint8 masterSourceFlag = 0x10;
+        static constexpr juce::uint8 localSourceFlag = 0x20;
+        
+        std::array<juce::int8, (size_t)maxSteps> values {};
+        StepMask triggers {};
+        juce::uint32 randomSeed = Lanes::defaultRandomSeed;
+        juce::uint32 customColor = 0;
+        juce::uint8 valueLoopLength = 16;
+        juce::uint8 triggerLoopLength = 16;
+        juce::uint8 valueResetInterval = 0;
+        juce::uint8 triggerResetInterval = 0;
+        juce::uint8 randomRange = 0;
+        juce::uint8 midiCC = 0;
+        juce::uint8 smoothing = 0;
+        juce::uint8 directions = 0; // Value direction in the low nibble, trigger direction in the high one
+        juce::uint8 flags = localSourceFlag; // Channel - 1 in the low nibble, then the source toggles
+        
+        static juce::uint8 toByte(int value) { return (juce::uint8)juce::jlimit(0, 255, value); }
+        
+        int getValue(size_t step) const { return values[step]; }
+        void setValue(size_t step, int value) { values[step] = (juce::int8)juce::jlimit(-128, 127, value); }
+        
+        int getValueDirection() const { return directions & 0x0f; }
+        int getTriggerDirection() const { return directions >> 4; }
+        void setDirections(int valueDirection, int triggerDirection)
+        {
+            directions = (juce::uint8)((valueDirection & 0x0f) | ((triggerDirection & 0x0f) << 4));
+        }
+        
+        int getMidiChannel() const { return (flags & 0x0f) + 1; }
+        bool usesMasterSource() const { return (flags & masterSourceFlag) != 0; }
+        bool usesLocalSource() const { return (flags & localSourceFlag) != 0; }
+        void setChannelAndSources(int midiChannel, bool master, bool local)
+        {
+            flags = (juce::uint8)((juce::jlimit(1, 16, midiChannel) - 1)
+                                  | (master ? masterSourceFlag : 0)
+                                  | (local ? localSourceFlag : 0));
+        }
+    };
+    
+    std::array<PackedLane, Lanes::numLanes> lanes; // In LaneIndex order
+
+    // User chord set for CHORD lanes while this pattern is loaded, empty = built-in chords
+    ChordTable chords;
+    
+    LaneData getLane(size_t lane) const
+    {
+        const auto& src = lanes[lane];
+        LaneData dst;
+        for (size_t step = 0; step < (size_t)maxSteps; ++step) dst.values[step] = src.getValue(step);
+        dst.triggers = src.triggers;
+        dst.valueLoopLength = src.valueLoopLength;
+        dst.triggerLoopLength = src.triggerLoopLength;
+        dst.valueResetInterval = src.valueResetInterval;
+        dst.triggerResetInterval = src.triggerResetInterval;
+        dst.randomRange = src.randomRange;
+        dst.randomSeed = src.randomSeed;
+        dst.enableMasterSource = src.usesMasterSource();
+        dst.enableLocalSource = src.usesLocalSource();
+        dst.valueDirection = src.getValueDirection();
+        dst.triggerDirection = src.getTriggerDirection();
+        dst.midiCC = src.midiCC;
+        dst.midiChannel = src.getMidiChannel();
+        dst.smoothing = src.smoothing;
+        dst.customColor = src.customColor;
+        return dst;
+    }
+    
+    void setLane(size_t lane, const LaneData& src)
+    {
+        auto& dst = lanes[lane];
+        for (size_t step = 0; step < (size_t)maxSteps; ++step) dst.setValue(step, src.values[step]);
+        dst.triggers = src.triggers;
+        dst.valueLoopLength = PackedLane::toByte(src.valueLoopLength);
+        dst.triggerLoopLength = PackedLane::toByte(src.triggerLoopLength);
+        dst.valueResetInterval = PackedLane::toByte(src.valueResetInterval);
+        dst.triggerResetInterval = PackedLane::toByte(src.triggerResetInterval);
+        dst.randomRange = PackedLane::toByte(src.randomRange);
+        dst.randomSeed = src.randomSeed;
+        dst.setDirections(src.valueDirection, src.triggerDirection);
+        dst.midiCC = PackedLane::toByte(src.midiCC);
+        dst.setChannelAndSources(src.midiChannel, src.enableMasterSource, src.enableLocalSource);
+        dst.smoothing = PackedLane::toByte(src.smoothing);
+        dst.customColor = src.customColor;
+    }
+    
+    // Encodes every lane of a bank
+    void storeLanes(const Lanes& bank)
+    {
+        for (size_t i = 0; i < (size_t)Lanes::numLanes; ++i)
+            storeLane(i, bank);
+    }
+    
+    void storeLane(size_t i, const Lanes& bank)
+    {
+        auto& dst = lanes[i];
+        for (size_t step = 0; step < (size_t)maxSteps; ++step) dst.setValue(step, bank.values[i][step]);
+        dst.triggers = bank.triggers[i];
+        dst.valueLoopLength = PackedLane::toByte(bank.valueLoopLength[i]);
+        dst.triggerLoopLength = PackedLane::toByte(bank.triggerLoopLength[i]);
+        dst.valueResetInterval = PackedLane::toByte(bank.valueResetInterval[i]);
+        dst.triggerResetInterval = PackedLane::toByte(bank.triggerResetInterval[i]);
+        dst.randomRange = PackedLane::toByte(bank.randomRange[i]);
+        dst.randomSeed = bank.randomSeed[i];
+        dst.setDirections((int)bank.valueDirection[i], (int)bank.triggerDirection[i]);
+        dst.midiCC = PackedLane::toByte(bank.midiCC[i]);
+        dst.setChannelAndSources(bank.midiChannel[i], bank.usesMasterSource((int)i), bank.usesLocalSource((int)i));
+        dst.smoothing = PackedLane::toByte(bank.smoothing[i]);
+        dst.customColor = bank.customColor[i].getARGB();
+    }
     
-    LaneData ccLane1;
-    LaneData ccLane2;
-    LaneData ccLane3;
-    LaneData ccLane4;
+    // Decodes every lane into a bank, leaving its playback positions alone.
+    // Allocation free, the audio thread calls this on a pattern load.
+    void recallLanes(Lanes& bank) const
+    {
+        for (size_t i = 0; i < (size_t)Lanes::numLanes; ++i)
+        {
+            const auto& src = lanes[i];
+            std::copy(src.values.begin(), src.values.end(), bank.values[i].begin());
+            bank.triggers[i] = src.triggers;
+            bank.valueLoopLength[i] = juce::jlimit(1, maxSteps, (int)src.valueLoopLength);
+            bank.triggerLoopLength[i] = juce::jlimit(1, maxSteps, (int)src.triggerLoopLength);
+            bank.valueResetInterval[i] = src.valueResetInterval;
+            bank.triggerResetInterval[i] = src.triggerResetInterval;
+            bank.randomRange[i] = src.randomRange;
+            bank.randomSeed[i] = src.randomSeed;
+            bank.valueDirection[i] = (LaneDirection)src.getValueDirection();
+            bank.triggerDirection[i] = (LaneDirection)src.getTriggerDirection();
+            bank.midiCC[i] = src.midiCC;
+            bank.midiChannel[i] = src.getMidiChannel();
+            bank.setMasterSource((int)i, src.usesMasterSource());
+            bank.setLocalSource((int)i, src.usesLocalSource());
+            bank.smoothing[i] = src.smoothing;
+            bank.customColor[i] = juce::Colour(src.customColor);
+        }
+    }
+};
+
+using LaneBank = BasicLaneBank<stepCapacity>;
+using PatternData = BasicPatternData<stepCapacity>;
+static_assert(std::is_trivially_copyable<PatternData>::value, "Pattern banks are copied as flat memory");
+
+// One sequencer track: a master row and the lanes it drives.
+// Tracks share the processor's clock, MIDI input and voice pool; everything that moves
+// with one track's steps lives here.
+struct SequencerTrack
+{
+    // Master Row
+    LaneBank::StepMask masterTriggers {};
+    LaneBank::StepMask masterProbEnabled {};
+    int masterLength = 16;
+    int masterProbability = 100; // 0-100%
+    juce::Colour masterColor = juce::Colours::transparentBlack;
+    
+    // Master probability rolls draw from their own stream, apart from the lanes
+    RandomStream probabilityRandom;
+    juce::uint32 probabilitySeed = 1;
+    RandomReseed randomReseed = RandomReseed::Never;
+    
+    LaneBank lanes;
+    
+    // Playback
+    int currentMasterStep = 0;
+    LaneBank::LaneMask lanesToSeek = 0; // Switched on while playing, sought to the next step before it plays
+    long long globalStepOffset = 0;
+    int loadedBank = -1;
+    int loadedSlot = -1;
+    
+    // Hold Logic State
+    bool isHoldActive = false;
+    int lastTriggeredGroupID = -1;
+    int lastTriggeredGroupHead = -1; // First note of lastTriggeredGroupID, linked through nextInGroup
+    
+    int getNumCCLanes() const { return lanes.numActiveLanes - LaneBank::numNoteLanes; }
+    
+    int getMasterStepIndex(long long step) const
+    {
+        const int len = juce::jmax(1, masterLength);
+        return (int)((step + globalStepOffset) % len + len) % len;
+    }
+};
+
+// A single edit sent from the message thread to the audio thread.
+// Everything the UI changes on a lane or the master row travels as one of these
+// and is applied at the start of the next block, never mid-block.
+struct LaneEditCommand
+{
+    enum class Type
+    {
+        // Lane edits (lane = lane index)
+        SetValues,              // steps = all values (one drag stroke)
+        SetTriggers,            // steps = all triggers as 0/1 (one drag stroke)
+        SetValueLoopLength,     // value
+        SetTriggerLoopLength,   // value
+        SetValueDirection,      // value = Direction
+        SetTriggerDirection,    // value = Direction
+        SetValueResetInterval,  // value
+        SetTriggerResetInterval,// value
+        SetRandomRange,         // value
+        SetEnableMasterSource,  // value = 0/1
+        SetEnableLocalSource,   // value = 0/1
+        SetMidiCC,              // value
+        SetMidiChannel,         // value = 1-16
+        SetSmoothing,           // value
+        SetRandomSeed,          // value = seed bits
+        ShiftValues,            // value = delta
+        ShiftTriggers,          // value = delta
+        SetValueIndex,          // value = target step
+        SetTriggerIndex,        // value = target step
+        ResetLane,              // value = default value
+        SyncLaneToBar,
+        SetCustomColor,         // value = ARGB, transparent for the lane's default colour
+        
+        // Master edits (lane ignored)
+        SetMasterSteps,         // steps = bit 0 trigger, bit 1 probability
+        SetMasterLength,        // value
+        SetMasterProbability,   // value
+        ShiftMasterTriggers,    // value = delta
+        SetGlobalStepIndex,     // value = target step
+        ClearMasterTriggers,
+        SetMidiGateMode,        // value = 0/1
+        SetLoadedPattern,       // value = bank * 16 + slot
+        SetMaxPolyphony,        // value
+        SetVoiceStealMode,      // value = VoiceStealMode
+        SetProbabilitySeed,     // value = seed bits
+        SetRandomReseed,        // value = RandomReseed
+        SetMasterColor,         // value = ARGB, transparent for the default colour
+        SetNumCCLanes,          // value = switched on CC lanes, 0-maxCCLanes
+        SetNumTracks,           // value = playing tracks, 1-maxTracks (track ignored)
+        RestoreSession,         // Takes over the next restored session (track ignored)
+        ResetAllLanes
+    };
+    
+    Type type = Type::SetValues;
+    int track = 0; // Lane and master edits apply to this track
+    int lane = 0;
+    int value = 0;
+    std::array<int, (size_t)stepCapacity> steps {};
+    juce::uint32 patternLoads = 0; // The track's pattern loads the edit was made after, stamped by sendLaneEdit
+};
+
+// Pattern records restored from a saved state, kept serialized until their slot is first used.
+// Immutable once built; the message thread and the snapshots share it.
+struct EncodedPatterns
+{
+    struct Record { int offset = 0; int size = 0; };
+    
+    int numSteps = stepCapacity; // Capacities the records were written with
+    int numLanes = LaneBank::numLanes;
+    juce::MemoryBlock records; // Every record back to back
+    std::array<std::array<Record, 16>, 4> slots {};
+};
+
+// Copy of all pattern banks, handed to the audio thread by pointer swap.
+// Slots flagged in encodedSlots hold a placeholder; the audio thread decodes one from
+// encoded the first time it loads it, which is the only change it makes to its copy.
+struct PatternBankSnapshot
+{
+    std::array<std::array<PatternData, 16>, 4> banks;
+    std::shared_ptr<const EncodedPatterns> encoded;
+    std::bitset<64> encodedSlots; // Bit bank * 16 + slot
 };
 
 class ShequencerAudioProcessor  : public juce::AudioProcessor
@@ -292,104 +1047,425 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
 
     // Sequencer Data
-    std::array<bool, 16> masterTriggers;
-    std::array<bool, 16> masterProbEnabled;
-    int masterLength = 16;
     int shuffleAmount = 1; // 1 (Straight) to 7 (Max Swing)
-    int masterProbability = 100; // 0-100%
-    juce::Colour masterColor = juce::Colours::transparentBlack;
     int activeShuffleAmount = 1; // Used for audio processing to ensure safe updates
     bool isShuffleGlobal = true;
     
-    juce::Random random; // Member random object for audio thread safety
-
-    SequencerLane noteLane;
-    SequencerLane octaveLane;
-    SequencerLane velocityLane;
-    SequencerLane lengthLane;
+    static constexpr juce::uint32 probabilityStream = 0xffff; // Past every lane's stream number, whatever the lane capacity
+    
+    // Tracks
+    // Every track plays its own master row and lanes on the shared clock below, into the
+    // same MIDI output. Tracks from numTracks on are switched off and cost nothing.
+    static constexpr int maxTracks = trackCapacity;
+    std::array<SequencerTrack, (size_t)maxTracks> tracks;
+    int numTracks = 1;
     
-    SequencerLane ccLane1;
-    SequencerLane ccLane2;
-    SequencerLane ccLane3;
-    SequencerLane ccLane4;
+    // The track the editor shows and edits (message thread only), from the edited copy below
+    int editedTrack = 0;
+    const SequencerTrack& getEditedTrack() const { return edited.tracks[(size_t)editedTrack]; }
+    
+    enum LaneIndex
+    {
+        noteLaneIndex, octaveLaneIndex, velocityLaneIndex, lengthLaneIndex,
+        firstCCLaneIndex // CC lane n (from 0) is firstCCLaneIndex + n
+    };
+    static constexpr int numLanes = LaneBank::numLanes;
+    static constexpr int maxSteps = LaneBank::maxSteps;
+    static constexpr int maxCCLanes = ccLaneCapacity;
+    static_assert(firstCCLaneIndex == LaneBank::numNoteLanes, "LaneIndex has to name every note lane of the bank");
+    
+    // Playback State (audio thread -> editor)
+    // One compact copy per block, handed over through a triple buffer so the editor
+    // always sees a consistent set of positions without touching the engine state.
+    struct PlaybackState
+    {
+        struct Track
+        {
+            int currentMasterStep = 0;
+            int loadedBank = -1;
+            int loadedSlot = -1;
+            int numCCLanes = 4;
+            std::array<int, numLanes> activeValueStep {};
+            std::array<int, numLanes> activeTriggerStep {};
+        };
+        
+        juce::uint32 version = 0;
+        int numTracks = 1;
+        std::array<Track, (size_t)maxTracks> tracks;
+    };
+    const PlaybackState& getPlaybackState(); // Message thread only
+    const PlaybackState::Track& getEditedTrackState() { return getPlaybackState().tracks[(size_t)editedTrack]; }
+    
+    // Lane Edits (message thread -> audio thread)
+    // Returns a ticket that can be checked with isLaneEditApplied, or 0 if the queue was full.
+    // The short form addresses the edited track.
+    juce::uint32 sendLaneEdit(const LaneEditCommand& command);
+    juce::uint32 sendLaneEdit(LaneEditCommand::Type type, int lane, int value = 0);
+    bool isLaneEditApplied(juce::uint32 ticket) const;
+    
+    // Step columns the editor shows for the edited track: the longest loop rounded up to a whole bar of 16, at least 16
+    int getVisibleStepCount() const;
     
     // Pattern Management
+    // patternBanks is the editable copy and belongs to the message thread.
+    // The audio thread only ever reads published snapshots (see publishPatternBanks).
+    // Slots restored from a saved state stay encoded (placeholders here, isEmpty already
+    // right) until first used, so a session opens without decoding the whole library.
     std::array<std::array<PatternData, 16>, 4> patternBanks; // 4 Banks of 16 Patterns
     int currentBank = 0;
-    int loadedBank = -1;
-    int loadedSlot = -1;
     
-    juce::CriticalSection patternLock;
-    std::atomic<int> pendingLoadBank{ -1 };
-    std::atomic<int> pendingLoadSlot{ -1 };
+    juce::CriticalSection patternLock; // Guards patternBanks between UI and host state calls, never taken by the audio thread
+    std::array<std::atomic<int>, (size_t)maxTracks> pendingPatternLoads; // Per track, bank * 16 + slot or -1
     
+    // A pattern holds one track: saving reads the edited track, loading replaces one track
     void savePattern(int bank, int slot);
-    void loadPattern(int bank, int slot);
+    void loadPattern(int bank, int slot); // Into the edited track
+    void loadPattern(int bank, int slot, int track);
     void applyPendingPatternLoad();
     void clearPattern(int bank, int slot);
     
+    // Every bank as one JSON file. Loading replaces all stored patterns at once, or none when
+    // the file does not parse.
     void saveAllPatternsToJson(const juce::File& file);
     void loadAllPatternsFromJson(const juce::File& file);
     
+    // Chord Sets
+    // A JSON chord set ({ "chords": [ { "name": "Maj", "notes": [0, 4, 7] }, ... ] }) is compiled
+    // into the pattern's ChordTable. Returns false for an empty slot.
+    bool loadChordSet(int bank, int slot, const juce::File& file);
+    const ChordTable& getLoadedChordTable(); // Message thread only, follows the edited track's loaded pattern
+    
+    // UI Requests (queued as lane edits)
     void shiftMasterTriggers(int delta);
     
     void setGlobalStepIndex(int targetIndex);
-    void setLaneTriggerIndex(SequencerLane& lane, int targetIndex);
-    void setLaneValueIndex(SequencerLane& lane, int targetIndex);
+    void setLaneTriggerIndex(int laneIndex, int targetIndex);
+    void setLaneValueIndex(int laneIndex, int targetIndex);
     
-    void resetLane(SequencerLane& lane, int defaultValue);
+    void resetLane(int laneIndex, int defaultValue);
     void resetAllLanes();
+    void setNumCCLanes(int numCCLanes);
+    void setNumTracks(int newNumTracks);
     
     // Sync Logic
-    void syncLaneToBar(SequencerLane& lane);
-    void syncAllToBar();
+    void syncLaneToBar(int laneIndex);
+    
+    // Random Seeds
+    void newRandomSeeds(); // Fresh seeds for every lane and the probability rolls
 
     // Playback State
-    int currentMasterStep = 0;
-    long long globalStepOffset = 0;
     long long lastAbsStep = 0;
-    double currentPositionInQuarterNotes = 0.0;
-    double lastPositionInQuarterNotes = 0.0;
     
-    // Hold Logic State
-    bool isHoldActive = false;
-    int lastTriggeredNoteIndex = -1;
+    // Musical Clock
+    // Positions are integer ticks from the host's zero position. The host position is converted
+    // once per block; steps, shuffle and note-offs are scheduled in ticks and only turned into
+    // sample offsets when an event is written.
+    static constexpr int ticksPerQuarterNote = 960;
+    static constexpr int ticksPerStep = ticksPerQuarterNote / 4;     // 16th note
+    static constexpr int maxShuffleTicks = ticksPerQuarterNote / 8;  // 32nd note, at shuffle 7
+    
+    static long long ppqToTicks(double ppq) { return (long long)std::llround(ppq * ticksPerQuarterNote); }
+    static long long floorDiv(long long a, long long b) { return a / b - ((a % b != 0 && (a < 0) != (b < 0)) ? 1 : 0); }
+    long long getBarLengthTicks() const { return (long long)ticksPerQuarterNote * 4 * sigNumerator / juce::jmax(1, sigDenominator); }
+    
+    // Where the bars fall on the step grid: bar barIndex starts at barStartTick and every
+    // bar is barTicks long. A step belongs to the bar its unshuffled tick lies in.
+    struct BarGrid
+    {
+        long long barStartTick = 0;
+        long long barIndex = 0;
+        long long barTicks = ticksPerQuarterNote * 4;
+        
+        long long getBarOfStep(long long step) const { return barIndex + floorDiv(step * ticksPerStep - barStartTick, barTicks); }
+        long long getFirstStepOfBar(long long bar) const { return -floorDiv(-(barStartTick + (bar - barIndex) * barTicks), ticksPerStep); }
+        bool isFirstStepOfBar(long long step) const { return getBarOfStep(step) != getBarOfStep(step - 1); }
+        
+        // First step of the latest bar at or before the step's bar whose index is a multiple of interval
+        long long getLastResetStep(long long step, int interval) const { return getFirstStepOfBar(floorDiv(getBarOfStep(step), interval) * interval); }
+    };
+    
+    // Step Scheduler (next step to play, carried across blocks)
+    long long nextStepIndex = -1; // -1 = look it up from the host position
+    long long nextStepTick = 0;   // Shuffle included
+    static constexpr long long maxPositionDrift = 1; // Ticks, larger jumps between blocks are treated as a seek
+    
+    // Sequencer sample clock for CC ramps, advances only while the sequencer is running
+    long long sequencerSampleCount = 0;
+    static constexpr double ccRampMinInterval = 0.003; // Seconds between smoothed CC messages
+    
+    long long lastPositionTick = 0; // End of the last block
     
     // Timing Info for Sync
-    double lastBarStartPPQ = 0.0;
+    long long lastBarStartTick = 0;
     int sigNumerator = 4;
     int sigDenominator = 4;
     
     bool isPlaying = false;
-    bool waitingForBarSync = false;
 
     // Transposition
     int transposeOffset = 0;
     
     // Gate Mode
     bool isMidiGateMode = false;
-    std::set<int> heldMidiNotes;
+    std::bitset<128> heldMidiNotes;
     bool pendingMidiTrigger = false;
+    
+    int getHighestHeldMidiNote() const;
 
-    // Note Off Management
+    // Voice Management
+    // Oldest: steal the longest sounding note
+    // Quietest: steal the lowest velocity note (oldest first on ties)
+    // SameGroup: release the whole chord of the oldest note, so chords never sound partially
+    enum class VoiceStealMode { Oldest, Quietest, SameGroup };
+    
     struct ActiveNote
     {
         bool isActive = false;
         int noteNumber = 0;
         int midiChannel = 1;
-        double noteOffPosition = 0.0; // In quarter notes
+        int velocity = 0;
+        juce::uint32 startOrder = 0; // Orders simultaneous note-offs
+        long long noteOffTick = 0;
         int groupID = -1; // For polyphonic hold
+        int track = 0;    // Track that played the note, owns the group
         
         // MIDI Gate Sustain
         bool isMidiSustain = false;
         int sourceMidiNote = -1;
+        
+        // Scheduler links (indices into activeNotes, -1 = none)
+        int heapIndex = -1; // Position in noteOffHeap, -1 while sustained by MIDI
+        int prevInGroup = -1, nextInGroup = -1;
+        int prevSamePitch = -1, nextSamePitch = -1;
+        int prevByAge = -1, nextByAge = -1;
+        int nextFree = -1;
     };
     static constexpr int maxActiveNotes = 64;
     std::array<ActiveNote, maxActiveNotes> activeNotes;
     
-    int currentGroupID = 0;
-    int lastTriggeredGroupID = -1;
+    // Set through LaneEditCommand::SetMaxPolyphony / SetVoiceStealMode
+    int maxPolyphony = maxActiveNotes;
+    VoiceStealMode voiceStealMode = VoiceStealMode::Oldest;
+    
+    // Edited Copy (message thread)
+    // The tracks and settings as the editor has set them. sendLaneEdit applies every edit here
+    // before queueing it, so this copy is level with or ahead of the audio thread's and the editor
+    // and savePattern read it instead of the engine state. Pattern loads the audio thread makes
+    // (MIDI pattern select included) come in through syncEditedTracks; pattern edits queued
+    // against the pattern a load replaced are dropped on both sides. Guarded by patternLock.
+    struct EditedState
+    {
+        std::array<SequencerTrack, (size_t)maxTracks> tracks;
+        int numTracks = 1;
+        int maxPolyphony = maxActiveNotes;
+        VoiceStealMode voiceStealMode = VoiceStealMode::Oldest;
+        bool isMidiGateMode = false;
+        std::array<juce::uint32, (size_t)maxTracks> patternLoads {}; // The audio thread's load stamps the copy has taken
+    };
+    const EditedState& getEditedState() const { return edited; }
+    void syncEditedTracks();
+    
+    bool isNoteSounding(int midiChannel, int noteNumber) const;
+    
+    int currentGroupID = 0; // Last group started, on any track
 
 private:
+    // Real-Time Scratch Storage
+    // Everything processBlock needs is sized here (or in prepareToPlay) so the
+    // audio thread never touches the heap.
+    struct MidiEvent {
+        enum class Type { GateOn, GateOff, Transpose, SelectPattern };
+        int sampleOffset;
+        Type type;
+        int noteNumber;
+        int track; // SelectPattern only
+    };
+    static constexpr int maxMidiEventsPerBlock = 256;
+    std::array<MidiEvent, maxMidiEventsPerBlock> midiEvents;
+    int numMidiEvents = 0;
+    int nextMidiEvent = 0;
+    
+    juce::MidiBuffer scratchMidi;
+    int preparedBlockSize = 0;
+    
+    // Note Off Scheduler
+    // Min-heap of active note indices ordered by noteOffTick, plus per-pitch lists,
+    // so expiry and overlap checks only touch the notes involved.
+    std::array<int, maxActiveNotes> noteOffHeap;
+    int noteOffHeapSize = 0;
+    std::array<std::array<int, 128>, 16> notesByPitch; // [channel - 1][note], head of each pitch's list, -1 = silent
+    
+    // Voice Allocation
+    int firstFreeNote = -1;
+    int numActiveNotes = 0;
+    int oldestNote = -1; // Age list, linked through nextByAge
+    int newestNote = -1;
+    juce::uint32 noteStartCounter = 0;
+    
+    int allocateNote(juce::MidiBuffer& midi, int sampleOffset); // Steals when the polyphony limit is reached
+    int chooseNoteToSteal() const;
+    void startActiveNote(int index);
+    void stopActiveNote(int index);
+    void stopAllActiveNotes(juce::MidiBuffer& midi, int sampleOffset);
+    void clearActiveNotes();
+    void rescheduleNoteOff(int index);
+    bool isNoteOffBefore(int a, int b) const;
+    void noteOffHeapSiftUp(int pos);
+    void noteOffHeapSiftDown(int pos);
+    
+    // Pattern Snapshots (RCU style)
+    // The message thread publishes a fresh copy into pendingPatterns; the audio thread
+    // takes it over with an exchange and hands its previous copy back through
+    // retiredPatternsFifo, so nothing is ever freed on the audio thread.
+    std::unique_ptr<PatternBankSnapshot> livePatterns; // Audio thread only
+    std::atomic<PatternBankSnapshot*> pendingPatterns{ nullptr };
+    static constexpr int maxRetiredPatterns = 8;
+    juce::AbstractFifo retiredPatternsFifo{ maxRetiredPatterns };
+    std::array<PatternBankSnapshot*, maxRetiredPatterns> retiredPatterns{};
+    
+    // Lane Edit Queue (single producer: message thread, single consumer: audio thread)
+    static constexpr int laneEditQueueSize = 512;
+    juce::AbstractFifo laneEditFifo{ laneEditQueueSize };
+    std::array<LaneEditCommand, laneEditQueueSize> laneEditQueue;
+    juce::uint32 laneEditsSent = 0; // Message thread only
+    std::atomic<juce::uint32> laneEditsApplied{ 0 };
+    std::atomic<bool> isAudioThreadActive{ false }; // Between prepareToPlay and releaseResources
+    
+    // Edits sent while the queue is full wait here, in order, and go in as the audio thread makes
+    // room: on the next edit, on syncEditedTracks or when processing starts. Guarded by patternLock.
+    std::vector<LaneEditCommand> pendingLaneEdits;
+    
+    bool writeLaneEdit(const LaneEditCommand& command); // False when the queue is full
+    void queuePendingLaneEdits(); // Caller must hold patternLock
+    void applyAllLaneEdits(); // Queue and pending edits alike, without a running audio thread
+    void applyLaneEdits();
+    void applyLaneEdit(const LaneEditCommand& command);
+    
+    EditedState edited;
+    std::array<std::atomic<juce::uint32>, (size_t)maxTracks> appliedPatternLoads {}; // Audio thread: load count << 8 | bank * 16 + slot
+    
+    void applyEditedLaneEdit(const LaneEditCommand& command);
+    
+    // Restored Sessions
+    // setStateInformation decodes into a staging EditedState, which becomes the edited copy and is
+    // queued here for a RestoreSession edit to pick up, in order with the edits around it. A slot's
+    // previous session is only freed when the message thread refills it, after the audio thread
+    // has read it.
+    static constexpr int maxRestoredSessions = 8;
+    juce::AbstractFifo restoredSessionFifo{ maxRestoredSessions };
+    std::array<std::unique_ptr<EditedState>, maxRestoredSessions> restoredSessions;
+    juce::uint32 restoresSent = 0; // Message thread only
+    std::atomic<juce::uint32> restoresAdopted{ 0 };
+    void restoreSession(std::unique_ptr<EditedState> session); // Caller must hold patternLock
+    void adoptRestoredSession();
+    
+    // Playback State Triple Buffer
+    // The producer owns playbackWriteIndex, the editor owns playbackReadIndex and the
+    // third buffer sits in playbackMiddleIndex, tagged with playbackFreshBit once published.
+    static constexpr int playbackFreshBit = 4;
+    std::array<PlaybackState, 3> playbackStates;
+    int playbackWriteIndex = 0;
+    int playbackReadIndex = 1;
+    std::atomic<int> playbackMiddleIndex{ 2 };
+    juce::uint32 playbackVersion = 0;
+    
+    void publishPlaybackState(); // Audio thread, or the message thread while the audio thread is stopped
+    
+    void applyGlobalStepIndex(SequencerTrack& track, int targetIndex);
+    void applyLaneTriggerIndex(SequencerTrack& track, int lane, int targetIndex);
+    void applyLaneValueIndex(SequencerTrack& track, int lane, int targetIndex);
+    void applySyncLaneToBar(SequencerTrack& track, int lane);
+    void applyNumCCLanes(SequencerTrack& track, int numCCLanes);
+    void applyNumTracks(int newNumTracks);
+    void reseedRandomStreams(SequencerTrack& track);
+    
+    // Seeking
+    // Puts a track's master and every lane where they would be at the given step had playback run
+    // from the song start (step 0). Deterministic patterns are evaluated in closed form; random
+    // directions and probability rolls depend on every earlier draw, so those are replayed from
+    // their seeds, over at most maxSeekReplaySteps steps.
+    // A replay starts from the latest seek checkpoint before the step. Without one it starts from
+    // the song start, or, past maxSeekReplaySteps, that many steps back from clean lanes: random
+    // lanes then land where a song starting there would put them, not where the full history would.
+    // A seek limited to some lanes leaves every other lane, the master step and the probability
+    // stream as they are; the track level state only moves with all of its lanes.
+    static constexpr long long maxSeekReplaySteps = 1 << 13;
+    
+    // Seek Hit Counts
+    // countLaneHits' prefix tables, kept per track and lane until an edit that changes how the
+    // track steps bumps its generation. Tables are carved out of one pool in the order lanes
+    // first need them; when it runs out every table is dropped and the pool starts over.
+    struct SeekHitTable
+    {
+        juce::uint32 generation = 0, poolEpoch = 0; // Valid while both match, epoch 0 = never built
+        int offset = 0;
+        std::bitset<(size_t)maxSteps> isCycleBuilt;
+    };
+    static constexpr int maxSeekHitTableSize = maxSteps * 2 * maxSteps + maxSteps; // Longest master loop by longest trigger cycle
+    std::array<juce::uint16, (size_t)(8 * maxSeekHitTableSize)> seekHitCounts;
+    juce::uint32 seekHitPoolEpoch = 1;
+    int seekHitPoolUsed = 0;
+    
+    // Seek Checkpoints
+    // A track's stepping state on the first step of recent bars, before the step plays. They are
+    // taken while playing and while replaying, as long as the track's state is the one its full
+    // history gives, so a seek back to a recent bar (a host loop, mostly) replays from there.
+    // Edits that change how a track steps drop its checkpoints.
+    struct SeekCheckpoint
+    {
+        long long step = -1; // -1 = empty
+        LaneBank::PerLane<int> valueStep, triggerStep;
+        LaneBank::PerLane<bool> valueMovingForward, triggerMovingForward;
+        LaneBank::PerLane<RandomStream> randomStreams;
+        RandomStream probabilityRandom;
+    };
+    struct SeekCheckpoints
+    {
+        static constexpr int numBars = 32;
+        std::array<SeekCheckpoint, (size_t)numBars> bars;
+        long long gridOrigin = 0, gridBarTicks = 0; // The bar grid the checkpoints were taken on
+        bool isExact = false; // The track's state follows from its full history, so it may be recorded
+        
+        juce::uint32 hitTableGeneration = 0; // Bumped with every forgetSeekCheckpoints
+        std::array<SeekHitTable, (size_t)numLanes> hitTables;
+    };
+    std::array<SeekCheckpoints, (size_t)maxTracks> seekCheckpoints;
+    
+    void forgetSeekCheckpoints(int track);
+    bool isOnSeekGrid(SeekCheckpoints& checkpoints, const BarGrid& bars);
+    void recordSeekCheckpoint(const SequencerTrack& track, SeekCheckpoints& checkpoints, long long step, const BarGrid& bars, const RandomStream& probabilityRandom);
+    const SeekCheckpoint* findSeekCheckpoint(SeekCheckpoints& checkpoints, long long step, const BarGrid& bars);
+    
+    void seekLanesTo(SequencerTrack& track, SeekCheckpoints& checkpoints, long long step, const BarGrid& bars, LaneBank::LaneMask lanesToSeek = ~(LaneBank::LaneMask)0);
+    bool replayLanesTo(SequencerTrack& track, SeekCheckpoints& checkpoints, long long step, const BarGrid& bars, LaneBank::LaneMask lanesToSeek); // False if capped
+    long long countLaneHits(const SequencerTrack& track, SeekCheckpoints& checkpoints, int lane, long long from, long long to, const BarGrid& bars);
+    
+    void publishPatternBanks(); // Caller must hold patternLock
+    
+    // Stored state records of patternBanks slots not decoded yet. Caller must hold patternLock.
+    std::shared_ptr<const EncodedPatterns> encodedPatterns;
+    std::bitset<64> encodedSlots; // Bit bank * 16 + slot
+    void decodeStoredPattern(int bank, int slot);
+    void decodeAllStoredPatterns();
+    void freeRetiredPatterns();
+    void adoptPendingPatterns();
+    const ChordTable& getLiveChordTable(const SequencerTrack& track) const; // Audio thread
+    
+    // Binary state body, behind the header written by getStateInformation
+    void writeStateBody(juce::OutputStream& out);
+    void readStateBody(juce::InputStream& in);
+    
+    // State Save Caches
+    // Hosts ask for the state on every autosave and undo step. Each live lane and each pattern
+    // slot keeps its last encoded record and is only encoded again once dirty, and an unchanged
+    // body hands back the last compressed chunk. Guarded by patternLock.
+    std::array<std::atomic<LaneBank::LaneMask>, (size_t)maxTracks> dirtyLanes; // Set as the edited copy changes
+    void markLanesDirty(int track, LaneBank::LaneMask lanes); // Safe from any thread
+    std::array<std::array<juce::MemoryBlock, (size_t)numLanes>, (size_t)maxTracks> laneRecords;
+    std::array<std::array<juce::MemoryBlock, 16>, 4> patternRecords;
+    std::bitset<64> cachedPatternRecords; // Bit bank * 16 + slot, set where patternRecords is current
+    juce::MemoryBlock lastStateBody;
+    juce::MemoryBlock lastState;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ShequencerAudioProcessor)
 };
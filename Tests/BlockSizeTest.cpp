@@ -0,0 +1,196 @@
+// Block Size Invariance Test
+// Renders one session over a simulated transport at several host block sizes and checks that
+// every run writes the same MIDI timeline, sample for sample. A second part jumps the transport
+// back across many bars, further than a seek replays from the song start, and checks the notes
+// after the jump against a run that played straight through: the seek has to pick up from its
+// per-bar checkpoints to get them right.
+
+#include "TestSession.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+// One MIDI event at its sample on the transport, as "sample: status data..."
+using Timeline = std::vector<std::string>;
+
+// Two tracks over every lane direction, loop lengths apart from the master's, random lanes,
+// a smoothed CC, HOLD and legato lengths and shuffle
+void setUpSession(ShequencerAudioProcessor& p, bool isGateMode)
+{
+    using Type = LaneEditCommand::Type;
+    
+    p.setNumTracks(2);
+    p.shuffleAmount = 4;
+    
+    for (int t = 0; t < 2; ++t)
+    {
+        sendSteps(p, Type::SetMasterSteps, t, 0, [](int i) { return i % 3 != 1 ? 1 : 0; });
+        
+        sendSteps(p, Type::SetValues, t, 0, [](int i) { return (i * 5) % 12; });
+        sendEdit(p, Type::SetValueLoopLength, t, 0, 7);
+        
+        sendSteps(p, Type::SetValues, t, 1, [](int i) { return i % 4 + 2; });
+        sendSteps(p, Type::SetTriggers, t, 1, [](int i) { return i != 3 ? 1 : 0; });
+        sendEdit(p, Type::SetValueDirection, t, 1, (int)LaneDirection::PingPong);
+        sendEdit(p, Type::SetValueLoopLength, t, 1, 5);
+        
+        sendSteps(p, Type::SetValues, t, 2, [](int i) { return 40 + i * 5; });
+        sendEdit(p, Type::SetValueDirection, t, 2, (int)LaneDirection::Bounce);
+        sendEdit(p, Type::SetTriggerDirection, t, 2, (int)LaneDirection::RandomDirection);
+        
+        sendSteps(p, Type::SetValues, t, 3, [](int i) { return i % 10; });
+        sendEdit(p, Type::SetValueLoopLength, t, 3, 11);
+        sendEdit(p, Type::SetEnableMasterSource, t, 3, 1);
+        sendEdit(p, Type::SetEnableLocalSource, t, 3, 0);
+        
+        sendSteps(p, Type::SetValues, t, 4, [](int i) { return (i * 37) % 128; });
+        sendEdit(p, Type::SetMidiCC, t, 4, 74);
+        sendEdit(p, Type::SetSmoothing, t, 4, 60);
+        
+        sendSteps(p, Type::SetValues, t, 5, [](int i) { return (i * 7) % 25; });
+        sendEdit(p, Type::SetMidiCC, t, 5, 130);
+        sendEdit(p, Type::SetValueLoopLength, t, 5, 5);
+        sendEdit(p, Type::SetValueDirection, t, 5, (int)LaneDirection::Random);
+        
+        sendSteps(p, Type::SetValues, t, 6, [](int i) { return i; });
+        sendEdit(p, Type::SetMidiCC, t, 6, 128);
+        sendEdit(p, Type::SetTriggerLoopLength, t, 6, 3);
+        
+        sendSteps(p, Type::SetValues, t, 7, [](int i) { return i * 8; });
+        sendEdit(p, Type::SetMidiCC, t, 7, 10);
+        sendEdit(p, Type::SetValueDirection, t, 7, (int)LaneDirection::Backward);
+    }
+    
+    // The second track runs a shorter master loop on its own channel
+    sendEdit(p, Type::SetMasterLength, 1, 0, 13);
+    sendEdit(p, Type::SetRandomSeed, 1, 2, 77);
+    for (int lane = 0; lane < 8; ++lane)
+        sendEdit(p, Type::SetMidiChannel, 1, lane, 2);
+    
+    if (isGateMode)
+        sendEdit(p, Type::SetMidiGateMode, 0, 0, 1);
+}
+
+// Gate notes on and off at fixed transport samples, the same whichever block they fall in
+void addGateInput(juce::MidiBuffer& midi, long long start, int numSamples)
+{
+    for (long long s = start; s < start + numSamples; ++s)
+    {
+        const int note = 60 + (int)((s / 9000) % 5);
+        if (s % 9000 == 100) midi.addEvent(juce::MidiMessage::noteOn(1, note, (juce::uint8)100), (int)(s - start));
+        if (s % 9000 == 5100) midi.addEvent(juce::MidiMessage::noteOff(1, note), (int)(s - start));
+    }
+}
+
+// Plays the transport from 0 to numSamples. At jumpFrom it moves to jumpTo, and everything
+// written at or past jumpTo before the jump is dropped.
+Timeline render(bool isGateMode, int blockSize, long long numSamples, long long jumpFrom = -1, long long jumpTo = -1)
+{
+    ShequencerAudioProcessor p;
+    setUpSession(p, isGateMode);
+    
+    TestPlayHead playHead;
+    p.setPlayHead(&playHead);
+    p.setRateAndBufferSizeDetails(testSampleRate, blockSize);
+    p.prepareToPlay(testSampleRate, blockSize);
+    
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    juce::MidiBuffer midi;
+    Timeline timeline;
+    
+    for (long long position = 0; position < numSamples; )
+    {
+        if (jumpFrom >= 0 && position >= jumpFrom)
+        {
+            timeline.erase(std::remove_if(timeline.begin(), timeline.end(),
+                                          [&](const std::string& e) { return std::stoll(e) >= jumpTo; }),
+                           timeline.end());
+            position = jumpTo;
+            jumpFrom = -1;
+        }
+        
+        const int n = (int)std::min<long long>(blockSize, numSamples - position);
+        setTransport(playHead, position);
+        
+        buffer.setSize(2, n, false, false, true);
+        midi.clear();
+        if (isGateMode)
+            addGateInput(midi, position, n);
+        
+        p.processBlock(buffer, midi);
+        
+        for (const auto metadata : midi)
+        {
+            const auto message = metadata.getMessage();
+            std::string event = std::to_string(position + metadata.samplePosition) + ":";
+            for (int i = 0; i < message.getRawDataSize(); ++i)
+                event += " " + std::to_string((int)message.getRawData()[i]);
+            timeline.push_back(event);
+        }
+        
+        position += n;
+    }
+    
+    return timeline;
+}
+
+bool expectSame(const Timeline& expected, const Timeline& actual, const char* name)
+{
+    size_t same = 0;
+    while (same < expected.size() && same < actual.size() && expected[same] == actual[same])
+        ++same;
+    
+    if (same == expected.size() && same == actual.size())
+    {
+        std::printf("%s: ok (%d events)\n", name, (int)expected.size());
+        return true;
+    }
+    
+    std::printf("%s: FAILED after %d of %d events, expected \"%s\", got \"%s\"\n", name, (int)same, (int)expected.size(),
+                same < expected.size() ? expected[same].c_str() : "end", same < actual.size() ? actual[same].c_str() : "end");
+    return false;
+}
+
+Timeline noteOnsFrom(const Timeline& timeline, long long start)
+{
+    Timeline noteOns;
+    for (const auto& event : timeline)
+    {
+        const auto status = event.substr(event.find(':') + 2);
+        if (std::stoll(event) >= start && (std::stoi(status) & 0xf0) == 0x90)
+            noteOns.push_back(event);
+    }
+    return noteOns;
+}
+}
+
+int main()
+{
+    bool passed = true;
+    
+    // Every block size renders what the largest one does
+    const long long numSamples = (long long)(testSampleRate * 20.0);
+    for (const bool isGateMode : { false, true })
+    {
+        const auto reference = render(isGateMode, 8192, numSamples);
+        for (const int blockSize : { 1, 7, 37, 333, 512, 1031, 4096 })
+        {
+            const auto name = std::string(isGateMode ? "Gate mode, " : "") + "block size " + std::to_string(blockSize);
+            passed &= expectSame(reference, render(isGateMode, blockSize, numSamples), name.c_str());
+        }
+    }
+    
+    // A jump back of ten bars, more than 8192 steps into the song, lands where a straight run is.
+    // Only the notes are compared: a note held across the jump ends where the jump cut it.
+    const long long jumpTo = (long long)(testSampleRate * 1070.0) + 555;
+    const long long jumpFrom = (long long)(testSampleRate * 1090.0);
+    const long long songEnd = (long long)(testSampleRate * 1100.0);
+    passed &= expectSame(noteOnsFrom(render(false, 512, songEnd), jumpTo),
+                         noteOnsFrom(render(false, 256, songEnd, jumpFrom, jumpTo), jumpTo),
+                         "Seek back past the replay cap");
+    
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// Test Session
+// What the console harnesses share to drive a processor outside a host: a play head they move
+// by hand and helpers that set a session up through the public lane edit queue.
+
+#include "PluginProcessor.h"
+#include <cmath>
+
+constexpr double testSampleRate = 44100.0;
+constexpr double testBpm = 120.0;
+
+struct TestPlayHead : juce::AudioPlayHead
+{
+    juce::Optional<PositionInfo> getPosition() const override { return info; }
+    PositionInfo info;
+};
+
+// Playing at testBpm in 4/4, at the given sample
+inline void setTransport(TestPlayHead& playHead, long long position)
+{
+    const double ppq = (double)position / (testSampleRate * 60.0 / testBpm);
+    playHead.info.setIsPlaying(true);
+    playHead.info.setBpm(testBpm);
+    playHead.info.setPpqPosition(ppq);
+    playHead.info.setPpqPositionOfLastBarStart(std::floor(ppq / 4.0) * 4.0);
+    playHead.info.setTimeSignature(juce::AudioPlayHead::TimeSignature{});
+    playHead.info.setTimeInSamples(position);
+}
+
+inline void sendEdit(ShequencerAudioProcessor& p, LaneEditCommand::Type type, int track, int lane, int value)
+{
+    LaneEditCommand command;
+    command.type = type;
+    command.track = track;
+    command.lane = lane;
+    command.value = value;
+    p.sendLaneEdit(command);
+}
+
+// Every step of the lane, step(i) for i up to stepCapacity
+template <typename StepFunction>
+void sendSteps(ShequencerAudioProcessor& p, LaneEditCommand::Type type, int track, int lane, StepFunction step)
+{
+    LaneEditCommand command;
+    command.type = type;
+    command.track = track;
+    command.lane = lane;
+    for (int i = 0; i < stepCapacity; ++i)
+        command.steps[(size_t)i] = step(i);
+    p.sendLaneEdit(command);
+}